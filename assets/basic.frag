@@ -1,9 +1,92 @@
 #version 450
 
+// Must match light.h.
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS 4096
+
+#define DIRECTIONAL 0
+#define POINT 1
+#define SPOT 2
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosition;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec4 fragClip;
+layout(location = 4) in vec2 fragTexcoord;
 
 layout(location = 0) out vec4 outColor;
 
+// Base color, white if untextured.
+layout(set = 2, binding = 0) uniform sampler2D baseColor;
+
+struct Light {
+  vec4 position;  // xyz, reach.
+  vec4 color;     // rgb * intensity, type.
+  vec4 direction; // xyz, spot angle scale.
+  vec4 spot;      // Spot angle offset.
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Lights {
+  uvec4 grid; // xyz, number of directional lights.
+  float sliceScale; // slice = log(depth) * scale + bias.
+  float sliceBias;
+  uint numLights;
+  uint pad;
+  Light lights[MAX_LIGHTS];
+  uvec2 clusters[CLUSTER_X * CLUSTER_Y * CLUSTER_Z]; // Offset, count.
+  uint indices[];
+};
+
+vec3 shade(Light light, vec3 n) {
+  vec3 l = -light.direction.xyz;
+  float attenuation = 1.0;
+
+  if (uint(light.color.w) != DIRECTIONAL) {
+    // Smooth windowed inverse square falloff.
+    vec3 d = light.position.xyz - fragPosition;
+    float dist2 = max(dot(d, d), 1e-4);
+    float ratio = dist2 / (light.position.w * light.position.w);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+
+    l = d * inversesqrt(dist2);
+    attenuation = window * window / dist2;
+
+    if (uint(light.color.w) == SPOT) {
+      float cd = dot(light.direction.xyz, -l);
+      float spot = clamp(cd * light.direction.w + light.spot.x, 0.0, 1.0);
+      attenuation *= spot * spot;
+    }
+  }
+
+  return light.color.rgb * attenuation * max(dot(n, l), 0.0);
+}
+
 void main() {
-  outColor = vec4(fragColor, 1.0);
+  vec3 albedo = fragColor * texture(baseColor, fragTexcoord).rgb;
+
+  // Unlit scenes keep their flat colors.
+  if (numLights == 0) {
+    outColor = vec4(albedo, 1.0);
+    return;
+  }
+
+  vec3 n = normalize(fragNormal);
+  vec3 light = vec3(0.05);
+
+  for (uint i = 0; i < grid.w; ++i)
+    light += shade(lights[i], n);
+
+  // Find the cluster, clip-space w is view depth.
+  vec2 ndc = fragClip.xy / fragClip.w;
+  ivec3 c = ivec3(
+    clamp(ivec2((ndc * 0.5 + 0.5) * vec2(grid.xy)), ivec2(0), ivec2(grid.xy) - 1),
+    clamp(int(log(fragClip.w) * sliceScale + sliceBias), 0, int(grid.z) - 1));
+
+  uvec2 cluster = clusters[(c.z * grid.y + c.y) * grid.x + c.x];
+  for (uint i = 0; i < cluster.y; ++i)
+    light += shade(lights[indices[cluster.x + i]], n);
+
+  outColor = vec4(albedo * light, 1.0);
 }
@@ -2,18 +2,41 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texcoord;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosition;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec4 fragClip;
+layout(location = 4) out vec2 fragTexcoord;
 
 layout(row_major, set = 0, binding = 0) uniform PerObject {
-  mat4 model;
+  mat4x3 model;
+};
+
+// All transforms of the frame, indirect draws
+// pass the offset of theirs in vec4s as first instance.
+layout(std430, set = 0, binding = 1) readonly buffer Transforms {
+  vec4 transforms[];
 };
 
 layout(row_major, push_constant) uniform Constants {
   mat4 viewProj;
+  uint indirect;
 };
 
 void main() {
-  gl_Position = viewProj * model * vec4(position, 1.0);
+  mat4x3 world = model;
+  if (indirect != 0) {
+    uint t = gl_InstanceIndex;
+    world = transpose(mat3x4(transforms[t], transforms[t + 1], transforms[t + 2]));
+  }
+
+  fragPosition = world * vec4(position, 1.0);
+  fragNormal = mat3(world) * normal;
+  fragClip = viewProj * vec4(fragPosition, 1.0);
   fragColor = (normal + vec3(1.0)) * 0.5;
+  fragTexcoord = texcoord;
+
+  gl_Position = fragClip;
 }
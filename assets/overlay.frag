@@ -0,0 +1,53 @@
+#version 450
+
+// Must match StatsOverlay.
+#define COLUMNS 64
+#define ROWS 8
+
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform Constants {
+  vec2 origin; // In pixels.
+  vec2 size;   // Of the pass, in pixels.
+  float scale; // Pixels per glyph pixel.
+};
+
+// The grid row by row, 4 characters per uint.
+layout(set = 0, binding = 0) uniform Text {
+  uvec4 text[COLUMNS * ROWS / 16];
+};
+
+// 3x5 glyphs of ASCII 32 through 95, row by row from the top bit,
+// each in a cell of 4x6 pixels.
+const uint FONT[64] = uint[](
+  0x0000, 0x2482, 0x5a00, 0x5f7d, 0x3c9e, 0x52a5, 0x2aab, 0x2400,
+  0x1491, 0x4494, 0x0aa8, 0x05d0, 0x0014, 0x01c0, 0x0002, 0x12a4,
+  0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249,
+  0x7bef, 0x7bcf, 0x0410, 0x0414, 0x1511, 0x0e38, 0x4454, 0x6282,
+  0x2be3, 0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, 0x396b,
+  0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927, 0x5fed, 0x6b6d, 0x2b6a,
+  0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f, 0x5b6a, 0x5bfd,
+  0x5aad, 0x5a92, 0x72a7, 0x3493, 0x4889, 0x6496, 0x2a00, 0x0007
+);
+
+void main() {
+  const ivec2 pixel = ivec2((gl_FragCoord.xy - origin) / scale);
+  const ivec2 cell = pixel / ivec2(4, 6);
+  const ivec2 glyph = pixel - cell * ivec2(4, 6);
+
+  if (cell.x >= COLUMNS || cell.y >= ROWS)
+    discard;
+
+  const uint i = uint(cell.y * COLUMNS + cell.x);
+  const uint c = (text[i >> 4][(i >> 2) & 3] >> ((i & 3) * 8)) & 0xff;
+
+  // Empty cells show the scene, the rest a box to read the glyph on.
+  if (c == 0)
+    discard;
+
+  bool lit = false;
+  if (glyph.x < 3 && glyph.y < 5 && c >= 32 && c < 96)
+    lit = ((FONT[c - 32] >> (14 - (glyph.y * 3 + glyph.x))) & 1) != 0;
+
+  outColor = lit ? vec4(1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+// Must match StatsOverlay.
+#define COLUMNS 64
+#define ROWS 8
+
+layout(push_constant) uniform Constants {
+  vec2 origin; // In pixels.
+  vec2 size;   // Of the pass, in pixels.
+  float scale; // Pixels per glyph pixel.
+};
+
+void main() {
+  // Two triangles covering the grid, no vertex input.
+  const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+    vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0));
+
+  const vec2 grid = vec2(COLUMNS * 4, ROWS * 6) * scale;
+  const vec2 pixel = origin + corners[gl_VertexIndex] * grid;
+
+  gl_Position = vec4(pixel / size * 2.0 - 1.0, 0.0, 1.0);
+}
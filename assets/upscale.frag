@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec2 fragTexcoord;
+
+layout(location = 0) out vec4 outColor;
+
+// The scene at the dynamic resolution, filtered bilinearly.
+layout(set = 0, binding = 0) uniform sampler2D scene;
+
+void main() {
+  outColor = texture(scene, fragTexcoord);
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) out vec2 fragTexcoord;
+
+void main() {
+  // A single triangle covering the screen, no vertex input.
+  const vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+
+  fragTexcoord = uv;
+  gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
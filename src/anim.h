@@ -0,0 +1,119 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "def.h"
+#include "gltf.h"
+#include "jobs.h"
+#include "memory.h"
+
+class GraphNode;
+
+// Keyframes of one animated property, times & values in separate arrays.
+// Values are padded to 4 floats per key so they load as one SIMD vector.
+struct AnimTrack {
+	enum Path {
+		TRANSLATION,
+		ROTATION,
+		SCALE,
+		NUM_PATHS
+	};
+
+	enum Interpolation {
+		STEP,
+		LINEAR, // Spherical for rotations.
+		CUBIC   // 3 values per key: in-tangent, value, out-tangent.
+	};
+
+	Path path;
+	Interpolation interp;
+	uint32_t target;
+	std::vector<float> times;
+	std::vector<float> values;
+};
+
+struct Animation {
+	std::string name;
+	float duration;
+	std::vector<AnimTrack> tracks;
+};
+
+// All animations of a glTF document, parsed once & shared by its instances.
+// Track targets index `nodes`, the glTF node of each target.
+struct AnimImport {
+	std::vector<std::shared_ptr<const Animation>> animations;
+	std::vector<uint32_t> nodes;
+	std::vector<float> pose[AnimTrack::NUM_PATHS]; // Rest, 4 floats per target.
+
+	MemCharge charge = { MEM_ANIMATION };
+};
+
+// Parses all animations, returns false on malformed keyframes.
+bool import_animations(const GltfData &data, AnimImport &out);
+
+class Animator {
+public:
+	Animator(JobPool *jobs) : jobs(jobs) {}
+
+	// Registers a node to animate, its rest pose is used
+	// for whatever properties are not animated.
+	uint32_t addTarget(
+		GraphNode *node,
+		const vec3<float> &translation, const float *rotation, const vec3<float> &scale);
+
+	size_t addAnimation(Animation anim);
+	const Animation &getAnimation(size_t i) { return *animations[i].anim; }
+	size_t numAnimations() { return animations.size(); }
+	size_t numTargets() { return targets.size(); }
+
+	// Adds all imported animations, sharing their keyframes.
+	// nodes[i] must be the node of glTF node i, nullptr if not instantiated.
+	void bind(const AnimImport &import, const std::vector<GraphNode*> &nodes);
+
+	void play(size_t animation, bool loop = true, float speed = 1.0f);
+	void stop(size_t animation);
+
+	// Advances all playing animations and writes the
+	// local transforms of all nodes they target.
+	// Where several animate the same property of a node,
+	// the last one played wins.
+	void update(double dt);
+
+private:
+	struct Playing {
+		size_t animation;
+		float time;
+		float speed;
+		bool loop;
+	};
+
+	struct Bound {
+		std::shared_ptr<const Animation> anim;
+		uint32_t base; // Added to all track targets.
+	};
+
+	struct Work {
+		const AnimTrack *track;
+		uint32_t target;
+		uint32_t *cursor;
+		size_t play; // Into playing.
+	};
+
+	void rebuild();
+
+	JobPool *jobs;
+
+	std::vector<GraphNode*> targets; // nullptr if not instantiated.
+	std::vector<float> pose[AnimTrack::NUM_PATHS]; // 4 floats per target.
+	std::vector<Bound> animations;
+
+	// Keyframe cursors, playback is mostly monotonic.
+	std::vector<std::vector<uint32_t>> cursors;
+
+	std::vector<Playing> playing;
+	std::vector<uint32_t> active; // Targets of all playing animations.
+	std::vector<Work> work;
+
+	MemCharge charge = { MEM_ANIMATION };
+};
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <math.h>
+#include "anim.h"
+#include "graph.h"
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+// Minimal 4-wide float vector, SSE2 when available.
+struct f4 {
+#if defined(__SSE2__)
+	__m128 v;
+
+	static f4 load(const float *p) { return { _mm_loadu_ps(p) }; }
+	static f4 set(float s) { return { _mm_set1_ps(s) }; }
+	void store(float *p) const { _mm_storeu_ps(p, v); }
+
+	f4 operator+(f4 o) const { return { _mm_add_ps(v, o.v) }; }
+	f4 operator-(f4 o) const { return { _mm_sub_ps(v, o.v) }; }
+	f4 operator*(f4 o) const { return { _mm_mul_ps(v, o.v) }; }
+
+	float dot(f4 o) const {
+		__m128 m = _mm_mul_ps(v, o.v);
+		m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(m);
+	}
+#else
+	float v[4];
+
+	static f4 load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+	static f4 set(float s) { return { { s, s, s, s } }; }
+	void store(float *p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+
+	f4 operator+(f4 o) const { return { { v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3] } }; }
+	f4 operator-(f4 o) const { return { { v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3] } }; }
+	f4 operator*(f4 o) const { return { { v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3] } }; }
+
+	float dot(f4 o) const {
+		return v[0] * o.v[0] + v[1] * o.v[1] + v[2] * o.v[2] + v[3] * o.v[3];
+	}
+#endif
+
+	f4 operator*(float s) const { return *this * set(s); }
+
+	f4 normalize() const {
+		const float len = sqrtf(dot(*this));
+		return len > 0.0f ? *this * (1.0f / len) : *this;
+	}
+};
+
+// Slerp approximated by a normalized lerp with a corrected parameter,
+// avoids the trigonometry (see zeux.io, "Approximating slerp").
+static f4 slerp(f4 a, f4 b, float u) {
+	const float cosTheta = a.dot(b);
+	const float d = fabsf(cosTheta);
+
+	const float A = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+	const float B = 0.848013f + d * (-1.06021f + d * 0.215638f);
+	const float k = A * (u - 0.5f) * (u - 0.5f) + B;
+	const float ou = u + u * (u - 0.5f) * (u - 1.0f) * k;
+
+	// Take the shortest path.
+	const float sign = cosTheta < 0.0f ? -1.0f : 1.0f;
+	return (a * (1.0f - ou) + b * (sign * ou)).normalize();
+}
+
+// Finds key k such that times[k] <= t < times[k+1], starting at the cursor.
+static uint32_t seek(const std::vector<float> &times, uint32_t &cursor, float t) {
+	const uint32_t last = (uint32_t)times.size() - 1;
+	uint32_t k = cursor;
+
+	if (k >= last || t < times[k]) {
+		// Jumped back (or looped), binary search.
+		const auto it = std::upper_bound(times.begin(), times.end(), t);
+		k = it == times.begin() ? 0 : (uint32_t)(it - times.begin()) - 1;
+	} else {
+		// Monotonic playback, usually zero or one step.
+		while (k < last && t >= times[k + 1]) ++k;
+	}
+
+	return cursor = k;
+}
+
+static void evaluate(const AnimTrack &track, uint32_t &cursor, float t, float *out) {
+	const size_t numKeys = track.times.size();
+	if (numKeys == 0) return;
+
+	const size_t stride = track.interp == AnimTrack::CUBIC ? 12 : 4;
+	const size_t offset = track.interp == AnimTrack::CUBIC ? 4 : 0; // Skip in-tangent.
+
+	const uint32_t k = seek(track.times, cursor, t);
+
+	// Clamp to the ends.
+	if (k + 1 >= numKeys || t <= track.times[0]) {
+		const size_t key = t <= track.times[0] ? 0 : numKeys - 1;
+		f4::load(&track.values[key * stride + offset]).store(out);
+		return;
+	}
+
+	const float t0 = track.times[k];
+	const float dt = track.times[k + 1] - t0;
+	const float u = dt > 0.0f ? (t - t0) / dt : 0.0f;
+
+	const float *k0 = &track.values[k * stride];
+	const float *k1 = &track.values[(k + 1) * stride];
+	f4 res;
+
+	switch (track.interp) {
+	case AnimTrack::STEP:
+		res = f4::load(k0);
+		break;
+
+	case AnimTrack::LINEAR: {
+		const f4 a = f4::load(k0);
+		const f4 b = f4::load(k1);
+		res = track.path == AnimTrack::ROTATION ? slerp(a, b, u) : a + (b - a) * u;
+		break;
+	}
+
+	case AnimTrack::CUBIC: {
+		// Hermite spline, tangents are scaled by the key interval.
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+
+		res =
+			f4::load(k0 + 4) * (2.0f * u3 - 3.0f * u2 + 1.0f) +
+			f4::load(k0 + 8) * ((u3 - 2.0f * u2 + u) * dt) +
+			f4::load(k1 + 4) * (-2.0f * u3 + 3.0f * u2) +
+			f4::load(k1) * ((u3 - u2) * dt);
+
+		if (track.path == AnimTrack::ROTATION)
+			res = res.normalize();
+		break;
+	}
+	}
+
+	res.store(out);
+}
+
+uint32_t Animator::addTarget(
+		GraphNode *node,
+		const vec3<float> &translation, const float *rotation, const vec3<float> &scale) {
+	targets.push_back(node);
+
+	const float rest[AnimTrack::NUM_PATHS][4] = {
+		{ translation[0], translation[1], translation[2], 0.0f },
+		{ rotation[0], rotation[1], rotation[2], rotation[3] },
+		{ scale[0], scale[1], scale[2], 0.0f }
+	};
+
+	for (size_t p = 0; p < AnimTrack::NUM_PATHS; ++p)
+		pose[p].insert(pose[p].end(), rest[p], rest[p] + 4);
+
+	charge.set(charge.get() + sizeof(GraphNode*) + sizeof(rest));
+
+	return (uint32_t)targets.size() - 1;
+}
+
+size_t Animator::addAnimation(Animation anim) {
+	uint64_t bytes = anim.tracks.size() * (sizeof(AnimTrack) + sizeof(uint32_t));
+	for (const auto &track : anim.tracks)
+		bytes += (track.times.size() + track.values.size()) * sizeof(float);
+
+	charge.set(charge.get() + bytes);
+	cursors.emplace_back(anim.tracks.size(), 0);
+	animations.push_back(Bound{std::make_shared<const Animation>(std::move(anim)), 0});
+
+	return animations.size() - 1;
+}
+
+void Animator::bind(const AnimImport &import, const std::vector<GraphNode*> &nodes) {
+	const uint32_t base = (uint32_t)targets.size();
+
+	for (const uint32_t node : import.nodes)
+		targets.push_back(node < nodes.size() ? nodes[node] : nullptr);
+
+	for (size_t p = 0; p < AnimTrack::NUM_PATHS; ++p)
+		pose[p].insert(pose[p].end(), import.pose[p].begin(), import.pose[p].end());
+
+	// Only cursors & targets are per instance.
+	uint64_t bytes = import.nodes.size() * (sizeof(GraphNode*) + sizeof(float) * 12);
+
+	for (const auto &anim : import.animations) {
+		bytes += sizeof(Bound) + anim->tracks.size() * sizeof(uint32_t);
+		cursors.emplace_back(anim->tracks.size(), 0);
+		animations.push_back(Bound{anim, base});
+	}
+
+	charge.set(charge.get() + bytes);
+}
+
+bool import_animations(const GltfData &data, AnimImport &out) {
+	const JsonValue &jNodes = data.json()["nodes"];
+	const JsonValue &jAnims = data.json()["animations"];
+	std::vector<uint32_t> nodeTargets(jNodes.size(), UINT32_MAX);
+	uint64_t bytes = 0;
+
+	for (size_t a = 0; a < jAnims.size(); ++a) {
+		const JsonValue &jAnim = jAnims[a];
+		const JsonValue &jSamplers = jAnim["samplers"];
+		const JsonValue &jChannels = jAnim["channels"];
+
+		Animation anim = { jAnim["name"].string(), 0.0f, {} };
+
+		for (size_t c = 0; c < jChannels.size(); ++c) {
+			const JsonValue &jTarget = jChannels[c]["target"];
+			const JsonValue &jSampler = jSamplers[jChannels[c]["sampler"].index()];
+			const std::string &path = jTarget["path"].string();
+			const std::string &interp = jSampler["interpolation"].string();
+			const size_t node = jTarget["node"].index();
+
+			// Morph target weights are not supported.
+			if (node >= jNodes.size() || path == "weights")
+				continue;
+
+			AnimTrack track;
+			track.path =
+				path == "translation" ? AnimTrack::TRANSLATION :
+				path == "rotation" ? AnimTrack::ROTATION :
+				AnimTrack::SCALE;
+			track.interp =
+				interp == "STEP" ? AnimTrack::STEP :
+				interp == "CUBICSPLINE" ? AnimTrack::CUBIC :
+				AnimTrack::LINEAR;
+
+			const size_t keys = data.readFloats(jSampler["input"].index(), 1, track.times);
+			const size_t values = data.readFloats(jSampler["output"].index(), 4, track.values);
+			if (keys == 0 || values != keys * (track.interp == AnimTrack::CUBIC ? 3 : 1))
+				return false;
+
+			// Register the node with its rest pose.
+			if (nodeTargets[node] == UINT32_MAX) {
+				const JsonValue &jNode = jNodes[node];
+				const JsonValue &jT = jNode["translation"];
+				const JsonValue &jR = jNode["rotation"];
+				const JsonValue &jS = jNode["scale"];
+
+				const float rest[AnimTrack::NUM_PATHS][4] = {
+					{
+						(float)jT[0].number(0.0), (float)jT[1].number(0.0),
+						(float)jT[2].number(0.0), 0.0f
+					}, {
+						(float)jR[0].number(0.0), (float)jR[1].number(0.0),
+						(float)jR[2].number(0.0), (float)jR[3].number(1.0)
+					}, {
+						(float)jS[0].number(1.0), (float)jS[1].number(1.0),
+						(float)jS[2].number(1.0), 0.0f
+					}
+				};
+
+				for (size_t p = 0; p < AnimTrack::NUM_PATHS; ++p)
+					out.pose[p].insert(out.pose[p].end(), rest[p], rest[p] + 4);
+
+				nodeTargets[node] = (uint32_t)out.nodes.size();
+				out.nodes.push_back((uint32_t)node);
+				bytes += sizeof(uint32_t) + sizeof(rest);
+			}
+
+			track.target = nodeTargets[node];
+			anim.duration = std::max(anim.duration, track.times.back());
+			bytes += sizeof(AnimTrack) +
+				(track.times.size() + track.values.size()) * sizeof(float);
+
+			anim.tracks.push_back(std::move(track));
+		}
+
+		out.animations.push_back(std::make_shared<const Animation>(std::move(anim)));
+	}
+
+	out.charge.set(bytes);
+
+	return true;
+}
+
+void Animator::play(size_t animation, bool loop, float speed) {
+	if (animation >= animations.size()) return;
+
+	stop(animation);
+	playing.push_back(Playing{animation, 0.0f, speed, loop});
+	rebuild();
+}
+
+void Animator::stop(size_t animation) {
+	for (size_t p = 0; p < playing.size(); ++p)
+		if (playing[p].animation == animation) {
+			playing.erase(playing.begin() + p);
+			rebuild();
+			return;
+		}
+}
+
+void Animator::rebuild() {
+	active.clear();
+	work.clear();
+
+	// One track per property of a target, so no two jobs write the same pose.
+	// Walk backwards so the last animation (& its last channel) wins.
+	std::vector<uint8_t> claimed(targets.size() * AnimTrack::NUM_PATHS, 0);
+
+	for (size_t p = playing.size(); p-- > 0;) {
+		const Bound &bound = animations[playing[p].animation];
+		for (size_t t = bound.anim->tracks.size(); t-- > 0;) {
+			const AnimTrack &track = bound.anim->tracks[t];
+			const uint32_t target = bound.base + track.target;
+			if (!targets[target]) continue;
+
+			uint8_t &claim = claimed[target * AnimTrack::NUM_PATHS + track.path];
+			if (claim) continue;
+
+			claim = 1;
+			active.push_back(target);
+			work.push_back(Work{&track, target, &cursors[playing[p].animation][t], p});
+		}
+	}
+
+	std::sort(active.begin(), active.end());
+	active.erase(std::unique(active.begin(), active.end()), active.end());
+}
+
+void Animator::update(double dt) {
+	if (playing.empty()) return;
+
+	// Advance time.
+	for (auto &play : playing) {
+		const float duration = animations[play.animation].anim->duration;
+		play.time += (float)dt * play.speed;
+
+		if (play.loop && duration > 0.0f) {
+			play.time = fmodf(play.time, duration);
+			if (play.time < 0.0f) play.time += duration;
+		} else
+			play.time = std::clamp(play.time, 0.0f, duration);
+	}
+
+	// Sample all tracks, then compose the poses of all targets.
+	jobs->parallelFor(work.size(), 256, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const Work &job = work[i];
+			evaluate(
+				*job.track, *job.cursor, playing[job.play].time,
+				&pose[job.track->path][job.target * 4]);
+		}
+	});
+
+	jobs->parallelFor(active.size(), 256, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const uint32_t target = active[i];
+			targets[target]->transform = affine3x4<float>::trs(
+				&pose[AnimTrack::TRANSLATION][target * 4],
+				&pose[AnimTrack::ROTATION][target * 4],
+				&pose[AnimTrack::SCALE][target * 4]);
+		}
+	});
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "anim.h"
+#include "cull.h"
+#include "def.h"
+#include "gltf.h"
+#include "graph.h"
+#include "texture.h"
+
+// Sub-allocates the vertices & indices of all assets from a few large
+// buffers (pages), so draws of different assets are ranges within the
+// same primitive & need no buffer rebinds in between.
+// Freed ranges coalesce with their neighbours & emptied pages are
+// released, live ranges are never moved as primitives reference them.
+class GeometryArena {
+public:
+	struct Range {
+		size_t page = SIZE_MAX; // SIZE_MAX if nothing is allocated.
+		uint64_t vertexOffset;  // In bytes.
+		uint64_t vertexBytes;
+		uint64_t indexOffset;
+		uint64_t indexBytes;
+	};
+
+	// Of either the vertex or index buffers of all pages.
+	struct Usage {
+		uint64_t capacity;
+		uint64_t used;
+		size_t freeRanges;
+		uint64_t largestFree;
+
+		double occupancy() const {
+			return capacity > 0 ? (double)used / (double)capacity : 0.0;
+		}
+
+		// 0 if all free space is a single range, towards 1 the more it is split.
+		double fragmentation() const {
+			const uint64_t free = capacity - used;
+			return free > 0 ? 1.0 - (double)largestFree / (double)free : 0.0;
+		}
+	};
+
+	struct Stats {
+		size_t pages;
+		size_t ranges;  // Allocations, including retired ones.
+		size_t retired; // Freed, still in use by frames in flight.
+		Usage vertices;
+		Usage indices;
+	};
+
+	// Freed ranges are reused after `numFrames` calls to update(),
+	// right away if 0 (nothing is drawn from them).
+	GeometryArena(
+		GFXHeap *heap, GFXDependency *dep, unsigned int numFrames = 0,
+		uint64_t vertexPageSize = (uint64_t)32 << 20,
+		uint64_t indexPageSize = (uint64_t)16 << 20);
+
+	GeometryArena(const GeometryArena&) = delete;
+	~GeometryArena();
+
+	// Allocates from the first page both fit in (best-fit within it),
+	// or a new page, & starts uploading to it, signaling `dep`.
+	bool alloc(
+		const std::vector<uint8_t> &vertices, const std::vector<uint8_t> &indices,
+		Range &out);
+
+	// Retires the range, it is given back (& its page released if empty)
+	// once every frame that could still draw from it has finished.
+	void free(const Range &range);
+
+	// Call once per submitted frame.
+	void update();
+
+	GFXBuffer *vertices(size_t page) { return pages[page].vertices; }
+	GFXBuffer *indices(size_t page) { return pages[page].indices; }
+
+	// Spans an entire page, with 16 or 32 bits indices, nullptr on failure.
+	GFXPrimitive *span(size_t page, char indexSize);
+
+	Stats stats();
+
+private:
+	// Free ranges of a buffer as offset & size, sorted & coalesced.
+	struct FreeList {
+		uint64_t capacity;
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+		bool find(uint64_t bytes, size_t &out) const;
+		uint64_t take(size_t range, uint64_t bytes);
+		void give(uint64_t offset, uint64_t bytes);
+	};
+
+	struct Page {
+		GFXBuffer *vertices;
+		GFXBuffer *indices;
+		FreeList vertexFree;
+		FreeList indexFree;
+		GFXPrimitive *spans[2]; // 16 & 32 bits indices.
+		size_t ranges;
+	};
+
+	struct Retired {
+		Range range;
+		uint64_t update; // Retired during.
+	};
+
+	bool addPage(uint64_t vertexBytes, uint64_t indexBytes, size_t &out);
+	void releasePage(Page &page);
+	void give(const Range &range);
+
+	GFXHeap *heap;
+	GFXDependency *dep;
+	unsigned int numFrames;
+	uint64_t vertexPageSize;
+	uint64_t indexPageSize;
+	uint64_t updates;
+
+	std::vector<Page> pages; // Released pages have no buffers.
+	std::vector<Retired> retired;
+};
+
+// A loaded glTF file, its GPU resources are shared by all its instances
+// and freed when the last instance (or other reference) is gone.
+class GltfAsset {
+public:
+	// Static nodes merged into pre-transformed batches.
+	struct BatchStats {
+		size_t nodes;      // Static nodes with a mesh.
+		size_t primitives; // Merged into batches.
+		size_t batches;    // Spatial chunks, a draw each.
+		uint64_t vertices;
+		uint64_t bytes;
+	};
+
+	GltfAsset() = default;
+	GltfAsset(const GltfAsset&) = delete;
+	~GltfAsset();
+
+	// Loads from the bytes of the file at path, returns nullptr on failure.
+	// Geometry is sub-allocated from `arena`, which must outlive the asset.
+	// Decodes & converts in parallel if given a job pool.
+	// Base color textures are baked & streamed if given a streamer.
+	// Nodes flagged with extras.static (and their subtrees) are batched,
+	// or all unanimated nodes if `staticAll` is set.
+	static std::shared_ptr<GltfAsset> load(
+		GFXHeap *heap, GeometryArena *arena, JobPool *jobs,
+		TextureStreamer *streamer, bool staticAll,
+		const char *path, std::vector<uint8_t> bytes);
+
+	// Builds a new graph sharing all resources of this asset.
+	// Animations are bound to the animator if not nullptr.
+	std::unique_ptr<GraphNode> instantiate(
+		GFXTechnique *tech, GFXPass *pass,
+		const std::vector<GFXSet*> &sets, Animator *animator);
+
+	const GltfData &data() { return gltf; }
+	uint64_t residentBytes() { return bytes; }
+	const BatchStats &batchStats() { return batching; }
+
+private:
+	GraphNode *instantiateNode(
+		GFXTechnique *tech, GFXPass *pass, const std::vector<GFXSet*> &sets,
+		std::vector<GraphNode*> &nodes,
+		GraphNode *parent, const affine3x4<float> &parentWorld, size_t node);
+
+	std::shared_ptr<const OccluderMesh> getOccluder(size_t mesh, size_t primitive);
+	std::shared_ptr<Texture> getBaseColor(size_t mesh, size_t primitive);
+
+	bool buildBatches(
+		GFXHeap *heap, JobPool *jobs,
+		const GltfGeometry &geometry, bool staticAll);
+
+	std::weak_ptr<GltfAsset> self;
+
+	GltfData gltf;
+	GeometryArena *arena = nullptr;
+	GeometryArena::Range geometry = {};
+	uint64_t bytes = 0;
+	MemCharge charge = { MEM_GPU_ASSETS };
+
+	// Per mesh, per primitive, occluders are created on first use.
+	std::vector<std::vector<GFXPrimitive*>> prims; // nullptr if unsupported.
+	std::vector<std::vector<aabb<float>>> bounds;
+	std::vector<std::vector<uint32_t>> counts; // Vertices or indices.
+	std::vector<std::vector<MeshNode::SharedRange>> ranges; // Indexed only.
+	std::vector<std::vector<std::shared_ptr<const OccluderMesh>>> occluders;
+	std::vector<std::vector<bool>> occludersLoaded;
+
+	std::vector<std::shared_ptr<Texture>> images; // nullptr if not baked.
+
+	AnimImport animations; // Keyframes shared by all instances.
+
+	// A spatial chunk of merged static geometry in asset space,
+	// sharing a base color.
+	struct Batch {
+		GFXPrimitive *prim;
+		aabb<float> bounds;
+		uint32_t numIndices;
+		MeshNode::SharedRange range;
+		std::shared_ptr<Texture> texture;
+		std::shared_ptr<const OccluderMesh> occluder; // Optional.
+	};
+
+	std::vector<Batch> batches;
+	std::vector<bool> batched; // Per node, drawn by a batch.
+	GeometryArena::Range batchGeometry = {};
+	BatchStats batching = {};
+};
+
+// Keyed by canonical path & content hash, so repeatedly loading the same
+// file (or an identical copy) reuses whatever is still referenced.
+// Copies only share if their bytes compare equal & their external buffers
+// & images resolve to the same, unchanged files.
+class AssetCache {
+public:
+	struct Stats {
+		size_t loads;
+		size_t hits;
+		size_t resident;
+		uint64_t residentBytes;
+
+		double hitRate() const {
+			return loads > 0 ? (double)hits / (double)loads : 0.0;
+		}
+	};
+
+	// Geometry is sub-allocated from `arena`, which must outlive all assets.
+	AssetCache(
+		GFXHeap *heap, GeometryArena *arena,
+		JobPool *jobs = nullptr, TextureStreamer *streamer = nullptr) :
+		heap(heap), arena(arena), jobs(jobs), streamer(streamer), counts{} {}
+
+	// Batch all unanimated nodes of newly loaded assets as static.
+	bool staticAll = false;
+
+	// Returns nullptr on failure.
+	std::shared_ptr<GltfAsset> load(const char *path);
+
+	// Drops entries of assets (and textures) that are no longer referenced.
+	void purge();
+
+	Stats stats();
+
+private:
+	// Canonical path (if it exists), size & modification time.
+	struct FileId {
+		std::string path;
+		uint64_t size;
+		int64_t mtime;
+
+		bool operator==(const FileId &other) const {
+			return path == other.path && size == other.size && mtime == other.mtime;
+		}
+	};
+
+	struct Entry {
+		std::weak_ptr<GltfAsset> asset;
+		uint64_t hash;
+		uint64_t size;
+		int64_t mtime;
+		std::vector<FileId> externals; // As loaded.
+	};
+
+	// An asset as loaded from a document & its external files.
+	struct Shared {
+		std::weak_ptr<GltfAsset> asset;
+		FileId document;
+		std::vector<FileId> externals;
+	};
+
+	static FileId file_id(const std::string &path);
+	static std::vector<FileId> external_ids(
+		const std::string &document, const std::vector<std::string> &uris);
+
+	// If none of the files changed since.
+	static bool unchanged(const std::vector<FileId> &files);
+
+	static bool matches(
+		const Shared &shared, GltfAsset &asset,
+		const std::string &document, const std::vector<uint8_t> &bytes);
+
+	GFXHeap *heap;
+	GeometryArena *arena;
+	JobPool *jobs;
+	TextureStreamer *streamer;
+
+	std::unordered_map<std::string, Entry> byPath;
+	std::unordered_multimap<uint64_t, Shared> byHash;
+
+	Stats counts;
+};
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <filesystem>
+#include <string.h>
+#include "assets.h"
+
+// Bytes per parallel hash job.
+#define HASH_CHUNK (1 << 22)
+
+// 64 bits FNV-1a over 8 byte words, bytes of the tail.
+static uint64_t hash_range(const uint8_t *data, size_t len) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * 0x100000001b3ull;
+	}
+
+	for (; i < len; ++i)
+		hash = (hash ^ data[i]) * 0x100000001b3ull;
+
+	return hash;
+}
+
+// Hashes chunks in parallel, then hashes the chunk hashes.
+static uint64_t hash_bytes(const std::vector<uint8_t> &bytes, JobPool *jobs) {
+	const size_t numChunks = (bytes.size() + HASH_CHUNK - 1) / HASH_CHUNK;
+	if (!jobs || numChunks <= 1)
+		return hash_range(bytes.data(), bytes.size());
+
+	std::vector<uint64_t> hashes(numChunks);
+	jobs->parallelFor(numChunks, 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c)
+			hashes[c] = hash_range(
+				bytes.data() + c * HASH_CHUNK,
+				std::min((size_t)HASH_CHUNK, bytes.size() - c * HASH_CHUNK));
+	});
+
+	return hash_range((const uint8_t*)hashes.data(), numChunks * sizeof(uint64_t));
+}
+
+AssetCache::FileId AssetCache::file_id(const std::string &path) {
+	namespace fs = std::filesystem;
+
+	std::error_code err;
+	const fs::path canonical = fs::weakly_canonical(path, err);
+
+	FileId out = {};
+	out.path = err ? path : canonical.string();
+	out.size = fs::file_size(out.path, err);
+
+	if (err)
+		out.size = 0;
+	else {
+		out.mtime = (int64_t)fs::last_write_time(out.path, err).time_since_epoch().count();
+		if (err) out.mtime = 0;
+	}
+
+	return out;
+}
+
+std::vector<AssetCache::FileId> AssetCache::external_ids(
+		const std::string &document, const std::vector<std::string> &uris) {
+	// Resolved as GltfData does.
+	const size_t slash = document.find_last_of("/\\");
+	const std::string dir =
+		(slash == std::string::npos) ? "" : document.substr(0, slash + 1);
+
+	std::vector<FileId> out;
+	out.reserve(uris.size());
+
+	for (const std::string &uri : uris)
+		out.push_back(file_id(dir + uri));
+
+	return out;
+}
+
+bool AssetCache::unchanged(const std::vector<FileId> &files) {
+	for (const FileId &file : files)
+		if (!(file_id(file.path) == file))
+			return false;
+
+	return true;
+}
+
+bool AssetCache::matches(
+		const Shared &shared, GltfAsset &asset,
+		const std::string &document, const std::vector<uint8_t> &bytes) {
+	// Same relative URIs, they must resolve to the same files.
+	if (external_ids(document, asset.data().externalUris()) != shared.externals)
+		return false;
+
+	// A hash is no proof, compare against the document it was loaded from,
+	// which must not have changed since.
+	if (shared.document.path == document)
+		return true;
+
+	if (!(file_id(shared.document.path) == shared.document))
+		return false;
+
+	std::vector<uint8_t> other;
+	return read_file(shared.document.path, other) && other == bytes;
+}
+
+std::shared_ptr<GltfAsset> AssetCache::load(const char *path) {
+	const FileId id = file_id(path);
+	const std::string &key = id.path;
+
+	++counts.loads;
+
+	// Same file & external files, unchanged on disk, skip reading it entirely.
+	auto it = byPath.find(key);
+	if (it != byPath.end() && id.size > 0 &&
+		it->second.size == id.size && it->second.mtime == id.mtime &&
+		unchanged(it->second.externals))
+	{
+		if (auto asset = it->second.asset.lock()) {
+			++counts.hits;
+			return asset;
+		}
+	}
+
+	std::vector<uint8_t> bytes;
+	if (!read_file(key, bytes))
+		return nullptr;
+
+	// Identical content, possibly under another path.
+	const uint64_t hash = hash_bytes(bytes, jobs);
+	std::shared_ptr<GltfAsset> asset = nullptr;
+
+	for (auto [hit, end] = byHash.equal_range(hash); hit != end && !asset; ++hit)
+		if (auto candidate = hit->second.asset.lock())
+			if (matches(hit->second, *candidate, key, bytes))
+				asset = candidate;
+
+	if (asset)
+		++counts.hits;
+	else {
+		asset = GltfAsset::load(
+			heap, arena, jobs, streamer, staticAll, key.c_str(), std::move(bytes));
+		if (!asset) return nullptr;
+
+		byHash.emplace(hash, Shared{
+			asset, id, external_ids(key, asset->data().externalUris()) });
+	}
+
+	byPath[key] = Entry{
+		asset, hash, id.size, id.mtime,
+		external_ids(key, asset->data().externalUris()) };
+	return asset;
+}
+
+void AssetCache::purge() {
+	for (auto it = byPath.begin(); it != byPath.end();)
+		it = it->second.asset.expired() ? byPath.erase(it) : std::next(it);
+
+	for (auto it = byHash.begin(); it != byHash.end();)
+		it = it->second.asset.expired() ? byHash.erase(it) : std::next(it);
+
+	if (streamer)
+		streamer->purge();
+}
+
+AssetCache::Stats AssetCache::stats() {
+	Stats out = counts;
+	out.resident = 0;
+	out.residentBytes = 0;
+
+	for (auto &entry : byHash)
+		if (auto asset = entry.second.asset.lock()) {
+			++out.resident;
+			out.residentBytes += asset->residentBytes();
+		}
+
+	return out;
+}
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include "assets.h"
+
+// Vertex offsets are in whole vertices, 32 bits indices are aligned too.
+#define ARENA_INDEX_ALIGN 4
+
+static uint64_t align_up(uint64_t bytes, uint64_t align) {
+	return (bytes + align - 1) / align * align;
+}
+
+bool GeometryArena::FreeList::find(uint64_t bytes, size_t &out) const {
+	// Best fit, the smallest range that fits.
+	size_t best = SIZE_MAX;
+	for (size_t r = 0; r < ranges.size(); ++r)
+		if (ranges[r].second >= bytes &&
+			(best == SIZE_MAX || ranges[r].second < ranges[best].second))
+		{
+			best = r;
+		}
+
+	out = best;
+	return best != SIZE_MAX;
+}
+
+uint64_t GeometryArena::FreeList::take(size_t range, uint64_t bytes) {
+	auto &r = ranges[range];
+	const uint64_t offset = r.first;
+
+	r.first += bytes;
+	r.second -= bytes;
+
+	if (r.second == 0)
+		ranges.erase(ranges.begin() + (ptrdiff_t)range);
+
+	return offset;
+}
+
+void GeometryArena::FreeList::give(uint64_t offset, uint64_t bytes) {
+	auto it = std::lower_bound(
+		ranges.begin(), ranges.end(), std::make_pair(offset, (uint64_t)0));
+
+	it = ranges.insert(it, std::make_pair(offset, bytes));
+
+	// Coalesce with the next, then the previous range.
+	auto next = it + 1;
+	if (next != ranges.end() && it->first + it->second == next->first) {
+		it->second += next->second;
+		ranges.erase(next);
+	}
+
+	if (it != ranges.begin()) {
+		auto prev = it - 1;
+		if (prev->first + prev->second == it->first) {
+			prev->second += it->second;
+			ranges.erase(it);
+		}
+	}
+}
+
+GeometryArena::GeometryArena(
+		GFXHeap *heap, GFXDependency *dep, unsigned int numFrames,
+		uint64_t vertexPageSize, uint64_t indexPageSize) :
+	heap(heap),
+	dep(dep),
+	numFrames(numFrames),
+	vertexPageSize(align_up(vertexPageSize, GltfGeometry::VERTEX_SIZE)),
+	indexPageSize(align_up(indexPageSize, ARENA_INDEX_ALIGN)),
+	updates(0)
+{
+}
+
+GeometryArena::~GeometryArena() {
+	for (Page &page : pages)
+		releasePage(page);
+}
+
+bool GeometryArena::addPage(uint64_t vertexBytes, uint64_t indexBytes, size_t &out) {
+	// Larger allocations get a page of their own size.
+	Page page = {};
+	page.vertexFree.capacity = std::max(vertexBytes, vertexPageSize);
+	page.indexFree.capacity = std::max(indexBytes, indexPageSize);
+	page.vertexFree.ranges.push_back({ 0, page.vertexFree.capacity });
+	page.indexFree.ranges.push_back({ 0, page.indexFree.capacity });
+
+	page.vertices = gfx_alloc_buffer(
+		heap, GFX_MEMORY_WRITE, GFX_BUFFER_VERTEX, page.vertexFree.capacity);
+	page.indices = gfx_alloc_buffer(
+		heap, GFX_MEMORY_WRITE, GFX_BUFFER_INDEX, page.indexFree.capacity);
+
+	if (!page.vertices || !page.indices) {
+		releasePage(page);
+		return false;
+	}
+
+	// Reuse the slot of a released page.
+	auto slot = std::find_if(pages.begin(), pages.end(),
+		[](const Page &p) { return p.vertices == nullptr; });
+
+	out = (size_t)(slot - pages.begin());
+	if (slot == pages.end()) pages.push_back(page);
+	else *slot = page;
+
+	return true;
+}
+
+void GeometryArena::releasePage(Page &page) {
+	for (GFXPrimitive *&span : page.spans) {
+		if (span) gfx_free_prim(span);
+		span = nullptr;
+	}
+
+	if (page.vertices) gfx_free_buffer(page.vertices);
+	if (page.indices) gfx_free_buffer(page.indices);
+
+	page.vertices = nullptr;
+	page.indices = nullptr;
+	page.vertexFree.ranges.clear();
+	page.indexFree.ranges.clear();
+}
+
+// Starts uploading to a range of a buffer.
+static bool upload(
+		GFXDependency *dep, GFXBuffer *buffer, uint64_t offset,
+		const std::vector<uint8_t> &data) {
+	if (data.empty())
+		return true;
+
+	const GFXRegion src = { .offset = 0, .rowSize = 0, .numRows = 0 };
+	const GFXRegion dst = { .offset = 0, .rowSize = 0, .numRows = 0 };
+	const GFXInject inject = gfx_dep_sig(dep);
+
+	return gfx_write(
+		data.data(), gfx_ref_buffer_at(buffer, offset),
+		GFX_TRANSFER_ASYNC, 1, 1, &src, &dst, &inject);
+}
+
+bool GeometryArena::alloc(
+		const std::vector<uint8_t> &vertices, const std::vector<uint8_t> &indices,
+		Range &out) {
+	const uint64_t vertexBytes = align_up(vertices.size(), GltfGeometry::VERTEX_SIZE);
+	const uint64_t indexBytes = align_up(indices.size(), ARENA_INDEX_ALIGN);
+
+	// Empty ranges would not be distinguishable from free space.
+	const uint64_t vertexTake = std::max(vertexBytes, (uint64_t)GltfGeometry::VERTEX_SIZE);
+	const uint64_t indexTake = std::max(indexBytes, (uint64_t)ARENA_INDEX_ALIGN);
+
+	size_t page = SIZE_MAX, vertexRange = 0, indexRange = 0;
+	for (size_t p = 0; p < pages.size() && page == SIZE_MAX; ++p)
+		if (pages[p].vertices &&
+			pages[p].vertexFree.find(vertexTake, vertexRange) &&
+			pages[p].indexFree.find(indexTake, indexRange))
+		{
+			page = p;
+		}
+
+	if (page == SIZE_MAX) {
+		if (!addPage(vertexTake, indexTake, page))
+			return false;
+
+		vertexRange = 0;
+		indexRange = 0;
+	}
+
+	Page &p = pages[page];
+	const uint64_t vertexOffset = p.vertexFree.take(vertexRange, vertexTake);
+	const uint64_t indexOffset = p.indexFree.take(indexRange, indexTake);
+
+	out = Range{ page, vertexOffset, vertexTake, indexOffset, indexTake };
+	++p.ranges;
+
+	if (!upload(dep, p.vertices, vertexOffset, vertices) ||
+		!upload(dep, p.indices, indexOffset, indices))
+	{
+		give(out);
+		out = {};
+		return false;
+	}
+
+	return true;
+}
+
+void GeometryArena::free(const Range &range) {
+	if (range.page >= pages.size())
+		return;
+
+	if (numFrames == 0)
+		give(range);
+	else
+		retired.push_back(Retired{ range, updates });
+}
+
+void GeometryArena::update() {
+	++updates;
+
+	// Every frame that was in flight when retired has been submitted again,
+	// so waited upon & done reading.
+	auto it = std::remove_if(retired.begin(), retired.end(), [&](const Retired &r) {
+		if (updates - r.update <= numFrames)
+			return false;
+
+		give(r.range);
+		return true;
+	});
+
+	retired.erase(it, retired.end());
+}
+
+void GeometryArena::give(const Range &range) {
+	Page &page = pages[range.page];
+	page.vertexFree.give(range.vertexOffset, range.vertexBytes);
+	page.indexFree.give(range.indexOffset, range.indexBytes);
+
+	// Keep the last page around, it would likely be allocated again.
+	const size_t live = (size_t)std::count_if(pages.begin(), pages.end(),
+		[](const Page &p) { return p.vertices != nullptr; });
+
+	if (--page.ranges == 0 && live > 1)
+		releasePage(page);
+}
+
+GFXPrimitive *GeometryArena::span(size_t page, char indexSize) {
+	Page &p = pages[page];
+	GFXPrimitive *&span = p.spans[indexSize == 4 ? 1 : 0];
+
+	if (span)
+		return span;
+
+	const GFXBufferRef vertexRef = gfx_ref_buffer(p.vertices);
+	const GFXAttribute attribs[] = {
+		{ GFX_FORMAT_R32G32B32_SFLOAT, 0,
+			GltfGeometry::VERTEX_SIZE, GFX_RATE_VERTEX, vertexRef },
+		{ GFX_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3,
+			GltfGeometry::VERTEX_SIZE, GFX_RATE_VERTEX, vertexRef },
+		{ GFX_FORMAT_R32G32_SFLOAT, sizeof(float) * 6,
+			GltfGeometry::VERTEX_SIZE, GFX_RATE_VERTEX, vertexRef }
+	};
+
+	span = gfx_alloc_prim(
+		heap, GFX_MEMORY_NONE, GFX_BUFFER_NONE, GFX_TOPO_TRIANGLE_LIST,
+		(uint32_t)(p.indexFree.capacity / (uint64_t)indexSize), indexSize,
+		(uint32_t)(p.vertexFree.capacity / GltfGeometry::VERTEX_SIZE),
+		gfx_ref_buffer(p.indices),
+		sizeof(attribs)/sizeof(GFXAttribute), attribs);
+
+	return span;
+}
+
+GeometryArena::Stats GeometryArena::stats() {
+	Stats out = {};
+
+	auto add = [](Usage &usage, const FreeList &list) {
+		usage.capacity += list.capacity;
+		usage.used += list.capacity;
+		usage.freeRanges += list.ranges.size();
+
+		for (const auto &r : list.ranges) {
+			usage.used -= r.second;
+			usage.largestFree = std::max(usage.largestFree, r.second);
+		}
+	};
+
+	out.retired = retired.size();
+
+	for (const Page &page : pages)
+		if (page.vertices) {
+			++out.pages;
+			out.ranges += page.ranges;
+			add(out.vertices, page.vertexFree);
+			add(out.indices, page.indexFree);
+		}
+
+	return out;
+}
@@ -0,0 +1,608 @@
+#include <algorithm>
+#include <string.h>
+#include "assets.h"
+
+// Primitives at least this large (world-space) become occluders,
+// as do primitives flagged with extras.occluder.
+static const float minOccluderSize = 1.5f;
+static const size_t maxOccluderTris = 2048;
+
+GltfAsset::~GltfAsset() {
+	for (auto &mesh : prims)
+		for (GFXPrimitive *prim : mesh)
+			if (prim) gfx_free_prim(prim);
+
+	for (const Batch &batch : batches)
+		gfx_free_prim(batch.prim);
+
+	if (arena) {
+		arena->free(geometry);
+		arena->free(batchGeometry);
+	}
+}
+
+// Vertex attributes of a range starting at `vertices`.
+static GFXPrimitive *alloc_prim(
+		GFXHeap *heap, GFXBufferRef vertices, GFXBufferRef indices,
+		uint32_t numVertices, uint32_t numIndices, char indexSize) {
+	const GFXAttribute attribs[] = {
+		{ GFX_FORMAT_R32G32B32_SFLOAT, 0,
+			GltfGeometry::VERTEX_SIZE, GFX_RATE_VERTEX, vertices },
+		{ GFX_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3,
+			GltfGeometry::VERTEX_SIZE, GFX_RATE_VERTEX, vertices },
+		{ GFX_FORMAT_R32G32_SFLOAT, sizeof(float) * 6,
+			GltfGeometry::VERTEX_SIZE, GFX_RATE_VERTEX, vertices }
+	};
+
+	return gfx_alloc_prim(
+		heap, GFX_MEMORY_NONE, GFX_BUFFER_NONE, GFX_TOPO_TRIANGLE_LIST,
+		numIndices, indexSize, numVertices, indices,
+		sizeof(attribs)/sizeof(GFXAttribute), attribs);
+}
+
+std::shared_ptr<GltfAsset> GltfAsset::load(
+		GFXHeap *heap, GeometryArena *arena, JobPool *jobs,
+		TextureStreamer *streamer, bool staticAll,
+		const char *path, std::vector<uint8_t> bytes) {
+	// Decode & convert everything on the CPU, in parallel.
+	auto asset = std::shared_ptr<GltfAsset>(new GltfAsset());
+	if (!asset->gltf.load(path, bytes, jobs))
+		return nullptr;
+
+	GltfGeometry geometry;
+	if (!asset->gltf.buildGeometry(geometry, jobs))
+		return nullptr;
+
+	asset->self = asset;
+	asset->arena = arena;
+
+	// One range of the arena's buffers for the entire asset.
+	if (!geometry.vertices.empty() &&
+		!arena->alloc(geometry.vertices, geometry.indices, asset->geometry))
+	{
+		return nullptr;
+	}
+
+	const GeometryArena::Range &base = asset->geometry;
+
+	asset->bytes = geometry.vertices.size() + geometry.indices.size();
+	asset->charge.set(asset->bytes);
+
+	// Primitives are views into the shared buffers.
+	const size_t numMeshes = geometry.primitives.size();
+	asset->prims.resize(numMeshes);
+	asset->bounds.resize(numMeshes);
+	asset->counts.resize(numMeshes);
+	asset->ranges.resize(numMeshes);
+	asset->occluders.resize(numMeshes);
+	asset->occludersLoaded.resize(numMeshes);
+
+	for (size_t m = 0; m < numMeshes; ++m) {
+		const size_t numPrims = geometry.primitives[m].size();
+		asset->prims[m].resize(numPrims, nullptr);
+		asset->counts[m].resize(numPrims, 0);
+		asset->ranges[m].resize(numPrims, MeshNode::SharedRange{});
+		asset->occluders[m].resize(numPrims);
+		asset->occludersLoaded[m].resize(numPrims, false);
+
+		for (size_t p = 0; p < numPrims; ++p) {
+			asset->bounds[m].push_back(asset->gltf.primitiveBounds(m, p));
+
+			const GltfGeometry::Range &range = geometry.primitives[m][p];
+			if (range.numVertices == 0) continue;
+
+			asset->counts[m][p] =
+				range.numIndices > 0 ? range.numIndices : range.numVertices;
+
+			const uint64_t vertexOffset = base.vertexOffset + range.vertexOffset;
+			const uint64_t indexOffset = base.indexOffset + range.indexOffset;
+
+			asset->prims[m][p] = alloc_prim(
+				heap,
+				gfx_ref_buffer_at(arena->vertices(base.page), vertexOffset),
+				range.numIndices > 0 ?
+					gfx_ref_buffer_at(arena->indices(base.page), indexOffset) : GFX_REF_NULL,
+				range.numVertices, range.numIndices, range.indexSize);
+
+			if (!asset->prims[m][p])
+				return nullptr;
+
+			if (range.numIndices == 0)
+				continue;
+
+			// The same range of the page's span.
+			GFXPrimitive *span = arena->span(base.page, range.indexSize);
+			if (!span)
+				return nullptr;
+
+			asset->ranges[m][p] = MeshNode::SharedRange{
+				span,
+				(uint32_t)(indexOffset / (uint64_t)range.indexSize),
+				(int32_t)(vertexOffset / GltfGeometry::VERTEX_SIZE) };
+		}
+	}
+
+	// Missing or unsupported images are left untextured.
+	if (streamer) {
+		const std::vector<std::string> paths = bake_images(asset->gltf, jobs);
+		asset->images.resize(paths.size());
+
+		for (size_t i = 0; i < paths.size(); ++i)
+			if (!paths[i].empty())
+				asset->images[i] = streamer->open(paths[i]);
+	}
+
+	if (!asset->buildBatches(heap, jobs, geometry, staticAll))
+		return nullptr;
+
+	if (!import_animations(asset->gltf, asset->animations))
+		return nullptr;
+
+	return asset;
+}
+
+// Parses a KHR_lights_punctual light, defaults as per the extension.
+static std::unique_ptr<LightNode> parse_light(const JsonValue &jLight) {
+	auto light = std::make_unique<LightNode>();
+	const std::string &type = jLight["type"].string();
+
+	if (type == "directional")
+		light->type = LightNode::DIRECTIONAL;
+	else if (type == "spot")
+		light->type = LightNode::SPOT;
+	else
+		light->type = LightNode::POINT;
+
+	const JsonValue &jColor = jLight["color"];
+	for (size_t c = 0; c < 3; ++c)
+		light->color[c] = (float)jColor[c].number(1.0);
+
+	light->intensity = (float)jLight["intensity"].number(1.0);
+	light->range = (float)jLight["range"].number(0.0);
+
+	const JsonValue &jSpot = jLight["spot"];
+	light->innerCone = (float)jSpot["innerConeAngle"].number(0.0);
+	light->outerCone = (float)jSpot["outerConeAngle"].number(0.7853981634);
+
+	return light;
+}
+
+std::shared_ptr<const OccluderMesh> GltfAsset::getOccluder(size_t mesh, size_t primitive) {
+	if (occludersLoaded[mesh][primitive])
+		return occluders[mesh][primitive];
+
+	occludersLoaded[mesh][primitive] = true;
+
+	const JsonValue &prim = gltf.json()["meshes"][mesh]["primitives"][primitive];
+	auto occ = std::make_shared<OccluderMesh>();
+
+	// Only indexed triangle lists.
+	if (prim["mode"].number(4) != 4 ||
+		gltf.readFloats(prim["attributes"]["POSITION"].index(), 3, occ->positions) == 0 ||
+		gltf.readIndices(prim["indices"].index(), occ->indices) == 0)
+	{
+		return {};
+	}
+
+	occ->indices.resize(occ->indices.size() / 3 * 3);
+	for (uint32_t index : occ->indices)
+		if ((size_t)index * 3 >= occ->positions.size())
+			return {};
+
+	occ->charge.set(
+		occ->positions.size() * sizeof(float) +
+		occ->indices.size() * sizeof(uint32_t));
+
+	return occluders[mesh][primitive] = occ;
+}
+
+std::shared_ptr<Texture> GltfAsset::getBaseColor(size_t mesh, size_t primitive) {
+	const JsonValue &json = gltf.json();
+	const JsonValue &prim = json["meshes"][mesh]["primitives"][primitive];
+	const JsonValue &material = json["materials"][prim["material"].index()];
+
+	const size_t texture =
+		material["pbrMetallicRoughness"]["baseColorTexture"]["index"].index();
+	const size_t image = json["textures"][texture]["source"].index();
+
+	return image < images.size() ? images[image] : nullptr;
+}
+
+// Vertices per spatial chunk of a batch, unless a single primitive is larger.
+#define BATCH_CHUNK_VERTICES 16384
+
+// A static mesh primitive placed in asset space.
+struct BatchItem {
+	size_t node, mesh, primitive;
+	affine3x4<float> world;
+	vec3<float> center; // For splitting only.
+	const Texture *texture;
+	GltfGeometry::Range range;
+	uint32_t numIndices; // Generated if not indexed.
+	uint32_t baseVertex; // Within its chunk.
+	uint64_t vertex, index; // Into the merged buffers, in elements.
+	aabb<float> bounds; // Asset-space, of its transformed vertices.
+};
+
+struct BatchChunk {
+	size_t begin, end; // Items.
+	uint64_t vertex, index;
+	uint32_t numVertices, numIndices;
+};
+
+// Static meshes of a node & its subtree, `statics` is indexed by node.
+static void find_static(
+		const GltfData &gltf, const std::vector<bool> &animated,
+		std::vector<bool> &visited, std::vector<bool> &statics,
+		std::vector<BatchItem> &out,
+		size_t node, const affine3x4<float> &parentWorld,
+		bool parentStatic, bool staticAll) {
+	if (node >= visited.size() || visited[node])
+		return;
+
+	visited[node] = true;
+
+	// Animation moves a node with its entire subtree.
+	if (animated[node])
+		return;
+
+	const JsonValue &jNode = gltf.json()["nodes"][node];
+	const affine3x4<float> world = parentWorld * gltf.nodeTransform(node);
+	const bool isStatic = parentStatic || staticAll || gltf.nodeFlag(node, "static");
+
+	const size_t mesh = jNode["mesh"].index();
+	if (isStatic && mesh < gltf.json()["meshes"].size()) {
+		statics[node] = true;
+
+		const size_t numPrims = gltf.json()["meshes"][mesh]["primitives"].size();
+		for (size_t p = 0; p < numPrims; ++p)
+			out.push_back(BatchItem{ node, mesh, p, world });
+	}
+
+	const JsonValue &jChildren = jNode["children"];
+	for (size_t c = 0; c < jChildren.size(); ++c)
+		find_static(
+			gltf, animated, visited, statics, out,
+			jChildren[c].index(), world, isStatic, staticAll);
+}
+
+// Median splits along the longest axis of the item centers.
+static void split_chunks(
+		std::vector<BatchItem> &items, size_t begin, size_t end,
+		std::vector<BatchChunk> &out) {
+	uint64_t numVertices = 0;
+	aabb<float> centers;
+
+	for (size_t i = begin; i < end; ++i) {
+		numVertices += items[i].range.numVertices;
+		centers.extend(items[i].center);
+	}
+
+	if (numVertices <= BATCH_CHUNK_VERTICES || end - begin == 1) {
+		out.push_back(BatchChunk{ begin, end, 0, 0, 0, 0 });
+		return;
+	}
+
+	const vec3<float> size = centers.size();
+	const size_t axis =
+		(size[0] >= size[1] && size[0] >= size[2]) ? 0 :
+		(size[1] >= size[2]) ? 1 : 2;
+
+	const size_t mid = begin + (end - begin) / 2;
+	std::nth_element(
+		items.begin() + (ptrdiff_t)begin,
+		items.begin() + (ptrdiff_t)mid,
+		items.begin() + (ptrdiff_t)end,
+		[&](const BatchItem &l, const BatchItem &r) {
+			return l.center[axis] < r.center[axis];
+		});
+
+	split_chunks(items, begin, mid, out);
+	split_chunks(items, mid, end, out);
+}
+
+bool GltfAsset::buildBatches(
+		GFXHeap *heap, JobPool *jobs,
+		const GltfGeometry &geometry, bool staticAll) {
+	const JsonValue &json = gltf.json();
+	const size_t numNodes = json["nodes"].size();
+
+	std::vector<bool> animated(numNodes, false);
+	const JsonValue &jAnims = json["animations"];
+	for (size_t a = 0; a < jAnims.size(); ++a) {
+		const JsonValue &jChannels = jAnims[a]["channels"];
+		for (size_t c = 0; c < jChannels.size(); ++c) {
+			const size_t node = jChannels[c]["target"]["node"].index();
+			if (node < numNodes) animated[node] = true;
+		}
+	}
+
+	// Same scene as instantiate().
+	std::vector<bool> visited(numNodes, false);
+	std::vector<BatchItem> items;
+	batched.assign(numNodes, false);
+
+	const JsonValue &jScene = json["scenes"][json["scene"].index(0)];
+	const JsonValue &jRoots = jScene["nodes"];
+	for (size_t n = 0; n < jRoots.size(); ++n)
+		find_static(
+			gltf, animated, visited, batched, items,
+			jRoots[n].index(), affine3x4<float>(), false, staticAll);
+
+	// Drop unsupported primitives, lay out by base color, then space.
+	auto unsupported = [&](BatchItem &item) {
+		if (!prims[item.mesh][item.primitive])
+			return true;
+
+		const aabb<float> box = bounds[item.mesh][item.primitive].transform(item.world);
+		item.center = box.empty() ? item.world.translation() : (box.min + box.max) * 0.5f;
+		item.texture = getBaseColor(item.mesh, item.primitive).get();
+		item.range = geometry.primitives[item.mesh][item.primitive];
+		item.numIndices =
+			item.range.numIndices > 0 ? item.range.numIndices : item.range.numVertices;
+
+		return false;
+	};
+
+	items.erase(std::remove_if(items.begin(), items.end(), unsupported), items.end());
+
+	std::stable_sort(items.begin(), items.end(), [](const BatchItem &l, const BatchItem &r) {
+		return l.texture < r.texture;
+	});
+
+	std::vector<BatchChunk> chunks;
+	for (size_t begin = 0, end = 0; begin < items.size(); begin = end) {
+		while (end < items.size() && items[end].texture == items[begin].texture)
+			++end;
+
+		split_chunks(items, begin, end, chunks);
+	}
+
+	uint64_t numVertices = 0, numIndices = 0;
+	for (BatchChunk &chunk : chunks) {
+		chunk.vertex = numVertices;
+		chunk.index = numIndices;
+
+		for (size_t i = chunk.begin; i < chunk.end; ++i) {
+			BatchItem &item = items[i];
+			item.baseVertex = chunk.numVertices;
+			item.vertex = numVertices + chunk.numVertices;
+			item.index = numIndices + chunk.numIndices;
+
+			chunk.numVertices += item.range.numVertices;
+			chunk.numIndices += item.numIndices;
+		}
+
+		numVertices += chunk.numVertices;
+		numIndices += chunk.numIndices;
+	}
+
+	// Pre-transform everything in parallel, normals like the shader does.
+	const size_t stride = GltfGeometry::VERTEX_SIZE / sizeof(float);
+	std::vector<uint8_t> vertexData(numVertices * GltfGeometry::VERTEX_SIZE);
+	std::vector<uint8_t> indexData(numIndices * sizeof(uint32_t));
+
+	auto convert = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			BatchItem &item = items[i];
+			const float *src = (const float*)(geometry.vertices.data() + item.range.vertexOffset);
+			float *dst = (float*)vertexData.data() + item.vertex * stride;
+
+			for (uint32_t v = 0; v < item.range.numVertices; ++v) {
+				const float *s = src + v * stride;
+				float *d = dst + v * stride;
+
+				const vec3<float> pos = item.world * vec3<float>(s[0], s[1], s[2]);
+				const vec3<float> normal = item.world.rotate(vec3<float>(s[3], s[4], s[5]));
+				item.bounds.extend(pos);
+
+				for (size_t c = 0; c < 3; ++c) d[c] = pos[c], d[3 + c] = normal[c];
+				d[6] = s[6], d[7] = s[7];
+			}
+
+			uint32_t *indices = (uint32_t*)indexData.data() + item.index;
+			const uint8_t *srcIndices = geometry.indices.data() + item.range.indexOffset;
+
+			for (uint32_t x = 0; x < item.numIndices; ++x) {
+				uint32_t index = x;
+				if (item.range.numIndices > 0 && item.range.indexSize == 4)
+					memcpy(&index, srcIndices + x * 4, 4);
+				else if (item.range.numIndices > 0) {
+					uint16_t short16;
+					memcpy(&short16, srcIndices + x * 2, 2);
+					index = short16;
+				}
+
+				indices[x] = index + item.baseVertex;
+			}
+		}
+	};
+
+	if (jobs) jobs->parallelFor(items.size(), 16, convert);
+	else convert(0, items.size());
+
+	if (chunks.empty())
+		return true;
+
+	if (!arena->alloc(vertexData, indexData, batchGeometry))
+		return false;
+
+	const GeometryArena::Range &base = batchGeometry;
+	const uint64_t baseVertex = base.vertexOffset / GltfGeometry::VERTEX_SIZE;
+	const uint64_t baseIndex = base.indexOffset / sizeof(uint32_t);
+
+	GFXPrimitive *span = arena->span(base.page, sizeof(uint32_t));
+	if (!span)
+		return false;
+
+	for (const BatchChunk &chunk : chunks) {
+		Batch batch = {
+			nullptr, {}, chunk.numIndices,
+			{ span, (uint32_t)(baseIndex + chunk.index), (int32_t)(baseVertex + chunk.vertex) },
+			{}, {} };
+		auto occluder = std::make_shared<OccluderMesh>();
+
+		for (size_t i = chunk.begin; i < chunk.end; ++i) {
+			const BatchItem &item = items[i];
+			batch.bounds.extend(item.bounds);
+
+			// Same selection as unbatched occluders.
+			const vec3<float> size = item.bounds.size();
+			const bool flagged = gltf.nodeFlag(item.node, "occluder");
+			if (!flagged && GFX_MAX(size[0], GFX_MAX(size[1], size[2])) < minOccluderSize)
+				continue;
+
+			auto occ = getOccluder(item.mesh, item.primitive);
+			if (!occ || (!flagged && occ->numTriangles() > maxOccluderTris))
+				continue;
+
+			const uint32_t base = (uint32_t)(occluder->positions.size() / 3);
+			for (size_t p = 0; p < occ->positions.size(); p += 3) {
+				const vec3<float> pos = item.world * vec3<float>(
+					occ->positions[p], occ->positions[p + 1], occ->positions[p + 2]);
+				occluder->positions.insert(occluder->positions.end(), pos.data, pos.data + 3);
+			}
+
+			for (uint32_t index : occ->indices)
+				occluder->indices.push_back(index + base);
+		}
+
+		if (!occluder->indices.empty()) {
+			occluder->charge.set(
+				occluder->positions.size() * sizeof(float) +
+				occluder->indices.size() * sizeof(uint32_t));
+
+			batch.occluder = occluder;
+		}
+
+		// Textures are kept alive by the asset.
+		batch.texture = getBaseColor(items[chunk.begin].mesh, items[chunk.begin].primitive);
+
+		batch.prim = alloc_prim(
+			heap,
+			gfx_ref_buffer_at(arena->vertices(base.page),
+				(baseVertex + chunk.vertex) * GltfGeometry::VERTEX_SIZE),
+			gfx_ref_buffer_at(arena->indices(base.page),
+				(baseIndex + chunk.index) * sizeof(uint32_t)),
+			chunk.numVertices, chunk.numIndices, sizeof(uint32_t));
+
+		if (!batch.prim)
+			return false;
+
+		batches.push_back(std::move(batch));
+	}
+
+	batching.nodes = (size_t)std::count(batched.begin(), batched.end(), true);
+	batching.primitives = items.size();
+	batching.batches = batches.size();
+	batching.vertices = numVertices;
+	batching.bytes = vertexData.size() + indexData.size();
+
+	bytes += batching.bytes;
+	charge.set(bytes);
+
+	return true;
+}
+
+GraphNode *GltfAsset::instantiateNode(
+		GFXTechnique *tech, GFXPass *pass, const std::vector<GFXSet*> &sets,
+		std::vector<GraphNode*> &nodes,
+		GraphNode *parent, const affine3x4<float> &parentWorld, size_t nodeIndex) {
+	// Malformed documents could reference a node twice.
+	if (nodeIndex >= nodes.size() || nodes[nodeIndex])
+		return nullptr;
+
+	const JsonValue &jNode = gltf.json()["nodes"][nodeIndex];
+	const auto matrix = gltf.nodeTransform(nodeIndex);
+	const auto world = parentWorld * matrix;
+	const size_t meshIndex = jNode["mesh"].index();
+	std::unique_ptr<GraphNode> parsed = {};
+
+	// Batched meshes are drawn by the instance's batch node.
+	if (meshIndex >= prims.size() || batched[nodeIndex])
+		parsed = std::make_unique<GraphNode>(matrix);
+	else {
+		auto mesh = std::make_unique<MeshNode>(matrix);
+		const bool flagged = gltf.nodeFlag(nodeIndex, "occluder");
+
+		for (size_t p = 0; p < prims[meshIndex].size(); ++p) {
+			GFXPrimitive *prim = prims[meshIndex][p];
+			if (!prim) continue;
+
+			const aabb<float> &bounds = this->bounds[meshIndex][p];
+			const vec3<float> size = bounds.transform(world).size();
+
+			std::shared_ptr<const OccluderMesh> occluder = {};
+			if (flagged ||
+				GFX_MAX(size[0], GFX_MAX(size[1], size[2])) >= minOccluderSize)
+			{
+				occluder = getOccluder(meshIndex, p);
+				if (occluder && !flagged && occluder->numTriangles() > maxOccluderTris)
+					occluder = {};
+			}
+
+			size_t i = mesh->addPrimitive(MeshNode::Primitive{
+				tech, prim, bounds, occluder, self.lock(),
+				getBaseColor(meshIndex, p), counts[meshIndex][p],
+				ranges[meshIndex][p]});
+			dassert(mesh->setForward(i, pass, nullptr));
+			dassert(mesh->assignSets(i, sets));
+		}
+
+		parsed = std::move(mesh);
+	}
+
+	nodes[nodeIndex] = parsed.get();
+
+	// As a child, so a node can hold both a mesh & a light.
+	const JsonValue &jLights = gltf.json()["extensions"]["KHR_lights_punctual"]["lights"];
+	const JsonValue &jLight = jLights[jNode["extensions"]["KHR_lights_punctual"]["light"].index()];
+
+	if (jLight.isObject())
+		parsed->addChild(parse_light(jLight));
+
+	const JsonValue &jChildren = jNode["children"];
+	for (size_t c = 0; c < jChildren.size(); ++c)
+		instantiateNode(
+			tech, pass, sets, nodes,
+			parsed.get(), world, jChildren[c].index());
+
+	return parent->addChild(std::move(parsed));
+}
+
+std::unique_ptr<GraphNode> GltfAsset::instantiate(
+		GFXTechnique *tech, GFXPass *pass,
+		const std::vector<GFXSet*> &sets, Animator *animator) {
+	auto root = std::make_unique<GraphNode>();
+	std::vector<GraphNode*> nodes(gltf.json()["nodes"].size(), nullptr);
+
+	// The default scene, or the first if none.
+	const JsonValue &jScenes = gltf.json()["scenes"];
+	const JsonValue &jScene = jScenes[gltf.json()["scene"].index(0)];
+	const JsonValue &jRoots = jScene["nodes"];
+
+	for (size_t n = 0; n < jRoots.size(); ++n)
+		instantiateNode(
+			tech, pass, sets, nodes,
+			root.get(), affine3x4<float>(), jRoots[n].index());
+
+	// All batches in a single node, in asset space.
+	if (!batches.empty()) {
+		auto statics = std::make_unique<MeshNode>();
+
+		for (const Batch &batch : batches) {
+			size_t i = statics->addPrimitive(MeshNode::Primitive{
+				tech, batch.prim, batch.bounds, batch.occluder, self.lock(),
+				batch.texture, batch.numIndices, batch.range});
+			dassert(statics->setForward(i, pass, nullptr));
+			dassert(statics->assignSets(i, sets));
+		}
+
+		root->addChild(std::move(statics));
+	}
+
+	if (animator)
+		animator->bind(animations, nodes);
+
+	return root;
+}
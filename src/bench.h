@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+// Headless benchmarks, all return an exit code.
+
+// Evaluates `numNodes` simultaneously animated nodes for `numFrames` frames.
+int bench_animation(size_t numNodes, size_t numFrames);
+
+// Loads & uploads a glTF document with gfx_load_gltf and the fast path,
+// fails if the .gltf speedup misses the target. Needs a device.
+// A synthetic `syntheticMiB` MiB scene as .gltf & .glb if path is nullptr.
+int bench_load(const char *path, size_t syntheticMiB);
+
+// Loads (through an AssetCache) & instantiates the same glTF document
+// `numInstances` times, prints how the load time & resident bytes stay flat.
+// Uploads its geometry, so needs a device (a software driver will do).
+int bench_instances(const char *path, size_t numInstances);
+
+// Bins `numLights` scattered lights into the cluster grid of
+// a turning camera for `numFrames` frames.
+int bench_lights(size_t numLights, size_t numFrames);
+
+// Records `numObjects` cubes through MeshNode::_record & as indirect draws
+// culled on the GPU for `numFrames` frames each, compares the CPU time spent
+// recording. Renders offscreen, so needs a device (a software driver will do).
+int bench_indirect(size_t numObjects, size_t numFrames);
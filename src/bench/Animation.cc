@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include "anim.h"
+#include "bench.h"
+#include "graph.h"
+
+int bench_animation(size_t numNodes, size_t numFrames) {
+	JobPool jobs;
+	Animator animator(&jobs);
+	GraphNode root;
+
+	// One animation driving every node with all three interpolation modes.
+	const size_t numKeys = 64;
+	const float duration = 4.0f;
+	Animation anim = { "bench", duration, {} };
+
+	for (size_t n = 0; n < numNodes; ++n) {
+		GraphNode *node = root.addChild(std::make_unique<GraphNode>());
+
+		const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		const uint32_t target = animator.addTarget(
+			node, vec3<float>(), identity, vec3<float>(1.0f, 1.0f, 1.0f));
+
+		AnimTrack t = { AnimTrack::TRANSLATION, AnimTrack::LINEAR, target, {}, {} };
+		AnimTrack r = { AnimTrack::ROTATION, AnimTrack::LINEAR, target, {}, {} };
+		AnimTrack s = { AnimTrack::SCALE, AnimTrack::CUBIC, target, {}, {} };
+
+		for (size_t k = 0; k < numKeys; ++k) {
+			const float time = duration * (float)k / (float)(numKeys - 1);
+			const float phase = time + (float)n * 0.01f;
+			const float half = 0.5f * phase;
+
+			t.times.push_back(time);
+			r.times.push_back(time);
+			s.times.push_back(time);
+
+			const float tv[4] = { sinf(phase), cosf(phase), (float)n, 0.0f };
+			const float rv[4] = { 0.0f, sinf(half), 0.0f, cosf(half) };
+			const float sv[12] = {
+				0.0f, 0.0f, 0.0f, 0.0f,
+				1.0f + 0.1f * sinf(phase), 1.0f, 1.0f, 0.0f,
+				0.0f, 0.0f, 0.0f, 0.0f
+			};
+
+			t.values.insert(t.values.end(), tv, tv + 4);
+			r.values.insert(r.values.end(), rv, rv + 4);
+			s.values.insert(s.values.end(), sv, sv + 12);
+		}
+
+		anim.tracks.push_back(std::move(t));
+		anim.tracks.push_back(std::move(r));
+		anim.tracks.push_back(std::move(s));
+	}
+
+	animator.addAnimation(std::move(anim));
+	animator.play(0);
+
+	std::vector<double> animMs;
+	std::vector<double> updateMs;
+
+	for (size_t f = 0; f < numFrames; ++f) {
+		const auto t0 = std::chrono::steady_clock::now();
+		animator.update(1.0 / 60.0);
+		const auto t1 = std::chrono::steady_clock::now();
+		root.update();
+		const auto t2 = std::chrono::steady_clock::now();
+
+		animMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+		updateMs.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+	}
+
+	auto report = [&](const char *name, std::vector<double> &ms) {
+		double sum = 0.0;
+		for (double m : ms) sum += m;
+		std::sort(ms.begin(), ms.end());
+
+		printf("%-10s avg %.3f ms, p50 %.3f ms, p99 %.3f ms, %.1f ns/node\n",
+			name, sum / (double)ms.size(),
+			ms[ms.size() / 2], ms[ms.size() * 99 / 100],
+			sum / (double)ms.size() * 1e6 / (double)numNodes);
+	};
+
+	printf("animation: %zu nodes, %zu tracks, %zu keys, %zu threads, %zu frames\n",
+		numNodes, numNodes * 3, numKeys, jobs.numThreads(), numFrames);
+
+	if (numFrames > 0) {
+		report("animate", animMs);
+		report("update", updateMs);
+	}
+
+	return 0;
+}
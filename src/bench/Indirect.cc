@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "graph.h"
+#include "light.h"
+#include "math/chain.h"
+#include "pipeline.h"
+
+// Defined in main.cc.
+GFXShader *load_shader(GFXShaderStage stage, const char *path);
+
+// Unit cube with normals & texcoords, 24 vertices.
+static void cube_geometry(std::vector<float> &vertices, std::vector<uint16_t> &indices) {
+	for (int axis = 0; axis < 3; ++axis)
+		for (int sign = 0; sign < 2; ++sign) {
+			const float s = sign ? 0.5f : -0.5f;
+			const uint16_t base = (uint16_t)(vertices.size() / 8);
+
+			for (int c = 0; c < 4; ++c) {
+				float pos[3], normal[3] = { 0.0f, 0.0f, 0.0f };
+				const float u = (c & 1) ? 0.5f : -0.5f;
+				const float v = (c & 2) ? 0.5f : -0.5f;
+
+				pos[axis] = s;
+				pos[(axis + 1) % 3] = sign ? u : v;
+				pos[(axis + 2) % 3] = sign ? v : u;
+				normal[axis] = sign ? 1.0f : -1.0f;
+
+				vertices.insert(vertices.end(), pos, pos + 3);
+				vertices.insert(vertices.end(), normal, normal + 3);
+				vertices.push_back(u + 0.5f);
+				vertices.push_back(v + 0.5f);
+			}
+
+			const uint16_t quad[6] = { 0, 1, 3, 0, 3, 2 };
+			for (uint16_t i : quad)
+				indices.push_back((uint16_t)(base + i));
+		}
+}
+
+struct IndirectBench {
+	GFXTechnique *tech;
+	GraphNode *graph;
+	IndirectDraws *indirect; // nullptr to record per object.
+	GFXSet **lightSets;
+	TextureStreamer *textures;
+	const SceneSnapshot *snap;
+	double recordMs; // Of both passes.
+};
+
+static void bench_cull(GFXRecorder *recorder, void *ptr) {
+	IndirectBench *b = (IndirectBench*)ptr;
+
+	const auto start = std::chrono::steady_clock::now();
+	b->indirect->cull(recorder, *b->snap);
+
+	b->recordMs += std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench_render(GFXRecorder *recorder, void *ptr) {
+	IndirectBench *b = (IndirectBench*)ptr;
+	const unsigned int frame = gfx_recorder_get_frame_index(recorder);
+	const SnapshotView &view = b->snap->views[0];
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// Everything but the draws themselves, as record_views does.
+	const uint32_t flag = b->indirect ? 1 : 0;
+	const uint32_t lightOffset = 0;
+
+	gfx_cmd_push(recorder, b->tech, 0, sizeof(view.viewProj.data), view.viewProj.data);
+	gfx_cmd_push(recorder, b->tech, sizeof(view.viewProj.data), sizeof(flag), &flag);
+	gfx_cmd_bind(recorder, b->tech, 1, 1, 1, &b->lightSets[frame], &lightOffset);
+	gfx_cmd_bind(recorder, b->tech, 2, 1, 0, &b->textures->fallback()[frame], nullptr);
+
+	if (b->indirect)
+		b->indirect->draw(recorder, 0, nullptr);
+	else
+		b->graph->record(recorder, nullptr);
+
+	b->recordMs += std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+int bench_indirect(size_t numObjects, size_t numFrames) {
+	const float pi2 = 6.28318530718f;
+	const float near = 0.01f, far = 100.0f;
+	const unsigned int numVirtual = 2;
+
+	if (!gfx_init()) {
+		fprintf(stderr, "indirect: no device.\n");
+		return 1;
+	}
+
+	GFXHeap *heap = gfx_create_heap(nullptr);
+	GFXDependency *dep = gfx_create_dep(nullptr, numVirtual);
+	GFXRenderer *renderer = gfx_create_renderer(heap, numVirtual);
+	dassert(heap && dep && renderer);
+
+	// Small offscreen target, only the CPU side is of interest.
+	dassert(gfx_renderer_attach(renderer, 0,
+		GFXAttachment{
+			.type = GFX_IMAGE_2D,
+			.flags = GFX_MEMORY_NONE,
+			.usage = GFX_IMAGE_READ,
+
+			.format = GFX_FORMAT_R8G8B8A8_UNORM,
+			.samples = 1,
+			.mipmaps = 1,
+			.layers = 1,
+
+			.size = GFX_SIZE_ABSOLUTE,
+			.width = 256,
+			.height = 256,
+			.depth = 1
+		}));
+
+	GFXPass *cullPass = gfx_renderer_add_pass(
+		renderer, GFX_PASS_COMPUTE_INLINE, 0, 0, nullptr);
+	GFXPass *pass = gfx_renderer_add_pass(
+		renderer, GFX_PASS_RENDER, 0, 1, &cullPass);
+	dassert(cullPass && pass);
+	dassert(gfx_pass_consume(
+		pass, 0, GFX_ACCESS_ATTACHMENT_WRITE, GFX_STAGE_ANY));
+
+	GFXRecorder *recorder = gfx_renderer_add_recorder(renderer);
+	dassert(recorder);
+
+	GFXShader *shaders[] = {
+		load_shader(GFX_STAGE_VERTEX, "assets/basic.vert"),
+		load_shader(GFX_STAGE_FRAGMENT, "assets/basic.frag"),
+		load_shader(GFX_STAGE_COMPUTE, "assets/cull.comp")
+	};
+
+	GFXTechnique *tech = gfx_renderer_add_tech(renderer, 2, shaders);
+	GFXTechnique *cullTech = gfx_renderer_add_tech(renderer, 1, shaders + 2);
+	dassert(tech && cullTech);
+	dassert(gfx_tech_dynamic(tech, 0, 0));
+	dassert(gfx_tech_dynamic(tech, 1, 0));
+	dassert(gfx_tech_lock(tech));
+	dassert(gfx_tech_dynamic(cullTech, 0, 2));
+	dassert(gfx_tech_lock(cullTech));
+
+	// One cube shared by all objects, which is also its own span.
+	std::vector<float> vertices;
+	std::vector<uint16_t> indices;
+	cube_geometry(vertices, indices);
+
+	GFXBuffer *buffer = gfx_alloc_buffer(
+		heap, GFX_MEMORY_WRITE, GFX_BUFFER_VERTEX | GFX_BUFFER_INDEX,
+		vertices.size() * sizeof(float) + indices.size() * sizeof(uint16_t));
+	dassert(buffer);
+
+	const GFXRegion regions[] = {
+		{ .offset = 0, .rowSize = 0, .numRows = 0 },
+		{ .offset = vertices.size() * sizeof(float), .rowSize = 0, .numRows = 0 }
+	};
+
+	dassert(gfx_write(
+		vertices.data(), gfx_ref_buffer(buffer),
+		GFX_TRANSFER_BLOCK, 1, 0, regions, regions, nullptr));
+	dassert(gfx_write(
+		indices.data(), gfx_ref_buffer(buffer),
+		GFX_TRANSFER_BLOCK, 1, 0, regions, regions + 1, nullptr));
+
+	const GFXBufferRef vertexRef = gfx_ref_buffer(buffer);
+	const GFXAttribute attribs[] = {
+		{ GFX_FORMAT_R32G32B32_SFLOAT, 0,
+			sizeof(float) * 8, GFX_RATE_VERTEX, vertexRef },
+		{ GFX_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3,
+			sizeof(float) * 8, GFX_RATE_VERTEX, vertexRef },
+		{ GFX_FORMAT_R32G32_SFLOAT, sizeof(float) * 6,
+			sizeof(float) * 8, GFX_RATE_VERTEX, vertexRef }
+	};
+
+	GFXPrimitive *cube = gfx_alloc_prim(
+		heap, GFX_MEMORY_NONE, GFX_BUFFER_NONE, GFX_TOPO_TRIANGLE_LIST,
+		(uint32_t)indices.size(), sizeof(uint16_t), (uint32_t)(vertices.size() / 8),
+		gfx_ref_buffer_at(buffer, regions[1].offset),
+		sizeof(attribs)/sizeof(GFXAttribute), attribs);
+	dassert(cube);
+
+	// A square grid of cubes around the camera.
+	std::vector<GFXSet*> sets(numVirtual);
+	for (unsigned int f = 0; f < numVirtual; ++f) {
+		sets[f] = gfx_renderer_add_set(
+			renderer, tech, 0,
+			0, 0, 0, 0,
+			nullptr, nullptr, nullptr, nullptr);
+		dassert(sets[f]);
+	}
+
+	auto graph = std::make_unique<GraphNode>();
+	const size_t side = (size_t)ceil(sqrt((double)numObjects));
+	const aabb<float> bounds(
+		vec3<float>(-0.5f, -0.5f, -0.5f), vec3<float>(0.5f, 0.5f, 0.5f));
+
+	for (size_t o = 0; o < numObjects; ++o) {
+		auto mesh = std::make_unique<MeshNode>(affine3x4<float>(
+			0.5f, 0.0f, 0.0f, (float)(o % side) - (float)side * 0.5f,
+			0.0f, 0.5f, 0.0f, -1.0f,
+			0.0f, 0.0f, 0.5f, (float)(o / side) - (float)side * 0.5f));
+
+		const size_t i = mesh->addPrimitive(MeshNode::Primitive{
+			tech, cube, bounds, {}, {}, {}, (uint32_t)indices.size(),
+			MeshNode::SharedRange{ cube, 0, 0 } });
+
+		dassert(mesh->setForward(i, pass, nullptr));
+		dassert(mesh->assignSets(i, sets));
+		graph->addChild(std::move(mesh));
+	}
+
+	graph->update();
+
+	auto data = std::make_unique<FrameData>(
+		heap, numVirtual, (uint32_t)graph->writes(), sizeof(float) * 12,
+		GFX_MEMORY_NONE, GFX_BUFFER_UNIFORM);
+	auto transforms = std::make_unique<FrameData>(
+		heap, numVirtual, 1, (uint32_t)data->frameSize(),
+		GFX_MEMORY_NONE, GFX_BUFFER_STORAGE);
+	auto depth = std::make_unique<FrameData>(
+		heap, numVirtual, 1, sizeof(DepthHeader),
+		GFX_MEMORY_NONE, GFX_BUFFER_STORAGE);
+	auto lightData = std::make_unique<FrameData>(
+		heap, numVirtual, 1, (uint32_t)LightClusters::bufferSize(),
+		GFX_MEMORY_NONE, GFX_BUFFER_STORAGE);
+
+	std::vector<GFXSet*> lightSets(numVirtual);
+	for (unsigned int f = 0; f < numVirtual; ++f) {
+		const GFXSetGroup groups[] = {
+			data->getAsGroup(f, 0),
+			transforms->getAsGroup(f, 1)
+		};
+		dassert(gfx_set_groups(sets[f], 2, groups));
+
+		const GFXSetGroup lightGroup = lightData->getAsGroup(f, 0);
+		lightSets[f] = gfx_renderer_add_set(
+			renderer, tech, 1,
+			0, 1, 0, 0,
+			nullptr, &lightGroup, nullptr, nullptr);
+		dassert(lightSets[f]);
+	}
+
+	auto textures = std::make_unique<TextureStreamer>(
+		renderer, heap, dep, tech, 2, 1 << 20);
+
+	// Static scene, no lights & no occlusion, staged once.
+	SceneSnapshot snap = {};
+	snap.views.resize(1);
+	snap.views[0].viewProj = smat_chain(
+		smat_perspective(pi2 / 4.0f, 1.0f, near, far),
+		smat_rotate_x(0.3f)).dense();
+	snap.views[0].depthOffset = 0;
+
+	snap.transforms.resize(data->frameSize());
+	data->setStaging(snap.transforms.data());
+	graph->write(data.get());
+
+	std::vector<uint8_t> lights(lightData->frameSize());
+	LightClusters clusters(nullptr);
+	clusters.gather(graph.get());
+	clusters.bin(snap.views[0].viewProj, near, far, lights.data());
+
+	std::vector<uint8_t> noDepth(depth->frameSize(), 0);
+
+	IndirectBench b = {
+		tech, graph.get(), nullptr, lightSets.data(), textures.get(), &snap, 0.0 };
+
+	auto run = [&](const char *name) {
+		std::vector<double> recordMs;
+
+		for (size_t f = 0; f < numFrames; ++f) {
+			GFXFrame *frame = gfx_renderer_acquire(renderer);
+			gfx_frame_start(frame);
+
+			const unsigned int index = gfx_frame_get_index(frame);
+			data->upload(index, snap.transforms.data());
+			transforms->upload(index, snap.transforms.data());
+			depth->upload(index, noDepth.data());
+			lightData->upload(index, lights.data());
+
+			b.recordMs = 0.0;
+
+			if (b.indirect) {
+				gfx_pass_inject(cullPass, 1, ref(b.indirect->signal()));
+				gfx_recorder_compute(recorder, cullPass, bench_cull, &b);
+
+				const GFXInject waits[] = { gfx_dep_wait(dep), b.indirect->wait() };
+				gfx_pass_inject(pass, 2, waits);
+			}
+			else
+				gfx_pass_inject(pass, 1, ref(gfx_dep_wait(dep)));
+
+			gfx_recorder_render(recorder, pass, bench_render, &b);
+			gfx_frame_submit(frame);
+
+			recordMs.push_back(b.recordMs);
+		}
+
+		double sum = 0.0;
+		for (double m : recordMs) sum += m;
+		std::sort(recordMs.begin(), recordMs.end());
+
+		printf("%-10s avg %.3f ms, p50 %.3f ms, p99 %.3f ms, %.1f ns/object\n",
+			name, sum / (double)numFrames,
+			recordMs[numFrames / 2], recordMs[numFrames * 99 / 100],
+			sum / (double)numFrames * 1e6 / (double)GFX_MAX(numObjects, (size_t)1));
+	};
+
+	printf("indirect: %zu objects, %zu frames, record time (CPU)\n",
+		numObjects, numFrames);
+
+	if (numFrames > 0) {
+		// Building flags all objects as indirect, so per object goes first.
+		run("per-object");
+
+		IndirectDraws indirect(renderer, heap, cullTech, 1);
+		dassert(indirect.build(
+			graph.get(), pass, data.get(), transforms.get(), depth.get()));
+		b.indirect = &indirect;
+
+		run("indirect");
+		printf("%-10s %zu multi-draws\n", "", indirect.stats().groups);
+
+		// Before its buffers are freed.
+		gfx_renderer_block(renderer);
+	}
+
+	gfx_renderer_block(renderer);
+	textures.reset();
+	gfx_destroy_renderer(renderer);
+	gfx_free_prim(cube);
+	gfx_free_buffer(buffer);
+	graph.reset();
+	data.reset();
+	transforms.reset();
+	depth.reset();
+	lightData.reset();
+	gfx_destroy_heap(heap);
+	gfx_destroy_dep(dep);
+
+	for (GFXShader *shader : shaders)
+		gfx_destroy_shader(shader);
+
+	gfx_terminate();
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <stdio.h>
+#include "assets.h"
+#include "bench.h"
+
+// Progress lines printed over the whole run.
+#define INSTANCES_STEPS 10
+
+int bench_instances(const char *path, size_t numInstances) {
+	using clock = std::chrono::steady_clock;
+
+	if (!gfx_init()) {
+		fprintf(stderr, "instances: no device.\n");
+		return 1;
+	}
+
+	GFXHeap *heap = gfx_create_heap(nullptr);
+	GFXDependency *dep = gfx_create_dep(nullptr, 2);
+	dassert(heap && dep);
+
+	auto ms = [](clock::time_point a, clock::time_point b) {
+		return std::chrono::duration<double, std::milli>(b - a).count();
+	};
+
+	int result = 0;
+	{
+		JobPool jobs;
+		GeometryArena arena(heap, dep);
+		AssetCache cache(heap, &arena, &jobs);
+
+		// Only instances are kept, the cache must share their asset.
+		std::vector<std::unique_ptr<GraphNode>> instances;
+		instances.reserve(numInstances);
+
+		uint64_t firstBytes = 0, maxBytes = 0;
+		double firstMs = 0.0, stepMs = 0.0, maxStepMs = 0.0;
+		size_t stepLoads = 0;
+		const size_t step = numInstances > INSTANCES_STEPS ? numInstances / INSTANCES_STEPS : 1;
+
+		printf("instances: %s, %zu instances\n", path, numInstances);
+
+		for (size_t i = 0; i < numInstances; ++i) {
+			const auto t0 = clock::now();
+			std::shared_ptr<GltfAsset> asset = cache.load(path);
+			const auto t1 = clock::now();
+
+			if (!asset) {
+				fprintf(stderr, "Could not load %s\n", path);
+				result = 1;
+				break;
+			}
+
+			// No pass, so no renderables, the asset's resources are shared all the same.
+			instances.push_back(asset->instantiate(nullptr, nullptr, {}, nullptr));
+
+			const double loadMs = ms(t0, t1);
+			const AssetCache::Stats stats = cache.stats();
+
+			if (i == 0) {
+				firstMs = loadMs;
+				firstBytes = stats.residentBytes;
+				printf("first:   load %.3f ms, %zu resident, %llu KiB resident\n",
+					loadMs, stats.resident, (unsigned long long)(stats.residentBytes / 1024));
+				continue;
+			}
+
+			maxBytes = GFX_MAX(maxBytes, stats.residentBytes);
+			stepMs += loadMs;
+			++stepLoads;
+
+			if ((i + 1) % step == 0 || i + 1 == numInstances) {
+				const double avgMs = stepMs / (double)stepLoads;
+				maxStepMs = GFX_MAX(maxStepMs, avgMs);
+
+				printf("%-7zu  load %.3f ms avg, %zu resident, %llu KiB resident, %.1f%% hits\n",
+					i + 1, avgMs, stats.resident,
+					(unsigned long long)(stats.residentBytes / 1024), stats.hitRate() * 100.0);
+
+				stepMs = 0.0;
+				stepLoads = 0;
+			}
+		}
+
+		if (result == 0) {
+			printf("result: first load %.3f ms, later loads at most %.3f ms avg, "
+				"resident %llu KiB after the first, %llu KiB at most\n",
+				firstMs, maxStepMs,
+				(unsigned long long)(firstBytes / 1024), (unsigned long long)(maxBytes / 1024));
+
+			if (maxBytes > firstBytes) {
+				fprintf(stderr, "Resident bytes grew with the number of instances\n");
+				result = 1;
+			}
+		}
+
+		// Nothing references the asset anymore.
+		instances.clear();
+		cache.purge();
+
+		const AssetCache::Stats stats = cache.stats();
+		printf("purged:  %zu resident, %llu KiB resident\n",
+			stats.resident, (unsigned long long)(stats.residentBytes / 1024));
+	}
+
+	gfx_destroy_heap(heap);
+	gfx_destroy_dep(dep);
+	gfx_terminate();
+
+	return result;
+}
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include "bench.h"
+#include "graph.h"
+#include "light.h"
+#include "math/chain.h"
+
+int bench_lights(size_t numLights, size_t numFrames) {
+	const float pi2 = 6.28318530718f;
+	const float near = 0.01f, far = 100.0f;
+
+	JobPool jobs;
+	LightClusters clusters(&jobs);
+	GraphNode root;
+
+	// Scattered around the camera, mostly point lights,
+	// a few spots & one directional light.
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-30.0f, 30.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (size_t l = 0; l < numLights; ++l) {
+		auto light = std::make_unique<LightNode>(affine3x4<float>(
+			1.0f, 0.0f, 0.0f, pos(rng),
+			0.0f, 1.0f, 0.0f, pos(rng) * 0.25f,
+			0.0f, 0.0f, 1.0f, pos(rng)));
+
+		light->type =
+			(l == 0) ? LightNode::DIRECTIONAL :
+			(l % 8 == 0) ? LightNode::SPOT : LightNode::POINT;
+
+		light->color = vec3<float>(unit(rng), unit(rng), unit(rng));
+		light->intensity = 2.0f;
+		light->range = 0.5f + 1.5f * unit(rng);
+
+		root.addChild(std::move(light));
+	}
+
+	root.update();
+	clusters.gather(&root);
+
+	std::vector<uint8_t> out(LightClusters::bufferSize());
+	std::vector<double> binMs;
+	size_t binned = 0, indices = 0, maxPerCluster = 0;
+	bool overflow = false;
+
+	for (size_t f = 0; f < numFrames; ++f) {
+		// Turn around once over all frames.
+		const float yaw = pi2 * (float)f / (float)numFrames;
+		const mat4<float> viewProj = smat_chain(
+			smat_perspective(pi2 / 4.0f, 16.0f / 9.0f, near, far),
+			smat_rotate_y(-yaw)).dense();
+
+		clusters.bin(viewProj, near, far, out.data());
+
+		const LightClusters::Stats &stats = clusters.stats();
+		binMs.push_back(stats.binMs);
+		binned += stats.binned;
+		indices += stats.indices;
+		overflow = overflow || stats.overflow;
+
+		// Bounds the per-pixel shading cost.
+		const uint32_t *grid = (const uint32_t*)(
+			out.data() + sizeof(ClusterHeader) + sizeof(GpuLight) * MAX_LIGHTS);
+
+		for (size_t c = 0; c < CLUSTER_X * CLUSTER_Y * CLUSTER_Z; ++c)
+			maxPerCluster = std::max(maxPerCluster, (size_t)grid[c * 2 + 1]);
+	}
+
+	printf("lights: %zu lights, %dx%dx%d clusters, %zu threads, %zu frames\n",
+		numLights, CLUSTER_X, CLUSTER_Y, CLUSTER_Z, jobs.numThreads(), numFrames);
+
+	if (numFrames > 0) {
+		double sum = 0.0;
+		for (double m : binMs) sum += m;
+		std::sort(binMs.begin(), binMs.end());
+
+		printf("bin        avg %.3f ms, p50 %.3f ms, p99 %.3f ms, %.1f ns/light\n",
+			sum / (double)numFrames,
+			binMs[numFrames / 2], binMs[numFrames * 99 / 100],
+			sum / (double)numFrames * 1e6 / (double)GFX_MAX(numLights, (size_t)1));
+
+		printf("binned     %.1f lights, %.1f indices avg, at most %zu per cluster%s\n",
+			(double)binned / (double)numFrames, (double)indices / (double)numFrames,
+			maxPerCluster, overflow ? ", overflowed" : "");
+	}
+
+	return 0;
+}
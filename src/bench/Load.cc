@@ -0,0 +1,297 @@
+#include <chrono>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+#include "assets.h"
+#include "bench.h"
+
+#define LOAD_RUNS 3
+#define LOAD_TARGET 5.0 // Speedup asked of the fast .gltf path over gfx_load_gltf.
+
+// Builds a document of about `mib` MiB of geometry, stored both as
+// .gltf with a base64 data URI and as .glb. Vertices interleave float
+// positions with normalized 8 bits normals, indices cycle through all
+// three component types so every conversion path is exercised.
+static void build_scene(size_t mib, std::vector<uint8_t> &gltf, std::vector<uint8_t> &glb) {
+	const uint32_t numVerts = 50000;
+	const int indexTypes[] = { 5121, 5123, 5125 };
+
+	std::vector<uint8_t> bin;
+	std::string meshes, accessors, views;
+
+	for (size_t p = 0; bin.size() < (mib << 20); ++p) {
+		const int indexType = indexTypes[p % 3];
+		const size_t indexSize = (indexType == 5121) ? 1 : (indexType == 5123) ? 2 : 4;
+		const uint32_t maxIndex = (indexType == 5121) ? 255 : numVerts - 1;
+		const uint32_t numIndices = numVerts * 3;
+
+		const size_t vertOffset = bin.size();
+		bin.resize(vertOffset + (size_t)numVerts * 16);
+
+		for (uint32_t v = 0; v < numVerts; ++v) {
+			const float pos[3] = { (float)v, (float)p, (float)(v ^ p) };
+			const int8_t nrm[4] = { 0, 127, 0, 0 };
+			memcpy(bin.data() + vertOffset + v * 16, pos, 12);
+			memcpy(bin.data() + vertOffset + v * 16 + 12, nrm, 4);
+		}
+
+		const size_t indexOffset = bin.size();
+		bin.resize(indexOffset + ((numIndices * indexSize + 3) & ~(size_t)3));
+
+		for (uint32_t i = 0; i < numIndices; ++i) {
+			const uint32_t index = (i * 7919u) % (maxIndex + 1);
+			memcpy(bin.data() + indexOffset + i * indexSize, &index, indexSize);
+		}
+
+		const size_t a = p * 3;
+		char buf[1024];
+
+		snprintf(buf, sizeof(buf),
+			"%s{\"primitives\":[{\"attributes\":{\"POSITION\":%zu,\"NORMAL\":%zu},\"indices\":%zu}]}",
+			p ? "," : "", a, a + 1, a + 2);
+		meshes += buf;
+
+		snprintf(buf, sizeof(buf),
+			"%s{\"bufferView\":%zu,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\","
+			"\"min\":[0,0,0],\"max\":[1,1,1]},"
+			"{\"bufferView\":%zu,\"byteOffset\":12,\"componentType\":5120,\"normalized\":true,"
+			"\"count\":%u,\"type\":\"VEC3\"},"
+			"{\"bufferView\":%zu,\"componentType\":%d,\"count\":%u,\"type\":\"SCALAR\"}",
+			p ? "," : "", p * 2, numVerts, p * 2, numVerts, p * 2 + 1, indexType, numIndices);
+		accessors += buf;
+
+		snprintf(buf, sizeof(buf),
+			"%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"byteStride\":16},"
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}",
+			p ? "," : "", vertOffset, (size_t)numVerts * 16, indexOffset, numIndices * indexSize);
+		views += buf;
+	}
+
+	auto document = [&](const std::string &uri) {
+		return
+			"{\"asset\":{\"version\":\"2.0\"},\"meshes\":[" + meshes +
+			"],\"accessors\":[" + accessors + "],\"bufferViews\":[" + views +
+			"],\"buffers\":[{" + uri + "\"byteLength\":" + std::to_string(bin.size()) + "}]}";
+	};
+
+	// Base64 encode for the .gltf.
+	static const char *chars =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string uri = "\"uri\":\"data:application/octet-stream;base64,";
+	uri.reserve(uri.size() + bin.size() / 3 * 4 + 8);
+
+	for (size_t i = 0; i < bin.size(); i += 3) {
+		const size_t left = bin.size() - i;
+		const uint32_t v =
+			(uint32_t)bin[i] << 16 |
+			(left > 1 ? (uint32_t)bin[i + 1] << 8 : 0) |
+			(left > 2 ? (uint32_t)bin[i + 2] : 0);
+
+		uri += chars[v >> 18];
+		uri += chars[(v >> 12) & 63];
+		uri += left > 1 ? chars[(v >> 6) & 63] : '=';
+		uri += left > 2 ? chars[v & 63] : '=';
+	}
+
+	uri += "\",";
+
+	const std::string json = document(uri);
+	gltf.assign(json.begin(), json.end());
+
+	// Header, JSON chunk padded with spaces, BIN chunk.
+	std::string glbJson = document("");
+	glbJson.resize((glbJson.size() + 3) & ~(size_t)3, ' ');
+
+	const uint32_t header[5] = {
+		0x46546C67, 2,
+		(uint32_t)(12 + 8 + glbJson.size() + 8 + bin.size()),
+		(uint32_t)glbJson.size(), 0x4E4F534A
+	};
+	const uint32_t binHeader[2] = { (uint32_t)bin.size(), 0x004E4942 };
+
+	glb.resize(sizeof(header));
+	memcpy(glb.data(), header, sizeof(header));
+	glb.insert(glb.end(), glbJson.begin(), glbJson.end());
+	glb.insert(glb.end(), (const uint8_t*)binHeader, (const uint8_t*)(binHeader + 2));
+	glb.insert(glb.end(), bin.begin(), bin.end());
+}
+
+static bool write_bytes(const std::string &path, const std::vector<uint8_t> &bytes) {
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+
+	const bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	return fclose(file) == 0 && ok;
+}
+
+// The generic path: groufix reads, decodes & uploads the whole document.
+static bool load_generic(
+		GFXHeap *heap, GFXDependency *dep, const char *path, GFXGltfResult &out) {
+	GFXFile file;
+	if (!gfx_file_init(&file, path, "rb"))
+		return false;
+
+	GFXFileIncluder inc;
+	if (!gfx_file_includer_init(&inc, path, "rb")) {
+		gfx_file_clear(&file);
+		return false;
+	}
+
+	// Same attributes as the fast path converts.
+	const char *attributeOrder[] = {
+		"POSITION",
+		"NORMAL",
+		"TEXCOORD_0"
+	};
+
+	const GFXGltfOptions opts = {
+		.maxAttributes = sizeof(attributeOrder)/sizeof(char*),
+		.orderSize = sizeof(attributeOrder)/sizeof(char*),
+		.attributeOrder = attributeOrder
+	};
+
+	const bool loaded = gfx_load_gltf(
+		heap, dep, &opts,
+		GFX_IMAGE_ANY_FORMAT, GFX_IMAGE_SAMPLED,
+		&file.reader, &inc.includer, &out);
+
+	gfx_file_includer_clear(&inc);
+	gfx_file_clear(&file);
+
+	if (!loaded) out = GFXGltfResult{};
+	return loaded;
+}
+
+static void free_generic(GFXGltfResult &result) {
+	for (size_t p = 0; p < result.numPrimitives; ++p)
+		gfx_free_prim(result.primitives[p].primitive);
+	for (size_t b = 0; b < result.numBuffers; ++b)
+		gfx_free_buffer(result.buffers[b]);
+	for (size_t i = 0; i < result.numImages; ++i)
+		gfx_free_image(result.images[i]);
+
+	gfx_release_gltf(&result);
+}
+
+int bench_load(const char *path, size_t syntheticMiB) {
+	using clock = std::chrono::steady_clock;
+
+	auto ms = [](clock::time_point a, clock::time_point b) {
+		return std::chrono::duration<double, std::milli>(b - a).count();
+	};
+
+	// Documents to compare, synthetic ones are written out for groufix to read.
+	std::vector<std::string> paths;
+	std::vector<std::string> temporary;
+
+	if (path)
+		paths.push_back(path);
+	else {
+		std::vector<uint8_t> gltf, glb;
+		build_scene(syntheticMiB, gltf, glb);
+
+		std::error_code err;
+		const std::filesystem::path dir = std::filesystem::temp_directory_path(err);
+		temporary.push_back((dir / "fiezta-load.gltf").string());
+		temporary.push_back((dir / "fiezta-load.glb").string());
+
+		if (err ||
+			!write_bytes(temporary[0], gltf) ||
+			!write_bytes(temporary[1], glb))
+		{
+			fprintf(stderr, "Could not write the synthetic scene\n");
+			for (const std::string &t : temporary) std::remove(t.c_str());
+			return 1;
+		}
+
+		paths = temporary;
+	}
+
+	if (!gfx_init()) {
+		fprintf(stderr, "load: no device.\n");
+		for (const std::string &t : temporary) std::remove(t.c_str());
+		return 1;
+	}
+
+	GFXHeap *heap = gfx_create_heap(nullptr);
+	GFXDependency *dep = gfx_create_dep(nullptr, 2);
+	dassert(heap && dep);
+
+	int result = 0;
+	double gltfSpeedup = 0.0;
+	{
+		JobPool jobs;
+		GeometryArena arena(heap, dep);
+
+		printf("load: %zu threads, best of %d runs\n", jobs.numThreads(), LOAD_RUNS);
+
+		for (const std::string &p : paths) {
+			// Both read the file, upload all geometry & flush the heap.
+			double generic = 0.0, fast = 0.0;
+			bool isGlb = false;
+
+			for (size_t r = 0; r < LOAD_RUNS && result == 0; ++r) {
+				GFXGltfResult gfx;
+				const auto t0 = clock::now();
+				const bool genericOk = load_generic(heap, dep, p.c_str(), gfx) && gfx_heap_flush(heap);
+				const auto t1 = clock::now();
+
+				if (genericOk) free_generic(gfx);
+
+				std::vector<uint8_t> bytes;
+				const auto t2 = clock::now();
+				const bool read = read_file(p, bytes);
+				isGlb = read && bytes.size() >= 4 && memcmp(bytes.data(), "glTF", 4) == 0;
+
+				std::shared_ptr<GltfAsset> asset = read ? GltfAsset::load(
+					heap, &arena, &jobs, nullptr, false, p.c_str(), std::move(bytes)) : nullptr;
+				const bool fastOk = asset && gfx_heap_flush(heap);
+				const auto t3 = clock::now();
+
+				asset.reset();
+
+				if (!genericOk || !fastOk) {
+					fprintf(stderr, "Could not load %s through %s\n",
+						p.c_str(), genericOk ? "the fast path" : "gfx_load_gltf");
+					result = 1;
+					break;
+				}
+
+				if (r == 0 || ms(t0, t1) < generic) generic = ms(t0, t1);
+				if (r == 0 || ms(t2, t3) < fast) fast = ms(t2, t3);
+			}
+
+			if (result != 0)
+				break;
+
+			const double speedup = generic / fast;
+			if (!isGlb) gltfSpeedup = speedup;
+
+			printf("%-4s %s: gfx_load_gltf %.1f ms, fast %.1f ms, %.1fx\n",
+				isGlb ? "glb" : "gltf", p.c_str(), generic, fast, speedup);
+		}
+	}
+
+	gfx_destroy_heap(heap);
+	gfx_destroy_dep(dep);
+	gfx_terminate();
+
+	for (const std::string &t : temporary)
+		std::remove(t.c_str());
+
+	if (result != 0)
+		return result;
+
+	// The target is for .gltf, .glb skips base64 & most of the JSON.
+	if (gltfSpeedup <= 0.0) {
+		printf("result: no .gltf document, the %.0fx target is not verified\n", LOAD_TARGET);
+		return 0;
+	}
+
+	const bool met = gltfSpeedup >= LOAD_TARGET;
+	printf("result: gltf %.1fx, %s the %.0fx target\n",
+		gltfSpeedup, met ? "meets" : "misses", LOAD_TARGET);
+
+	return met ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "def.h"
+#include "jobs.h"
+#include "math/aabb.h"
+#include "memory.h"
+
+class GraphNode;
+class MeshNode;
+
+// Local-space triangle soup used to fill the occlusion buffer.
+struct OccluderMesh {
+	std::vector<float> positions; // xyz.
+	std::vector<uint32_t> indices;
+
+	size_t numTriangles() const { return indices.size() / 3; }
+
+	MemCharge charge = { MEM_CULLING };
+};
+
+// Most levels of a depth hierarchy as read by the GPU.
+#define OCCLUSION_MAX_LEVELS 16
+
+// Depth hierarchy as read by the GPU (see assets/cull.comp),
+// followed by all levels, tightly packed.
+struct DepthHeader {
+	uint32_t numLevels; // 0 to skip occlusion tests.
+	uint32_t pad[3];
+	uint32_t levels[OCCLUSION_MAX_LEVELS][4]; // Width, height, offset in floats, 0.
+};
+
+// Low resolution software depth buffer with a min-depth hierarchy.
+// Uses the same reverse depth as the renderer, i.e. 1 is near, 0 is far.
+// Entirely CPU side, needs no device or window.
+class OcclusionBuffer {
+public:
+	struct Occluder {
+		const OccluderMesh *mesh;
+		mat4<float> transform; // Object -> clip space.
+	};
+
+	// Width is rounded up to a multiple of 4.
+	OcclusionBuffer(uint32_t width, uint32_t height);
+
+	uint32_t width() { return w; }
+	uint32_t height() { return h; }
+
+	// Clears, rasterizes all occluders and builds the hierarchy.
+	// Returns the number of triangles that were set up.
+	size_t rasterize(JobPool *jobs, const std::vector<Occluder> &occluders);
+
+	// Conservative test, false only if the box is entirely hidden
+	// or entirely outside the view.
+	bool visible(const mat4<float> &transform, const aabb<float> &box);
+
+	// Bytes of a DepthHeader & all levels.
+	size_t hierarchySize();
+
+	// As of the last rasterize(), into hierarchySize() bytes.
+	void copyHierarchy(void *out);
+
+	// Depth at level 0, for debugging.
+	float depth(uint32_t x, uint32_t y) { return levels[0].data[y * w + x]; }
+
+private:
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> data;
+	};
+
+	// Screen-space triangle, z is linear in screen space.
+	struct Triangle {
+		float x[3];
+		float y[3];
+		float z[3];
+		bool valid;
+	};
+
+	void binTriangles(uint32_t numBands);
+	void rasterizeBand(uint32_t band, uint32_t y0, uint32_t y1);
+	void buildHierarchy();
+
+	uint32_t w;
+	uint32_t h;
+	std::vector<Level> levels;
+	std::vector<Triangle> tris;
+	std::vector<size_t> firstTris;
+
+	// Triangles overlapping each band, bandTris[bandFirst[b]...bandFirst[b+1]).
+	std::vector<uint32_t> bandTris;
+	std::vector<uint32_t> bandFirst;
+
+	MemCharge charge = { MEM_CULLING };
+};
+
+// Picks occluders & candidates from a graph and culls candidates each frame.
+class OcclusionCuller {
+public:
+	struct Stats {
+		size_t occluders;
+		size_t occluderTris;
+		size_t candidates;
+		size_t culled;
+		double rasterMs;
+		double testMs;
+
+		double culledPercent() const {
+			return candidates > 0 ? 100.0 * (double)culled / (double)candidates : 0.0;
+		}
+	};
+
+	OcclusionCuller(JobPool *jobs, uint32_t width = 256, uint32_t height = 128);
+
+	// (Re)collect all mesh nodes of a graph.
+	void gather(GraphNode *graph);
+
+	// Must be called after the graph is updated.
+	// Marks primitives of all gathered mesh nodes visible or not,
+	// skips those culled on the GPU.
+	void cull(const mat4<float> &viewProj);
+
+	// Depth hierarchy of the last cull(), for culling on the GPU,
+	// without any levels if disabled.
+	size_t hierarchySize() { return buffer.hierarchySize(); }
+	void copyHierarchy(void *out);
+
+	const Stats &stats() { return last; }
+
+	bool enabled = true;
+
+private:
+	void gatherNode(GraphNode *node);
+
+	JobPool *jobs;
+	OcclusionBuffer buffer;
+
+	struct OccluderRef {
+		MeshNode *node;
+		const OccluderMesh *mesh;
+	};
+
+	std::vector<MeshNode*> meshes;
+	std::vector<OccluderRef> occluderRefs;
+	std::vector<OcclusionBuffer::Occluder> occluders;
+
+	Stats last;
+};
@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "cull.h"
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#define OCCLUSION_BAND_HEIGHT 8
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) :
+	w((width + 3) & ~3u), h(height > 0 ? height : 1) {
+	// Full hierarchy down to 1x1.
+	uint32_t lw = w, lh = h;
+	while (true) {
+		levels.push_back(Level{lw, lh, std::vector<float>((size_t)lw * lh, 0.0f)});
+		if (lw == 1 && lh == 1) break;
+
+		lw = (lw + 1) / 2;
+		lh = (lh + 1) / 2;
+	}
+
+	uint64_t bytes = 0;
+	for (const auto &level : levels)
+		bytes += level.data.size() * sizeof(float);
+
+	charge.set(bytes);
+}
+
+static inline void transform4(const mat4<float> &m, const float *p, float *out) {
+	for (size_t r = 0; r < 4; ++r)
+		out[r] = m[r][0] * p[0] + m[r][1] * p[1] + m[r][2] * p[2] + m[r][3];
+}
+
+size_t OcclusionBuffer::rasterize(JobPool *jobs, const std::vector<Occluder> &occluders) {
+	size_t total = 0;
+	for (const auto &occ : occluders)
+		total += occ.mesh->numTriangles();
+
+	if (total > tris.capacity())
+		charge.set(charge.get() + (total - tris.capacity()) * sizeof(Triangle));
+
+	tris.resize(total);
+
+	// Setup, one occluder per chunk.
+	size_t first = 0;
+	firstTris.resize(occluders.size());
+	for (size_t o = 0; o < occluders.size(); ++o)
+		firstTris[o] = first, first += occluders[o].mesh->numTriangles();
+
+	const float fw = (float)w;
+	const float fh = (float)h;
+
+	jobs->parallelFor(occluders.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t o = begin; o < end; ++o) {
+			const OccluderMesh *mesh = occluders[o].mesh;
+			const mat4<float> &mvp = occluders[o].transform;
+
+			for (size_t t = 0; t < mesh->numTriangles(); ++t) {
+				Triangle &tri = tris[firstTris[o] + t];
+				tri.valid = true;
+
+				for (size_t v = 0; v < 3; ++v) {
+					const uint32_t index = mesh->indices[t * 3 + v];
+					float clip[4];
+					transform4(mvp, &mesh->positions[index * 3], clip);
+
+					// Crossing the near plane, skipping is conservative.
+					if (clip[3] < 1e-5f) {
+						tri.valid = false;
+						break;
+					}
+
+					const float invW = 1.0f / clip[3];
+					tri.x[v] = (clip[0] * invW * 0.5f + 0.5f) * fw;
+					tri.y[v] = (clip[1] * invW * 0.5f + 0.5f) * fh;
+					tri.z[v] = clip[2] * invW;
+				}
+			}
+		}
+	});
+
+	// Rasterize in horizontal bands, each band is owned by one thread.
+	const uint32_t numBands = (h + OCCLUSION_BAND_HEIGHT - 1) / OCCLUSION_BAND_HEIGHT;
+	binTriangles(numBands);
+
+	jobs->parallelFor(numBands, 1, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b) {
+			const uint32_t y0 = (uint32_t)b * OCCLUSION_BAND_HEIGHT;
+			const uint32_t y1 = y0 + OCCLUSION_BAND_HEIGHT < h ? y0 + OCCLUSION_BAND_HEIGHT : h;
+
+			std::fill(
+				levels[0].data.begin() + (size_t)y0 * w,
+				levels[0].data.begin() + (size_t)y1 * w, 0.0f);
+
+			rasterizeBand((uint32_t)b, y0, y1);
+		}
+	});
+
+	buildHierarchy();
+
+	return total;
+}
+
+void OcclusionBuffer::binTriangles(uint32_t numBands) {
+	// Bands a triangle's y extent overlaps, empty if off screen.
+	auto bands = [&](const Triangle &tri, uint32_t &b0, uint32_t &b1) {
+		const float minX = fminf(tri.x[0], fminf(tri.x[1], tri.x[2]));
+		const float maxX = fmaxf(tri.x[0], fmaxf(tri.x[1], tri.x[2]));
+		const float minY = fminf(tri.y[0], fminf(tri.y[1], tri.y[2]));
+		const float maxY = fmaxf(tri.y[0], fmaxf(tri.y[1], tri.y[2]));
+
+		if (!tri.valid ||
+			maxX < 0.0f || minX >= (float)w || maxY < 0.0f || minY >= (float)h)
+		{
+			return false;
+		}
+
+		b0 = (uint32_t)fmaxf(minY, 0.0f) / OCCLUSION_BAND_HEIGHT;
+		b1 = (uint32_t)fminf(maxY, (float)(h - 1)) / OCCLUSION_BAND_HEIGHT;
+		return true;
+	};
+
+	// Count per band, then place, so each bin is contiguous.
+	bandFirst.assign(numBands + 1, 0);
+	uint32_t b0, b1;
+
+	for (const auto &tri : tris)
+		if (bands(tri, b0, b1))
+			for (uint32_t b = b0; b <= b1; ++b) ++bandFirst[b + 1];
+
+	for (uint32_t b = 0; b < numBands; ++b)
+		bandFirst[b + 1] += bandFirst[b];
+
+	const size_t total = bandFirst[numBands];
+	if (total > bandTris.capacity())
+		charge.set(charge.get() + (total - bandTris.capacity()) * sizeof(uint32_t));
+
+	bandTris.resize(total);
+
+	for (size_t t = 0; t < tris.size(); ++t)
+		if (bands(tris[t], b0, b1))
+			for (uint32_t b = b0; b <= b1; ++b) bandTris[bandFirst[b]++] = (uint32_t)t;
+
+	// Placing advanced each start to the next band's.
+	for (uint32_t b = numBands; b > 0; --b)
+		bandFirst[b] = bandFirst[b - 1];
+
+	bandFirst[0] = 0;
+}
+
+void OcclusionBuffer::rasterizeBand(uint32_t band, uint32_t y0, uint32_t y1) {
+	float *depth = levels[0].data.data();
+
+	for (uint32_t i = bandFirst[band]; i < bandFirst[band + 1]; ++i) {
+		const Triangle &tri = tris[bandTris[i]];
+
+		float x0 = tri.x[0], x1 = tri.x[1], x2 = tri.x[2];
+		float py0 = tri.y[0], py1 = tri.y[1], py2 = tri.y[2];
+		float z0 = tri.z[0], z1 = tri.z[1], z2 = tri.z[2];
+
+		float area = (x1 - x0) * (py2 - py0) - (x2 - x0) * (py1 - py0);
+		if (fabsf(area) < 1e-8f) continue;
+
+		// Make counter clockwise (in buffer space), both sides are drawn.
+		if (area < 0.0f) {
+			std::swap(x1, x2);
+			std::swap(py1, py2);
+			std::swap(z1, z2);
+			area = -area;
+		}
+
+		// Bounding box clipped to the band.
+		const float minX = fminf(x0, fminf(x1, x2));
+		const float maxX = fmaxf(x0, fmaxf(x1, x2));
+		const float minY = fminf(py0, fminf(py1, py2));
+		const float maxY = fmaxf(py0, fmaxf(py1, py2));
+
+		if (maxX < 0.0f || minX >= (float)w || maxY < (float)y0 || minY >= (float)y1)
+			continue;
+
+		const uint32_t bx0 = (uint32_t)fmaxf(minX, 0.0f) & ~3u;
+		const uint32_t bx1 = (uint32_t)fminf(maxX, (float)(w - 1));
+		const uint32_t by0 = (uint32_t)fmaxf(minY, (float)y0);
+		const uint32_t by1 = (uint32_t)fminf(maxY, (float)(y1 - 1));
+
+		// Edge functions, E(x,y) = a*x + b*y + c, positive inside.
+		// Widened by a tiny bit so shared edges never leave cracks.
+		const float ea[3] = { py0 - py1, py1 - py2, py2 - py0 };
+		const float eb[3] = { x1 - x0, x2 - x1, x0 - x2 };
+		const float ec[3] = {
+			-(ea[0] * x0 + eb[0] * py0) + 1e-3f * (fabsf(ea[0]) + fabsf(eb[0])),
+			-(ea[1] * x1 + eb[1] * py1) + 1e-3f * (fabsf(ea[1]) + fabsf(eb[1])),
+			-(ea[2] * x2 + eb[2] * py2) + 1e-3f * (fabsf(ea[2]) + fabsf(eb[2]))
+		};
+
+		// Depth plane, pushed back to the farthest point in the pixel.
+		const float dzdx = ((z1 - z0) * (py2 - py0) - (z2 - z0) * (py1 - py0)) / area;
+		const float dzdy = ((x1 - x0) * (z2 - z0) - (x2 - x0) * (z1 - z0)) / area;
+		const float dzc =
+			z0 - dzdx * x0 - dzdy * py0 - 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+		const float minZ = fminf(z0, fminf(z1, z2));
+
+		for (uint32_t y = by0; y <= by1; ++y) {
+			const float cy = (float)y + 0.5f;
+			const float cx = (float)bx0 + 0.5f;
+			float *row = depth + (size_t)y * w;
+
+#if defined(__SSE2__)
+			const __m128 steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 vMinZ = _mm_set1_ps(minZ);
+
+			__m128 e[3], eStep[3];
+			for (size_t i = 0; i < 3; ++i) {
+				e[i] = _mm_add_ps(
+					_mm_set1_ps(ea[i] * cx + eb[i] * cy + ec[i]),
+					_mm_mul_ps(_mm_set1_ps(ea[i]), steps));
+				eStep[i] = _mm_set1_ps(ea[i] * 4.0f);
+			}
+
+			__m128 z = _mm_add_ps(
+				_mm_set1_ps(dzdx * cx + dzdy * cy + dzc),
+				_mm_mul_ps(_mm_set1_ps(dzdx), steps));
+			const __m128 zStep = _mm_set1_ps(dzdx * 4.0f);
+
+			for (uint32_t x = bx0; x <= bx1; x += 4) {
+				const __m128 inside = _mm_and_ps(
+					_mm_cmpge_ps(e[0], zero),
+					_mm_and_ps(_mm_cmpge_ps(e[1], zero), _mm_cmpge_ps(e[2], zero)));
+
+				if (_mm_movemask_ps(inside)) {
+					const __m128 d = _mm_loadu_ps(row + x);
+					const __m128 nd = _mm_max_ps(d, _mm_max_ps(z, vMinZ));
+					_mm_storeu_ps(row + x,
+						_mm_or_ps(_mm_and_ps(inside, nd), _mm_andnot_ps(inside, d)));
+				}
+
+				for (size_t i = 0; i < 3; ++i)
+					e[i] = _mm_add_ps(e[i], eStep[i]);
+				z = _mm_add_ps(z, zStep);
+			}
+#else
+			for (uint32_t x = bx0; x <= bx1; ++x) {
+				const float px = cx + (float)(x - bx0);
+				if (ea[0] * px + eb[0] * cy + ec[0] >= 0.0f &&
+					ea[1] * px + eb[1] * cy + ec[1] >= 0.0f &&
+					ea[2] * px + eb[2] * cy + ec[2] >= 0.0f)
+				{
+					const float z = fmaxf(dzdx * px + dzdy * cy + dzc, minZ);
+					row[x] = fmaxf(row[x], z);
+				}
+			}
+#endif
+		}
+	}
+}
+
+void OcclusionBuffer::buildHierarchy() {
+	// Each texel holds the farthest (i.e. smallest) depth below it.
+	for (size_t l = 1; l < levels.size(); ++l) {
+		const Level &src = levels[l - 1];
+		Level &dst = levels[l];
+
+		for (uint32_t y = 0; y < dst.height; ++y)
+			for (uint32_t x = 0; x < dst.width; ++x) {
+				const uint32_t sx0 = x * 2;
+				const uint32_t sy0 = y * 2;
+				const uint32_t sx1 = sx0 + 1 < src.width ? sx0 + 1 : sx0;
+				const uint32_t sy1 = sy0 + 1 < src.height ? sy0 + 1 : sy0;
+
+				dst.data[(size_t)y * dst.width + x] = fminf(
+					fminf(src.data[(size_t)sy0 * src.width + sx0],
+					      src.data[(size_t)sy0 * src.width + sx1]),
+					fminf(src.data[(size_t)sy1 * src.width + sx0],
+					      src.data[(size_t)sy1 * src.width + sx1]));
+			}
+	}
+}
+
+bool OcclusionBuffer::visible(const mat4<float> &transform, const aabb<float> &box) {
+	if (box.empty()) return true;
+
+	float minX = INFINITY, maxX = -INFINITY;
+	float minY = INFINITY, maxY = -INFINITY;
+	float maxZ = -INFINITY;
+	size_t behind = 0;
+
+	for (size_t c = 0; c < 8; ++c) {
+		const vec3<float> p = box.corner(c);
+		float clip[4];
+		transform4(transform, p.data, clip);
+
+		if (clip[3] < 1e-5f) {
+			++behind;
+			continue;
+		}
+
+		const float invW = 1.0f / clip[3];
+		const float sx = (clip[0] * invW * 0.5f + 0.5f) * (float)w;
+		const float sy = (clip[1] * invW * 0.5f + 0.5f) * (float)h;
+		const float sz = clip[2] * invW;
+
+		minX = fminf(minX, sx), maxX = fmaxf(maxX, sx);
+		minY = fminf(minY, sy), maxY = fmaxf(maxY, sy);
+		maxZ = fmaxf(maxZ, sz);
+	}
+
+	// Entirely behind the camera or straddling the near plane.
+	if (behind == 8) return false;
+	if (behind > 0) return true;
+
+	// Outside the view or beyond the far plane.
+	if (maxX < 0.0f || minX >= (float)w || maxY < 0.0f || minY >= (float)h || maxZ < 0.0f)
+		return false;
+
+	// Occluders are sampled at pixel centers, so they can cover up to half
+	// a pixel too much at their silhouette; dilate by a pixel to make up.
+	const uint32_t x0 = (uint32_t)fmaxf(minX - 1.0f, 0.0f);
+	const uint32_t x1 = (uint32_t)fminf(maxX + 1.0f, (float)(w - 1));
+	const uint32_t y0 = (uint32_t)fmaxf(minY - 1.0f, 0.0f);
+	const uint32_t y1 = (uint32_t)fminf(maxY + 1.0f, (float)(h - 1));
+
+	// Pick a level where the rectangle spans at most 3x3 texels.
+	const uint32_t extent = std::max(x1 - x0, y1 - y0) + 1;
+	size_t l = 0;
+	while (l + 1 < levels.size() && (extent >> l) > 2) ++l;
+
+	const Level &level = levels[l];
+	for (uint32_t y = y0 >> l; y <= (y1 >> l); ++y)
+		for (uint32_t x = x0 >> l; x <= (x1 >> l); ++x)
+			if (level.data[(size_t)y * level.width + x] <= maxZ)
+				return true;
+
+	return false;
+}
+
+size_t OcclusionBuffer::hierarchySize() {
+	size_t size = sizeof(DepthHeader);
+	for (size_t l = 0; l < levels.size() && l < OCCLUSION_MAX_LEVELS; ++l)
+		size += levels[l].data.size() * sizeof(float);
+
+	return size;
+}
+
+void OcclusionBuffer::copyHierarchy(void *out) {
+	DepthHeader header = {};
+	header.numLevels = (uint32_t)std::min(levels.size(), (size_t)OCCLUSION_MAX_LEVELS);
+
+	char *ptr = (char*)out + sizeof(DepthHeader);
+	uint32_t offset = 0;
+
+	for (size_t l = 0; l < header.numLevels; ++l) {
+		const Level &level = levels[l];
+		header.levels[l][0] = level.width;
+		header.levels[l][1] = level.height;
+		header.levels[l][2] = offset;
+
+		memcpy(ptr, level.data.data(), level.data.size() * sizeof(float));
+		ptr += level.data.size() * sizeof(float);
+		offset += (uint32_t)level.data.size();
+	}
+
+	memcpy(out, &header, sizeof(DepthHeader));
+}
@@ -0,0 +1,102 @@
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include "cull.h"
+#include "graph.h"
+
+OcclusionCuller::OcclusionCuller(JobPool *jobs, uint32_t width, uint32_t height) :
+	jobs(jobs), buffer(width, height), last{} {}
+
+void OcclusionCuller::gatherNode(GraphNode *node) {
+	if (MeshNode *mesh = dynamic_cast<MeshNode*>(node)) {
+		meshes.push_back(mesh);
+
+		for (size_t p = 0; p < mesh->numPrimitives(); ++p)
+			if (const OccluderMesh *occ = mesh->getOccluder(p))
+				occluderRefs.push_back(OccluderRef{mesh, occ});
+	}
+
+	for (size_t c = 0; c < node->numChildren(); ++c)
+		gatherNode(node->getChild(c));
+}
+
+void OcclusionCuller::gather(GraphNode *graph) {
+	meshes.clear();
+	occluderRefs.clear();
+
+	if (graph) gatherNode(graph);
+
+	occluders.resize(occluderRefs.size());
+}
+
+void OcclusionCuller::cull(const mat4<float> &viewProj) {
+	using clock = std::chrono::steady_clock;
+
+	last = Stats{};
+	last.occluders = occluderRefs.size();
+
+	if (!enabled) {
+		for (MeshNode *mesh : meshes)
+			for (size_t p = 0; p < mesh->numPrimitives(); ++p)
+				mesh->setVisible(p, true);
+
+		return;
+	}
+
+	// Fill the depth buffer.
+	const auto t0 = clock::now();
+
+	for (size_t o = 0; o < occluderRefs.size(); ++o)
+		occluders[o] = OcclusionBuffer::Occluder{
+			occluderRefs[o].mesh,
+			viewProj * occluderRefs[o].node->world()
+		};
+
+	last.occluderTris = buffer.rasterize(jobs, occluders);
+
+	// Test all candidates.
+	const auto t1 = clock::now();
+
+	std::atomic<size_t> candidates(0);
+	std::atomic<size_t> culled(0);
+
+	jobs->parallelFor(meshes.size(), 32, [&](size_t begin, size_t end) {
+		size_t numCandidates = 0;
+		size_t numCulled = 0;
+
+		for (size_t m = begin; m < end; ++m) {
+			MeshNode *mesh = meshes[m];
+			const mat4<float> mvp = viewProj * mesh->world();
+
+			for (size_t p = 0; p < mesh->numPrimitives(); ++p) {
+				if (mesh->isIndirect(p)) continue;
+
+				const bool visible = buffer.visible(mvp, mesh->getBounds(p));
+				mesh->setVisible(p, visible);
+
+				++numCandidates;
+				numCulled += visible ? 0 : 1;
+			}
+		}
+
+		candidates += numCandidates;
+		culled += numCulled;
+	});
+
+	const auto t2 = clock::now();
+
+	last.candidates = candidates;
+	last.culled = culled;
+	last.rasterMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	last.testMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+void OcclusionCuller::copyHierarchy(void *out) {
+	if (enabled) {
+		buffer.copyHierarchy(out);
+		return;
+	}
+
+	const DepthHeader header = {};
+	memcpy(out, &header, sizeof(DepthHeader));
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "def.h"
+#include "memory.h"
 
 class FrameData {
 public:
@@ -17,10 +18,20 @@ public:
 	GFXMemoryFlags flags() { return group->flags; }
 	GFXBufferUsage usage() { return group->usage; }
 
+	size_t frameSize(); // Bytes of a single frame.
+
 	void setOutput(size_t i); // Set index to start outputting to.
+	void setStaging(void *staging); // Output to CPU memory of frameSize() bytes.
 	void write(const void *data, uint32_t offset, size_t size);
 	uint32_t next(); // Returns offset of the now-finished element.
 
+	// Copy staged frame to index, returns the bytes copied.
+	size_t upload(size_t i, const void *staging);
+
+	// Elements finished & bytes written since the last setOutput/setStaging.
+	size_t written() { return elements; }
+	uint64_t writtenBytes() { return bytes; }
+
 	GFXSetResource getAsResource(size_t i, size_t binding, size_t index);
 	GFXSetGroup getAsGroup(size_t i, size_t binding);
 
@@ -29,4 +40,8 @@ private:
 	void *raw;
 	void *ptr;
 	uint32_t offset;
+	size_t elements;
+	uint64_t bytes;
+
+	MemCharge charge = { MEM_FRAME_DATA };
 };
@@ -24,6 +24,8 @@ FrameData::FrameData(
 	raw = gfx_map(gfx_ref_group(group));
 	dassert(raw);
 
+	charge.set(numFrames * numElements * gfx_group_get_binding_stride(group, 0));
+
 	setOutput(0);
 }
 
@@ -32,18 +34,42 @@ FrameData::~FrameData() {
 	gfx_free_group(group);
 }
 
+size_t FrameData::frameSize() {
+	return numElements() * gfx_group_get_binding_stride(group, 0);
+}
+
 void FrameData::setOutput(size_t i) {
 	ptr = ((char*)raw) + gfx_group_get_binding_offset(group, i % numFrames(), 0);
 	offset = 0;
+	elements = 0;
+	bytes = 0;
+}
+
+void FrameData::setStaging(void *staging) {
+	ptr = staging;
+	offset = 0;
+	elements = 0;
+	bytes = 0;
+}
+
+size_t FrameData::upload(size_t i, const void *staging) {
+	const size_t size = frameSize();
+	memcpy(
+		((char*)raw) + gfx_group_get_binding_offset(group, i % numFrames(), 0),
+		staging, size);
+
+	return size;
 }
 
 void FrameData::write(const void *data, uint32_t offset, size_t size) {
 	memcpy(((char*)ptr) + this->offset + offset, data, size);
+	bytes += size;
 }
 
 uint32_t FrameData::next() {
 	uint32_t currOffset = offset;
 	offset += gfx_group_get_binding_stride(group, 0);
+	++elements;
 
 	return currOffset;
 }
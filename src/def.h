@@ -4,10 +4,13 @@
 #include <groufix/assets/gltf.h>
 #include <iostream>
 
+#include "math/affine.h"
 #include "math/mat.h"
 #include "math/vec.h"
 
-#define NUM_VIRTUAL_FRAMES 2
+// Frames in flight, chosen at runtime within [1, MAX_VIRTUAL_FRAMES].
+#define DEFAULT_VIRTUAL_FRAMES 2
+#define MAX_VIRTUAL_FRAMES 3
 
 #define dassert(expr) do { \
 	if (!(expr)) { \
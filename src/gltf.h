@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "jobs.h"
+#include "json.h"
+#include "math/aabb.h"
+#include "math/affine.h"
+#include "memory.h"
+
+// Upload-ready geometry of all mesh primitives of a document.
+// Vertices are POSITION, NORMAL & TEXCOORD_0 interleaved as 8 floats,
+// indices are widened to at least 16 bits.
+struct GltfGeometry {
+	static const size_t VERTEX_SIZE = sizeof(float) * 8;
+
+	struct Range {
+		uint64_t vertexOffset; // In bytes.
+		uint32_t numVertices;  // 0 if not supported or indices are out of range.
+		uint64_t indexOffset;  // In bytes.
+		uint32_t numIndices;   // 0 if not indexed.
+		char indexSize;
+	};
+
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+	std::vector<std::vector<Range>> primitives; // Per mesh, per primitive.
+};
+
+// CPU-side glTF (.gltf or .glb) document, decodes buffers & converts
+// accessors in parallel if given a job pool.
+class GltfData {
+public:
+	bool load(const char *path, JobPool *jobs = nullptr);
+
+	// Parse from memory, path is used to resolve relative URIs.
+	bool load(const char *path, const std::vector<uint8_t> &file, JobPool *jobs = nullptr);
+
+	const JsonValue &json() const { return root; }
+	const std::string &source() const { return path; }
+
+	// Resolved path of an external image, empty if embedded.
+	std::string imagePath(size_t image) const;
+
+	// URIs of all external buffers & images as written, relative to the document.
+	std::vector<std::string> externalUris() const;
+
+	// Encoded bytes of an image, from its URI or buffer view.
+	bool readImage(size_t image, std::vector<uint8_t> &out) const;
+
+	// Read an accessor as tightly packed floats (normalized integers are
+	// converted), returns the number of elements read.
+	size_t readFloats(
+		size_t accessor, size_t components,
+		std::vector<float> &out, JobPool *jobs = nullptr) const;
+
+	// Read an accessor as 32 bits unsigned integers.
+	size_t readIndices(size_t accessor, std::vector<uint32_t> &out) const;
+
+	// Convert all triangle list primitives, returns false on malformed input.
+	bool buildGeometry(GltfGeometry &out, JobPool *jobs = nullptr) const;
+
+	// Local transform of a node, from its matrix or TRS.
+	affine3x4<float> nodeTransform(size_t node) const;
+
+	// Local-space bounds of a mesh primitive, empty if unknown.
+	aabb<float> primitiveBounds(size_t mesh, size_t primitive) const;
+
+	// Checks node & mesh extras for a boolean flag.
+	bool nodeFlag(size_t node, const char *flag) const;
+
+private:
+	bool loadGlb(const std::vector<uint8_t> &file, std::vector<uint8_t> &bin);
+
+	struct Accessor {
+		const uint8_t *data;
+		size_t count;
+		size_t stride;
+		int type;
+		size_t numComps;
+		bool normalized;
+	};
+
+	bool accessor(size_t index, Accessor &out) const;
+
+	JsonValue root;
+	std::vector<std::vector<uint8_t>> buffers;
+	std::string path;
+	std::string dir;
+
+	MemCharge charge = { MEM_LOADER };
+};
+
+// Reads an entire file, returns false on failure.
+bool read_file(const std::string &path, std::vector<uint8_t> &out);
+
+// Decodes standard base64, returns false on invalid input.
+// Uses SSSE3 when supported & decodes in parallel chunks if given a job pool.
+bool base64_decode(
+	const char *src, size_t len,
+	std::vector<uint8_t> &out, JobPool *jobs = nullptr);
+
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include "gltf.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <tmmintrin.h>
+	#define BASE64_SSSE3
+#endif
+
+// Characters per parallel chunk, must be a multiple of 4.
+#define BASE64_CHUNK (1 << 20)
+
+static const signed char *base64_table() {
+	static const struct Table {
+		signed char values[256];
+
+		Table() {
+			const char *chars =
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			memset(values, -1, sizeof(values));
+			for (int c = 0; c < 64; ++c) values[(unsigned char)chars[c]] = (signed char)c;
+		}
+	} table;
+
+	return table.values;
+}
+
+// Decodes `len` characters without padding, writes len * 3 / 4 bytes.
+static bool decode_scalar(const char *src, size_t len, uint8_t *out) {
+	const signed char *table = base64_table();
+
+	// Whole quads first, then the 2 or 3 character tail.
+	for (; len >= 4; len -= 4, src += 4, out += 3) {
+		const int a = table[(unsigned char)src[0]];
+		const int b = table[(unsigned char)src[1]];
+		const int c = table[(unsigned char)src[2]];
+		const int d = table[(unsigned char)src[3]];
+		if ((a | b | c | d) < 0) return false;
+
+		const uint32_t v = (uint32_t)(a << 18 | b << 12 | c << 6 | d);
+		out[0] = (uint8_t)(v >> 16);
+		out[1] = (uint8_t)(v >> 8);
+		out[2] = (uint8_t)v;
+	}
+
+	if (len == 1) return false;
+	if (len == 0) return true;
+
+	const int a = table[(unsigned char)src[0]];
+	const int b = table[(unsigned char)src[1]];
+	const int c = (len == 3) ? table[(unsigned char)src[2]] : 0;
+	if ((a | b | c) < 0) return false;
+
+	const uint32_t v = (uint32_t)(a << 18 | b << 12 | c << 6);
+	out[0] = (uint8_t)(v >> 16);
+	if (len == 3) out[1] = (uint8_t)(v >> 8);
+
+	return true;
+}
+
+#if defined(BASE64_SSSE3)
+
+// Decodes 16 characters to 12 bytes at a time, validating all of them
+// with two nibble lookups (Muła & Lemire), then finishes with the scalar
+// decoder. Stores are 16 bytes wide, so stops while that still fits.
+__attribute__((target("ssse3")))
+static bool decode_ssse3(const char *src, size_t len, uint8_t *out) {
+	const __m128i lutLo = _mm_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lutHi = _mm_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll = _mm_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71,
+		0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask2F = _mm_set1_epi8(0x2F);
+	const __m128i zero = _mm_setzero_si128();
+
+	const __m128i mergeAB = _mm_set1_epi32(0x01400140);
+	const __m128i mergeABC = _mm_set1_epi32(0x00011000);
+	const __m128i pack = _mm_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+	for (; len >= 24; len -= 16, src += 16, out += 12) {
+		const __m128i str = _mm_loadu_si128((const __m128i*)src);
+
+		const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+		const __m128i loNibbles = _mm_and_si128(str, mask2F);
+		const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+		const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), zero)))
+			return false;
+
+		// To 6 bit values, '/' shares its high nibble with '+'.
+		const __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+		const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+		const __m128i values = _mm_add_epi8(str, roll);
+
+		// Merge 4x6 bits into 3 bytes per lane, then pack the lanes.
+		const __m128i merged = _mm_madd_epi16(
+			_mm_maddubs_epi16(values, mergeAB), mergeABC);
+
+		_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(merged, pack));
+	}
+
+	return decode_scalar(src, len, out);
+}
+
+#endif
+
+static bool decode(const char *src, size_t len, uint8_t *out) {
+#if defined(BASE64_SSSE3)
+	static const bool ssse3 = __builtin_cpu_supports("ssse3");
+	if (ssse3) return decode_ssse3(src, len, out);
+#endif
+
+	return decode_scalar(src, len, out);
+}
+
+bool base64_decode(
+		const char *src, size_t len,
+		std::vector<uint8_t> &out, JobPool *jobs) {
+	while (len > 0 && src[len - 1] == '=') --len;
+
+	out.resize(len / 4 * 3 + (len % 4 > 1 ? len % 4 - 1 : 0));
+
+	if (!jobs || len <= BASE64_CHUNK)
+		return decode(src, len, out.data());
+
+	// Every chunk but the last is whole quads, so outputs line up.
+	std::atomic<bool> valid = { true };
+	const size_t numChunks = (len + BASE64_CHUNK - 1) / BASE64_CHUNK;
+
+	jobs->parallelFor(numChunks, 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c) {
+			const size_t first = c * BASE64_CHUNK;
+			const size_t count = std::min((size_t)BASE64_CHUNK, len - first);
+
+			if (!decode(src + first, count, out.data() + first / 4 * 3))
+				valid.store(false, std::memory_order_relaxed);
+		}
+	});
+
+	return valid.load();
+}
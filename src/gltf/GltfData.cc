@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+#include "gltf.h"
+
+bool read_file(const std::string &path, std::vector<uint8_t> &out) {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+
+	bool ok = fseek(file, 0, SEEK_END) == 0;
+	const long len = ok ? ftell(file) : -1;
+	ok = ok && len >= 0 && fseek(file, 0, SEEK_SET) == 0;
+
+	if (ok) {
+		out.resize((size_t)len);
+		ok = fread(out.data(), 1, out.size(), file) == out.size();
+	}
+
+	fclose(file);
+	return ok;
+}
+
+bool GltfData::load(const char *path, JobPool *jobs) {
+	std::vector<uint8_t> file;
+	return read_file(path, file) && load(path, file, jobs);
+}
+
+#define GLB_MAGIC 0x46546C67 // "glTF"
+#define GLB_JSON 0x4E4F534A
+#define GLB_BIN 0x004E4942
+
+static uint32_t read_u32(const uint8_t *ptr) {
+	uint32_t val;
+	memcpy(&val, ptr, sizeof(val));
+	return val;
+}
+
+bool GltfData::loadGlb(const std::vector<uint8_t> &file, std::vector<uint8_t> &bin) {
+	// Header, then a JSON chunk & an optional BIN chunk.
+	if (file.size() < 20 || read_u32(file.data() + 4) != 2)
+		return false;
+
+	const size_t length = std::min((size_t)read_u32(file.data() + 8), file.size());
+	bool json = false;
+
+	for (size_t pos = 12; pos + 8 <= length; ) {
+		const size_t chunkLen = read_u32(file.data() + pos);
+		const uint32_t chunkType = read_u32(file.data() + pos + 4);
+		const uint8_t *chunk = file.data() + pos + 8;
+
+		if (chunkLen > length - pos - 8)
+			return false;
+
+		if (!json) {
+			if (chunkType != GLB_JSON || !JsonValue::parse((const char*)chunk, chunkLen, root))
+				return false;
+			json = true;
+		}
+		else if (chunkType == GLB_BIN && bin.empty())
+			bin.assign(chunk, chunk + chunkLen);
+
+		pos += 8 + ((chunkLen + 3) & ~(size_t)3);
+	}
+
+	return json;
+}
+
+bool GltfData::load(const char *path, const std::vector<uint8_t> &file, JobPool *jobs) {
+	std::vector<uint8_t> bin;
+	const bool glb = file.size() >= 4 && read_u32(file.data()) == GLB_MAGIC;
+
+	if (glb ?
+		!loadGlb(file, bin) :
+		!JsonValue::parse((const char*)file.data(), file.size(), root))
+	{
+		return false;
+	}
+
+	// Relative URIs are resolved against the document's directory.
+	this->path = path;
+	dir = path;
+	const size_t slash = dir.find_last_of("/\\");
+	dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+
+	const JsonValue &jBuffers = root["buffers"];
+	buffers.resize(jBuffers.size());
+
+	for (size_t b = 0; b < jBuffers.size(); ++b) {
+		const JsonValue &jUri = jBuffers[b]["uri"];
+		const std::string &uri = jUri.string();
+		const size_t comma = uri.find(',');
+
+		// Only the first buffer may refer to the GLB BIN chunk.
+		if (jUri.isNull()) {
+			if (!glb || b != 0) return false;
+			buffers[b] = std::move(bin);
+		}
+		else if (uri.compare(0, 5, "data:") == 0) {
+			if (comma == std::string::npos || comma < 12 ||
+				uri.compare(comma - 7, 7, ";base64") != 0 ||
+				!base64_decode(uri.data() + comma + 1, uri.size() - comma - 1, buffers[b], jobs))
+			{
+				return false;
+			}
+		}
+		else if (!read_file(dir + uri, buffers[b]))
+			return false;
+	}
+
+	// The document itself is about as large as its source.
+	uint64_t bytes = file.size();
+	for (const auto &buffer : buffers)
+		bytes += buffer.size();
+
+	charge.set(bytes);
+
+	return true;
+}
+
+std::string GltfData::imagePath(size_t image) const {
+	const std::string &uri = root["images"][image]["uri"].string();
+	return (uri.empty() || uri.compare(0, 5, "data:") == 0) ? "" : dir + uri;
+}
+
+std::vector<std::string> GltfData::externalUris() const {
+	std::vector<std::string> out;
+
+	for (const char *type : { "buffers", "images" }) {
+		const JsonValue &jList = root[type];
+		for (size_t i = 0; i < jList.size(); ++i) {
+			const std::string &uri = jList[i]["uri"].string();
+			if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+				out.push_back(uri);
+		}
+	}
+
+	return out;
+}
+
+bool GltfData::readImage(size_t image, std::vector<uint8_t> &out) const {
+	const JsonValue &jImage = root["images"][image];
+	const std::string &uri = jImage["uri"].string();
+
+	if (!uri.empty()) {
+		if (uri.compare(0, 5, "data:") != 0)
+			return read_file(dir + uri, out);
+
+		const size_t comma = uri.find(',');
+		return
+			comma != std::string::npos && comma >= 12 &&
+			uri.compare(comma - 7, 7, ";base64") == 0 &&
+			base64_decode(uri.data() + comma + 1, uri.size() - comma - 1, out);
+	}
+
+	const JsonValue &view = root["bufferViews"][jImage["bufferView"].index()];
+	const size_t buffer = view["buffer"].index();
+	const size_t offset = (size_t)view["byteOffset"].number();
+	const size_t length = (size_t)view["byteLength"].number();
+
+	if (buffer >= buffers.size() || offset + length > buffers[buffer].size())
+		return false;
+
+	out.assign(
+		buffers[buffer].begin() + offset,
+		buffers[buffer].begin() + offset + length);
+
+	return true;
+}
+
+static size_t num_components(const std::string &type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4" || type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+static size_t component_size(int componentType) {
+	switch (componentType) {
+	case 5120: case 5121: return 1;
+	case 5122: case 5123: return 2;
+	case 5125: case 5126: return 4;
+	default: return 0;
+	}
+}
+
+bool GltfData::accessor(size_t index, Accessor &out) const {
+	const JsonValue &acc = root["accessors"][index];
+	const JsonValue &view = root["bufferViews"][acc["bufferView"].index()];
+
+	out.count = (size_t)acc["count"].number();
+	out.type = (int)acc["componentType"].number();
+	out.numComps = num_components(acc["type"].string());
+	out.normalized = acc["normalized"].boolean();
+
+	const size_t elemSize = out.numComps * component_size(out.type);
+	const size_t buffer = view["buffer"].index();
+	if (view.isNull() || elemSize == 0 || buffer >= buffers.size())
+		return false;
+
+	const size_t offset =
+		(size_t)view["byteOffset"].number() + (size_t)acc["byteOffset"].number();
+	out.stride = (size_t)view["byteStride"].number((double)elemSize);
+
+	if (out.count > 0 && offset + (out.count - 1) * out.stride + elemSize > buffers[buffer].size())
+		return false;
+
+	out.data = buffers[buffer].data() + offset;
+	return true;
+}
+
+// Elements per parallel conversion job.
+#define GLTF_CHUNK (1 << 14)
+
+template <typename T>
+static float read_component(const uint8_t *ptr, bool normalized) {
+	T val;
+	memcpy(&val, ptr, sizeof(T));
+
+	if (!normalized)
+		return (float)val;
+
+	// Multiplying by the reciprocal is within an ulp & a lot cheaper.
+	const float norm = (float)val * (1.0f / (float)std::numeric_limits<T>::max());
+	return norm < -1.0f ? -1.0f : norm;
+}
+
+template <typename T>
+static void convert_typed(
+		const uint8_t *src, size_t stride, size_t numComps, bool normalized,
+		size_t components, size_t begin, size_t end, float *dst, size_t dstStride) {
+	const size_t comps = std::min(numComps, components);
+
+	for (size_t e = begin; e < end; ++e) {
+		const uint8_t *elem = src + e * stride;
+		float *out = dst + e * dstStride;
+
+		for (size_t c = 0; c < comps; ++c)
+			out[c] = read_component<T>(elem + c * sizeof(T), normalized);
+		for (size_t c = comps; c < components; ++c)
+			out[c] = 0.0f;
+	}
+}
+
+// Converts elements [begin, end) of an accessor to `components` floats,
+// written to dst + element * dstStride.
+static void convert_floats(
+		const uint8_t *src, size_t stride, int type, size_t numComps, bool normalized,
+		size_t components, size_t begin, size_t end, float *dst, size_t dstStride) {
+	// Floats are copied as-is, in one go if both sides are packed.
+	if (type == 5126 && numComps >= components) {
+		const size_t size = components * sizeof(float);
+
+		if (stride == size && dstStride == components)
+			memcpy(dst + begin * dstStride, src + begin * stride, (end - begin) * size);
+		else
+			for (size_t e = begin; e < end; ++e)
+				memcpy(dst + e * dstStride, src + e * stride, size);
+
+		return;
+	}
+
+	switch (type) {
+	case 5120: convert_typed<int8_t>(src, stride, numComps, normalized, components, begin, end, dst, dstStride); break;
+	case 5121: convert_typed<uint8_t>(src, stride, numComps, normalized, components, begin, end, dst, dstStride); break;
+	case 5122: convert_typed<int16_t>(src, stride, numComps, normalized, components, begin, end, dst, dstStride); break;
+	case 5123: convert_typed<uint16_t>(src, stride, numComps, normalized, components, begin, end, dst, dstStride); break;
+	case 5125: convert_typed<uint32_t>(src, stride, numComps, normalized, components, begin, end, dst, dstStride); break;
+	case 5126: convert_typed<float>(src, stride, numComps, false, components, begin, end, dst, dstStride); break;
+	}
+}
+
+// Converts indices [begin, end) to T, which must be at least as wide.
+template <typename T>
+static void convert_indices(
+		const uint8_t *src, size_t stride, int type,
+		size_t begin, size_t end, T *dst) {
+	if (type == 5121)
+		for (size_t e = begin; e < end; ++e)
+			dst[e] = src[e * stride];
+	else if (type == 5123 && sizeof(T) == 2 && stride == 2)
+		memcpy(dst + begin, src + begin * 2, (end - begin) * 2);
+	else if (type == 5123)
+		for (size_t e = begin; e < end; ++e) {
+			uint16_t v;
+			memcpy(&v, src + e * stride, 2);
+			dst[e] = (T)v;
+		}
+	else if (type == 5125 && stride == 4)
+		memcpy(dst + begin, src + begin * 4, (end - begin) * 4);
+	else
+		for (size_t e = begin; e < end; ++e)
+			memcpy(dst + e, src + e * stride, 4);
+}
+
+size_t GltfData::readFloats(
+		size_t accessor, size_t components,
+		std::vector<float> &out, JobPool *jobs) const {
+	Accessor acc;
+	if (!this->accessor(accessor, acc)) return 0;
+
+	out.resize(acc.count * components);
+
+	auto convert = [&](size_t begin, size_t end) {
+		convert_floats(
+			acc.data, acc.stride, acc.type, acc.numComps, acc.normalized,
+			components, begin, end, out.data(), components);
+	};
+
+	if (jobs && acc.count > GLTF_CHUNK)
+		jobs->parallelFor(acc.count, GLTF_CHUNK, convert);
+	else
+		convert(0, acc.count);
+
+	return acc.count;
+}
+
+size_t GltfData::readIndices(size_t accessor, std::vector<uint32_t> &out) const {
+	Accessor acc;
+	if (!this->accessor(accessor, acc) || acc.numComps != 1)
+		return 0;
+
+	if (acc.type != 5121 && acc.type != 5123 && acc.type != 5125)
+		return 0;
+
+	out.resize(acc.count);
+	convert_indices(acc.data, acc.stride, acc.type, 0, acc.count, out.data());
+
+	return acc.count;
+}
+
+bool GltfData::buildGeometry(GltfGeometry &out, JobPool *jobs) const {
+	// Lay out all primitives first, so conversion can be split up freely.
+	struct Source {
+		GltfGeometry::Range range;
+		Accessor position;
+		Accessor normal; // data is nullptr if absent.
+		Accessor texcoord; // Likewise.
+		Accessor index;  // data is nullptr if absent.
+		size_t mesh, primitive;
+	};
+
+	std::vector<Source> sources;
+	uint64_t vertexBytes = 0;
+	uint64_t indexBytes = 0;
+
+	const JsonValue &jMeshes = root["meshes"];
+	out.primitives.resize(jMeshes.size());
+
+	for (size_t m = 0; m < jMeshes.size(); ++m) {
+		const JsonValue &jPrims = jMeshes[m]["primitives"];
+		out.primitives[m].resize(jPrims.size(), GltfGeometry::Range{});
+
+		for (size_t p = 0; p < jPrims.size(); ++p) {
+			const JsonValue &jPrim = jPrims[p];
+			const JsonValue &jAttribs = jPrim["attributes"];
+			Source src = {};
+			src.mesh = m;
+			src.primitive = p;
+
+			// Only triangle lists with positions.
+			if (jPrim["mode"].number(4) != 4 ||
+				!accessor(jAttribs["POSITION"].index(), src.position))
+			{
+				continue;
+			}
+
+			if (!jAttribs["NORMAL"].isNull() &&
+				(!accessor(jAttribs["NORMAL"].index(), src.normal) ||
+				src.normal.count != src.position.count))
+			{
+				return false;
+			}
+
+			if (!jAttribs["TEXCOORD_0"].isNull() &&
+				(!accessor(jAttribs["TEXCOORD_0"].index(), src.texcoord) ||
+				src.texcoord.count != src.position.count))
+			{
+				return false;
+			}
+
+			if (!jPrim["indices"].isNull()) {
+				if (!accessor(jPrim["indices"].index(), src.index) ||
+					src.index.numComps != 1 ||
+					(src.index.type != 5121 && src.index.type != 5123 && src.index.type != 5125))
+				{
+					return false;
+				}
+			}
+
+			// 8 bits indices are widened, Vulkan needs an extension for them.
+			GltfGeometry::Range &range = src.range;
+			range.vertexOffset = vertexBytes;
+			range.numVertices = (uint32_t)src.position.count;
+			range.indexOffset = indexBytes;
+			range.numIndices = src.index.data ? (uint32_t)src.index.count : 0;
+			range.indexSize = (src.index.type == 5125) ? 4 : 2;
+
+			// Keep 4 byte alignment for 32 bits indices.
+			vertexBytes += (uint64_t)range.numVertices * GltfGeometry::VERTEX_SIZE;
+			indexBytes += ((uint64_t)range.numIndices * range.indexSize + 3) & ~(uint64_t)3;
+
+			out.primitives[m][p] = range;
+			sources.push_back(src);
+		}
+	}
+
+	out.vertices.resize(vertexBytes);
+	out.indices.resize(indexBytes);
+
+	// Split every primitive into vertex & index chunks.
+	struct Task {
+		const Source *src;
+		bool indices;
+		size_t begin, end;
+	};
+
+	std::vector<Task> tasks;
+	for (const Source &src : sources) {
+		for (size_t v = 0; v < src.range.numVertices; v += GLTF_CHUNK)
+			tasks.push_back({ &src, false, v, std::min(v + GLTF_CHUNK, (size_t)src.range.numVertices) });
+		for (size_t i = 0; i < src.range.numIndices; i += GLTF_CHUNK)
+			tasks.push_back({ &src, true, i, std::min(i + GLTF_CHUNK, (size_t)src.range.numIndices) });
+	}
+
+	// Per task, if it converted an index past the last vertex.
+	std::vector<uint8_t> outOfRange(tasks.size(), 0);
+
+	auto convert = [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			const Task &task = tasks[t];
+			const Source &src = *task.src;
+
+			if (task.indices) {
+				uint8_t *dst = out.indices.data() + src.range.indexOffset;
+				uint32_t max = 0;
+
+				if (src.range.indexSize == 4) {
+					uint32_t *indices = (uint32_t*)dst;
+					convert_indices(
+						src.index.data, src.index.stride, src.index.type,
+						task.begin, task.end, indices);
+					for (size_t i = task.begin; i < task.end; ++i)
+						max = std::max(max, indices[i]);
+				}
+				else {
+					uint16_t *indices = (uint16_t*)dst;
+					convert_indices(
+						src.index.data, src.index.stride, src.index.type,
+						task.begin, task.end, indices);
+					for (size_t i = task.begin; i < task.end; ++i)
+						max = std::max(max, (uint32_t)indices[i]);
+				}
+
+				outOfRange[t] = max >= src.range.numVertices;
+				continue;
+			}
+
+			float *dst = (float*)(out.vertices.data() + src.range.vertexOffset);
+			const Accessor &pos = src.position;
+			const Accessor &nrm = src.normal;
+			const Accessor &uv = src.texcoord;
+
+			convert_floats(
+				pos.data, pos.stride, pos.type, pos.numComps, pos.normalized,
+				3, task.begin, task.end, dst, 8);
+
+			if (nrm.data)
+				convert_floats(
+					nrm.data, nrm.stride, nrm.type, nrm.numComps, nrm.normalized,
+					3, task.begin, task.end, dst + 3, 8);
+			else
+				for (size_t v = task.begin; v < task.end; ++v)
+					dst[v * 8 + 3] = dst[v * 8 + 4] = dst[v * 8 + 5] = 0.0f;
+
+			if (uv.data)
+				convert_floats(
+					uv.data, uv.stride, uv.type, uv.numComps, uv.normalized,
+					2, task.begin, task.end, dst + 6, 8);
+			else
+				for (size_t v = task.begin; v < task.end; ++v)
+					dst[v * 8 + 6] = dst[v * 8 + 7] = 0.0f;
+		}
+	};
+
+	if (jobs)
+		jobs->parallelFor(tasks.size(), 1, convert);
+	else
+		convert(0, tasks.size());
+
+	// Drop primitives that would read past their vertices, their space is left unused.
+	for (size_t t = 0; t < tasks.size(); ++t)
+		if (outOfRange[t])
+			out.primitives[tasks[t].src->mesh][tasks[t].src->primitive] = GltfGeometry::Range{};
+
+	return true;
+}
+
+affine3x4<float> GltfData::nodeTransform(size_t node) const {
+	const JsonValue &jNode = root["nodes"][node];
+	const JsonValue &jMatrix = jNode["matrix"];
+
+	// Column-major to row-major, dropping the last row.
+	if (jMatrix.size() == 16) {
+		affine3x4<float> mat;
+		for (size_t r = 0; r < 3; ++r)
+			for (size_t c = 0; c < 4; ++c)
+				mat[r][c] = (float)jMatrix[c * 4 + r].number();
+
+		return mat;
+	}
+
+	const JsonValue &jT = jNode["translation"];
+	const JsonValue &jR = jNode["rotation"];
+	const JsonValue &jS = jNode["scale"];
+
+	const float t[3] = {
+		(float)jT[0].number(0.0), (float)jT[1].number(0.0), (float)jT[2].number(0.0) };
+	const float r[4] = {
+		(float)jR[0].number(0.0), (float)jR[1].number(0.0),
+		(float)jR[2].number(0.0), (float)jR[3].number(1.0) };
+	const float s[3] = {
+		(float)jS[0].number(1.0), (float)jS[1].number(1.0), (float)jS[2].number(1.0) };
+
+	return affine3x4<float>::trs(t, r, s);
+}
+
+aabb<float> GltfData::primitiveBounds(size_t mesh, size_t primitive) const {
+	const JsonValue &prim = root["meshes"][mesh]["primitives"][primitive];
+	const JsonValue &acc = root["accessors"][prim["attributes"]["POSITION"].index()];
+	const JsonValue &min = acc["min"];
+	const JsonValue &max = acc["max"];
+
+	if (min.size() < 3 || max.size() < 3)
+		return {};
+
+	return aabb<float>(
+		vec3<float>((float)min[0].number(), (float)min[1].number(), (float)min[2].number()),
+		vec3<float>((float)max[0].number(), (float)max[1].number(), (float)max[2].number()));
+}
+
+bool GltfData::nodeFlag(size_t node, const char *flag) const {
+	const JsonValue &jNode = root["nodes"][node];
+	const JsonValue &jMesh = root["meshes"][jNode["mesh"].index()];
+
+	return
+		jNode["extras"][flag].boolean() ||
+		jMesh["extras"][flag].boolean();
+}
@@ -3,26 +3,56 @@
 #include <memory>
 #include <utility>
 #include <vector>
+#include "cull.h"
 #include "data.h"
 #include "def.h"
+#include "math/aabb.h"
+#include "memory.h"
+#include "stats.h"
+
+class Texture;
+
+// A single draw command, recordable without the graph.
+struct DrawItem {
+	GFXTechnique *tech;
+	GFXRenderable *renderable;
+	GFXSet **sets; // One per virtual frame.
+	uint32_t offset;
+	uint32_t numVertices; // Indices if indexed.
+	Texture *texture; // Optional.
+	aabb<float> bounds; // World-space, only if textured.
+
+	// A range of the renderable's primitive if ranged, otherwise all of it.
+	bool ranged;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
+
 
 class GraphNode {
 public:
-	mat4<float> transform;
+	affine3x4<float> transform;
 
 	GraphNode() {}
-	GraphNode(const mat4<float> &mat) : transform(mat) {}
+	GraphNode(const affine3x4<float> &mat) : transform(mat) {}
 	GraphNode(const float *mat) : transform(mat) {}
 	virtual ~GraphNode() = default;
 
+	// Tracks all heap allocated nodes as MEM_GRAPH.
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	GraphNode *addChild(std::unique_ptr<GraphNode> node);
 	GraphNode *getChild(size_t i);
 	void eraseChild(size_t i);
 	std::unique_ptr<GraphNode> claimChild(size_t i);
 	size_t numChildren() { return children.size(); }
 
-	// Update the entire sub-graph.
-	void update(GraphNode *parent = nullptr);
+	// World transform, as of the last update().
+	const affine3x4<float> &world() { return finalTransform; }
+
+	// Update the entire sub-graph, adds to `counters` if not nullptr.
+	void update(FrameCounters *counters = nullptr, GraphNode *parent = nullptr);
 
 	// Write the entire sub-graph to GPU memory.
 	void write(FrameData *out);
@@ -30,8 +60,15 @@ public:
 	// Number of writes this graph makes.
 	size_t writes();
 
-	// Record the entire sub-graph.
-	void record(GFXRecorder*, void *ptr);
+	// Record the entire sub-graph, adds to `counters` if not nullptr.
+	void record(GFXRecorder*, FrameCounters *counters = nullptr);
+
+	// Append the draws of the entire sub-graph for a pass,
+	// offsets are as of the last write().
+	void collect(GFXPass *pass, std::vector<DrawItem> &out);
+
+	// Append all renderables of the entire sub-graph, of any pass.
+	void renderables(std::vector<GFXRenderable*> &out);
 
 protected:
 	// args{frame-data-output}
@@ -40,11 +77,17 @@ protected:
 	// should return true if _write should be called.
 	virtual bool _writes() { return false; }
 
-	// args{recorder, user-pointer}
-	virtual void _record(GFXRecorder*, void*) {};
+	// args{recorder, counters-output}, counters may be nullptr.
+	virtual void _record(GFXRecorder*, FrameCounters*) {};
+
+	// args{pass, draw-list-output}
+	virtual void _collect(GFXPass*, std::vector<DrawItem>&) {};
+
+	// args{renderable-output}
+	virtual void _renderables(std::vector<GFXRenderable*>&) {};
 
 	// Set during update().
-	mat4<float> finalTransform;
+	affine3x4<float> finalTransform;
 
 private:
 	std::vector<std::unique_ptr<GraphNode>> children;
@@ -53,18 +96,34 @@ private:
 
 class MeshNode : public GraphNode {
 public:
+	// Range of a primitive within one spanning buffers shared with others,
+	// so it can be drawn indirectly together with them.
+	struct SharedRange {
+		GFXPrimitive *prim; // Indexed, nullptr if not shared.
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+	};
+
 	struct Primitive {
 		GFXTechnique *tech;
 		GFXPrimitive *prim;
+		aabb<float> bounds; // Local-space, empty means always visible.
+		std::shared_ptr<const OccluderMesh> occluder; // Optional.
+		std::shared_ptr<const void> owner; // Keeps `prim` alive, optional.
+		std::shared_ptr<Texture> texture; // Base color, optional.
+		uint32_t numVertices = 0; // Indices if indexed, for statistics.
+		SharedRange shared = {}; // Optional.
 	};
 
 	struct Renderable {
 		GFXRenderable forward;
-		GFXSet *sets[NUM_VIRTUAL_FRAMES];
+		std::vector<GFXSet*> sets; // One per virtual frame.
+		bool visible;
+		bool indirect; // Culled & drawn on the GPU, not collected.
 	};
 
 	MeshNode() {}
-	MeshNode(const mat4<float> &mat) : GraphNode(mat) {}
+	MeshNode(const affine3x4<float> &mat) : GraphNode(mat) {}
 	MeshNode(const float *mat) : GraphNode(mat) {}
 	virtual ~MeshNode() = default;
 
@@ -73,12 +132,25 @@ public:
 	void erasePrimitive(size_t i);
 	size_t numPrimitives() { return primitives.size(); }
 	bool setForward(size_t i, GFXPass *pass, const GFXRenderState *state);
-	bool assignSets(size_t i, GFXSet **sets);
+	bool assignSets(size_t i, const std::vector<GFXSet*> &sets);
+
+	aabb<float> getBounds(size_t i);
+	const OccluderMesh *getOccluder(size_t i);
+	void setVisible(size_t i, bool visible);
+
+	Renderable *getRenderable(size_t i);
+	void setIndirect(size_t i, bool indirect);
+	bool isIndirect(size_t i);
+
+	// Offset of the transform in its frame, as of the last write().
+	uint32_t dataOffset() { return offset; }
 
 protected:
 	virtual void _write(FrameData*);
 	virtual bool _writes() { return true; }
-	virtual void _record(GFXRecorder*, void*);
+	virtual void _record(GFXRecorder*, FrameCounters*);
+	virtual void _collect(GFXPass*, std::vector<DrawItem>&);
+	virtual void _renderables(std::vector<GFXRenderable*>&);
 
 private:
 	std::vector<std::pair<Primitive, Renderable>> primitives;
@@ -86,3 +158,33 @@ private:
 	// Set during _write().
 	uint32_t offset;
 };
+
+
+class LightNode : public GraphNode {
+public:
+	// As KHR_lights_punctual, shining down local -Z.
+	enum Type {
+		DIRECTIONAL,
+		POINT,
+		SPOT
+	};
+
+	Type type = POINT;
+	vec3<float> color = vec3<float>(1.0f, 1.0f, 1.0f);
+	float intensity = 1.0f;
+	float range = 0.0f; // 0 for infinite.
+	float innerCone = 0.0f; // Radians, spot only.
+	float outerCone = 0.7853981634f;
+
+	LightNode() {}
+	LightNode(const affine3x4<float> &mat) : GraphNode(mat) {}
+	virtual ~LightNode() = default;
+
+	// Distance beyond which the contribution is negligible,
+	// bounded even if `range` is infinite.
+	float reach() const;
+
+	// World-space, as of the last update().
+	vec3<float> position() { return world().translation(); }
+	vec3<float> direction();
+};
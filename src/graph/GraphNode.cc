@@ -1,5 +1,18 @@
+#include <new>
+#include <string.h>
 #include "graph.h"
 
+void *GraphNode::operator new(size_t size) {
+	void *ptr = ::operator new(size);
+	mem_track_alloc(MEM_GRAPH, size);
+	return ptr;
+}
+
+void GraphNode::operator delete(void *ptr, size_t size) {
+	mem_track_free(MEM_GRAPH, size);
+	::operator delete(ptr);
+}
+
 GraphNode *GraphNode::addChild(std::unique_ptr<GraphNode> node) {
 	children.push_back(std::move(node));
 	return children.back().get();
@@ -28,12 +41,20 @@ std::unique_ptr<GraphNode> GraphNode::claimChild(size_t i) {
 	return {};
 }
 
-void GraphNode::update(GraphNode *parent) {
-	finalTransform =
+void GraphNode::update(FrameCounters *counters, GraphNode *parent) {
+	const affine3x4<float> world =
 		parent ? parent->finalTransform * transform : transform;
 
+	if (counters) {
+		++counters->nodes;
+		if (memcmp(world.data, finalTransform.data, sizeof(world.data)) != 0)
+			++counters->moved;
+	}
+
+	finalTransform = world;
+
 	for (auto &child : children)
-		child->update(this);
+		child->update(counters, this);
 }
 
 void GraphNode::write(FrameData *out) {
@@ -53,9 +74,23 @@ size_t GraphNode::writes() {
 	return (_writes() ? 1 : 0) + childWrites;
 }
 
-void GraphNode::record(GFXRecorder *recorder, void *ptr) {
-	_record(recorder, ptr);
+void GraphNode::record(GFXRecorder *recorder, FrameCounters *counters) {
+	_record(recorder, counters);
+
+	for (auto &child : children)
+		child->record(recorder, counters);
+}
+
+void GraphNode::collect(GFXPass *pass, std::vector<DrawItem> &out) {
+	_collect(pass, out);
+
+	for (auto &child : children)
+		child->collect(pass, out);
+}
+
+void GraphNode::renderables(std::vector<GFXRenderable*> &out) {
+	_renderables(out);
 
 	for (auto &child : children)
-		child->record(recorder, ptr);
+		child->renderables(out);
 }
@@ -0,0 +1,17 @@
+#include <math.h>
+#include "graph.h"
+
+// Lowest contributed radiance still considered visible.
+static const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+float LightNode::reach() const {
+	// Inverse square falloff drops below the cutoff at this distance.
+	const float peak = GFX_MAX(color[0], GFX_MAX(color[1], color[2])) * intensity;
+	const float cutoff = sqrtf(GFX_MAX(peak, 0.0f) / LIGHT_CUTOFF);
+
+	return range > 0.0f ? GFX_MIN(range, cutoff) : cutoff;
+}
+
+vec3<float> LightNode::direction() {
+	return world().rotate(vec3<float>(0.0f, 0.0f, -1.0f)).normalize();
+}
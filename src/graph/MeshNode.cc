@@ -1,9 +1,8 @@
-#include <string.h>
 #include "graph.h"
 
 size_t MeshNode::addPrimitive(MeshNode::Primitive prim) {
 	// Insert empty renderable, i.e. set `pass` to nullptr.
-	auto pair = std::make_pair(prim, Renderable{{.pass = nullptr}});
+	auto pair = std::make_pair(prim, Renderable{{.pass = nullptr}, {}, true, false});
 	primitives.push_back(pair);
 
 	return primitives.size() - 1;
@@ -13,7 +12,7 @@ MeshNode::Primitive MeshNode::getPrimitive(size_t i) {
 	if (i < primitives.size())
 		return primitives[i].first;
 
-	return { nullptr, nullptr };
+	return { nullptr, nullptr, {}, {}, {} };
 }
 
 void MeshNode::erasePrimitive(size_t i) {
@@ -29,41 +28,130 @@ bool MeshNode::setForward(size_t i, GFXPass *pass, const GFXRenderState *state)
 			return true;
 		}
 
-		// Or re-initialize the renderable.
+		// Or re-initialize the renderable, shared ranges draw from their span
+		// so consecutive draws from the same buffers need no rebinds.
+		const Primitive &prim = primitives[i].first;
 		return gfx_renderable(
 			&primitives[i].second.forward,
-			pass, primitives[i].first.tech, primitives[i].first.prim, state);
+			pass, prim.tech, prim.shared.prim ? prim.shared.prim : prim.prim, state);
 	}
 
 	return false;
 }
 
-bool MeshNode::assignSets(size_t i, GFXSet **sets) {
+bool MeshNode::assignSets(size_t i, const std::vector<GFXSet*> &sets) {
 	if (i < primitives.size()) {
-		memcpy(primitives[i].second.sets, sets, sizeof(primitives[i].second.sets));
+		primitives[i].second.sets = sets;
 		return true;
 	}
 
 	return false;
 }
 
+aabb<float> MeshNode::getBounds(size_t i) {
+	if (i < primitives.size())
+		return primitives[i].first.bounds;
+
+	return {};
+}
+
+const OccluderMesh *MeshNode::getOccluder(size_t i) {
+	if (i < primitives.size())
+		return primitives[i].first.occluder.get();
+
+	return nullptr;
+}
+
+void MeshNode::setVisible(size_t i, bool visible) {
+	if (i < primitives.size())
+		primitives[i].second.visible = visible;
+}
+
+MeshNode::Renderable *MeshNode::getRenderable(size_t i) {
+	if (i < primitives.size())
+		return &primitives[i].second;
+
+	return nullptr;
+}
+
+void MeshNode::setIndirect(size_t i, bool indirect) {
+	if (i < primitives.size())
+		primitives[i].second.indirect = indirect;
+}
+
+bool MeshNode::isIndirect(size_t i) {
+	if (i < primitives.size())
+		return primitives[i].second.indirect;
+
+	return false;
+}
+
 void MeshNode::_write(FrameData *out) {
 	out->write(finalTransform.data, 0, sizeof(finalTransform.data));
 	offset = out->next();
 }
 
-void MeshNode::_record(GFXRecorder *recorder, void*) {
+void MeshNode::_record(GFXRecorder *recorder, FrameCounters *counters) {
 	unsigned int frame = gfx_recorder_get_frame_index(recorder);
 	GFXPass *pass = gfx_recorder_get_pass(recorder);
 
 	if (!pass) return;
 
+	size_t draws = 0;
+	uint64_t vertices = 0;
+
 	for (auto &prim : primitives)
-		if (prim.second.forward.pass == pass) {
+		if (
+			prim.second.forward.pass == pass && prim.second.visible &&
+			!prim.second.indirect && frame < prim.second.sets.size())
+		{
 			gfx_cmd_bind(
 				recorder, prim.first.tech,
 				0, 1, 1, &prim.second.sets[frame], &offset);
-			gfx_cmd_draw_prim(
-				recorder, &prim.second.forward, 1, 0);
+
+			const SharedRange &range = prim.first.shared;
+			if (range.prim)
+				gfx_cmd_draw_indexed(
+					recorder, &prim.second.forward,
+					prim.first.numVertices, 1, range.firstIndex, range.vertexOffset, 0);
+			else
+				gfx_cmd_draw_prim(
+					recorder, &prim.second.forward, 1, 0);
+
+			++draws;
+			vertices += prim.first.numVertices;
 		}
+
+	// A bind per draw.
+	if (counters) {
+		counters->draws += draws;
+		counters->binds += draws;
+		counters->vertices += vertices;
+		counters->primitives += vertices / 3;
+	}
+}
+
+void MeshNode::_collect(GFXPass *pass, std::vector<DrawItem> &out) {
+	for (auto &prim : primitives)
+		if (
+			prim.second.forward.pass == pass && prim.second.visible &&
+			!prim.second.indirect)
+		{
+			out.push_back({
+				prim.first.tech, &prim.second.forward,
+				prim.second.sets.data(), offset,
+				prim.first.numVertices,
+				prim.first.texture.get(),
+				prim.first.texture ?
+					prim.first.bounds.transform(finalTransform) : aabb<float>(),
+				prim.first.shared.prim != nullptr,
+				prim.first.shared.firstIndex,
+				prim.first.shared.vertexOffset });
+		}
+}
+
+void MeshNode::_renderables(std::vector<GFXRenderable*> &out) {
+	for (auto &prim : primitives)
+		if (prim.second.forward.pass)
+			out.push_back(&prim.second.forward);
 }
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+#include "def.h"
+
+// Reads back a 2D R8G8B8A8 attachment, blocks until done.
+// Only valid outside of a frame, after the renderer is blocked.
+bool read_attachment(
+	GFXRenderer *renderer, size_t index,
+	uint32_t width, uint32_t height, std::vector<uint8_t> &out);
+
+// Writes R8G8B8A8 texels as a binary PPM, alpha is dropped.
+bool write_ppm(
+	const char *path,
+	uint32_t width, uint32_t height, const uint8_t *rgba);
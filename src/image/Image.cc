@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include "image.h"
+
+bool read_attachment(
+		GFXRenderer *renderer, size_t index,
+		uint32_t width, uint32_t height, std::vector<uint8_t> &out) {
+	out.resize((size_t)width * height * 4);
+
+	const GFXRegion src = {
+		.aspect = GFX_IMAGE_COLOR,
+		.mipmap = 0,
+		.layer = 0,
+		.numLayers = 1,
+		.x = 0, .y = 0, .z = 0,
+		.width = width,
+		.height = height,
+		.depth = 1
+	};
+
+	const GFXRegion dst = {
+		.offset = 0,
+		.rowSize = 0,
+		.numRows = 0
+	};
+
+	return gfx_read(
+		gfx_ref_attach(renderer, index), out.data(),
+		GFX_TRANSFER_BLOCK, 1, 0, &src, &dst, nullptr);
+}
+
+bool write_ppm(
+		const char *path,
+		uint32_t width, uint32_t height, const uint8_t *rgba) {
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		std::cerr << "Could not open " << path << " for writing.\n";
+		return false;
+	}
+
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+	std::vector<uint8_t> row((size_t)width * 3);
+	bool success = true;
+
+	for (uint32_t y = 0; y < height && success; ++y) {
+		const uint8_t *texel = rgba + (size_t)y * width * 4;
+		for (uint32_t x = 0; x < width; ++x, texel += 4) {
+			row[x * 3 + 0] = texel[0];
+			row[x * 3 + 1] = texel[1];
+			row[x * 3 + 2] = texel[2];
+		}
+
+		success = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	fclose(file);
+	return success;
+}
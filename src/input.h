@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdio.h>
+#include "def.h"
+
+// Live input state, fed by window events.
+struct Input {
+	bool left;
+	bool right;
+	bool forward;
+	bool back;
+	bool up;
+	bool down;
+	bool overlay; // Toggled, not simulated.
+	uint32_t events; // Bumped by every window event, to notice changes.
+
+	vec2<double> mouse[2];
+};
+
+enum InputKey {
+	INPUT_LEFT    = 0x01,
+	INPUT_RIGHT   = 0x02,
+	INPUT_FORWARD = 0x04,
+	INPUT_BACK    = 0x08,
+	INPUT_UP      = 0x10,
+	INPUT_DOWN    = 0x20
+};
+
+// Input consumed by a single simulated frame.
+struct InputFrame {
+	uint8_t keys; // InputKey bits.
+	vec2<float> mouseVel;
+};
+
+uint8_t input_pack_keys(const Input &input);
+
+// Writes one InputFrame per simulated frame.
+// File layout: "FZIN", uint32 version, double step,
+// then per frame a key byte (bit 7 set if mouse moved),
+// followed by two floats if the mouse moved. Native endianness.
+class InputRecorder {
+public:
+	InputRecorder() : file(nullptr) {}
+	~InputRecorder() { close(); }
+
+	// `step` is the replay timestep in seconds.
+	bool open(const char *path, double step);
+	void close();
+
+	bool write(const InputFrame &frame);
+
+private:
+	FILE *file;
+};
+
+class InputReplay {
+public:
+	InputReplay() : file(nullptr), timestep(0.0) {}
+	~InputReplay() { close(); }
+
+	bool open(const char *path);
+	void close();
+
+	// Returns false at the end of the recording.
+	bool read(InputFrame &frame);
+	double step() { return timestep; }
+
+private:
+	FILE *file;
+	double timestep;
+};
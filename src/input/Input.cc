@@ -0,0 +1,108 @@
+#include <string.h>
+#include "input.h"
+
+#define INPUT_MAGIC "FZIN"
+#define INPUT_VERSION 1
+#define INPUT_MOUSE 0x80
+
+uint8_t input_pack_keys(const Input &input) {
+	return
+		(input.left ? INPUT_LEFT : 0) |
+		(input.right ? INPUT_RIGHT : 0) |
+		(input.forward ? INPUT_FORWARD : 0) |
+		(input.back ? INPUT_BACK : 0) |
+		(input.up ? INPUT_UP : 0) |
+		(input.down ? INPUT_DOWN : 0);
+}
+
+bool InputRecorder::open(const char *path, double step) {
+	close();
+
+	file = fopen(path, "wb");
+	if (!file) {
+		std::cerr << "Could not open " << path << " for writing.\n";
+		return false;
+	}
+
+	const uint32_t version = INPUT_VERSION;
+	if (
+		fwrite(INPUT_MAGIC, 1, 4, file) != 4 ||
+		fwrite(&version, sizeof(version), 1, file) != 1 ||
+		fwrite(&step, sizeof(step), 1, file) != 1)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void InputRecorder::close() {
+	if (file) fclose(file);
+	file = nullptr;
+}
+
+bool InputRecorder::write(const InputFrame &frame) {
+	if (!file) return false;
+
+	// Most frames have no mouse movement, store those as a single byte.
+	const bool mouse = frame.mouseVel[0] != 0.0f || frame.mouseVel[1] != 0.0f;
+	const uint8_t keys = frame.keys | (mouse ? INPUT_MOUSE : 0);
+
+	if (fwrite(&keys, 1, 1, file) != 1)
+		return false;
+
+	if (mouse && fwrite(frame.mouseVel.data, sizeof(float), 2, file) != 2)
+		return false;
+
+	return true;
+}
+
+bool InputReplay::open(const char *path) {
+	close();
+
+	file = fopen(path, "rb");
+	if (!file) {
+		std::cerr << "Could not open " << path << " for reading.\n";
+		return false;
+	}
+
+	char magic[4];
+	uint32_t version;
+
+	if (
+		fread(magic, 1, 4, file) != 4 ||
+		memcmp(magic, INPUT_MAGIC, 4) != 0 ||
+		fread(&version, sizeof(version), 1, file) != 1 ||
+		version != INPUT_VERSION ||
+		fread(&timestep, sizeof(timestep), 1, file) != 1 ||
+		!(timestep > 0.0))
+	{
+		std::cerr << "Not a valid input recording: " << path << '\n';
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void InputReplay::close() {
+	if (file) fclose(file);
+	file = nullptr;
+}
+
+bool InputReplay::read(InputFrame &frame) {
+	if (!file) return false;
+
+	uint8_t keys;
+	if (fread(&keys, 1, 1, file) != 1)
+		return false;
+
+	frame.keys = keys & ~INPUT_MOUSE;
+	frame.mouseVel = vec2<float>();
+
+	if ((keys & INPUT_MOUSE) && fread(frame.mouseVel.data, sizeof(float), 2, file) != 2)
+		return false;
+
+	return true;
+}
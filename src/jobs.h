@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class JobPool {
+public:
+	// 0 threads means one less than the hardware concurrency,
+	// the calling thread always participates.
+	JobPool(size_t numThreads = 0);
+	~JobPool();
+
+	size_t numThreads() { return threads.size() + 1; }
+
+	// Calls func(begin, end) over [0, count) in chunks of at most `grain`.
+	// Blocks until all chunks are done, nested calls run inline.
+	// Workers run inside a NoAllocRegion if the caller is,
+	// their allocations are credited to the caller.
+	// Only referenced while running, so captures never allocate.
+	template<typename F>
+	void parallelFor(size_t count, size_t grain, const F &func) {
+		dispatch(count, grain, &func, [](const void *f, size_t begin, size_t end) {
+			(*(const F*)f)(begin, end);
+		});
+	}
+
+private:
+	using Call = void (*)(const void*, size_t, size_t);
+
+	void dispatch(size_t count, size_t grain, const void *func, Call call);
+	void run();
+	void work();
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Current job.
+	const void *func;
+	Call call;
+	size_t count;
+	size_t grain;
+	unsigned int regionDepth; // Of the caller.
+	uint64_t workerAllocs;
+	std::atomic<size_t> next;
+	size_t finished;
+	size_t generation;
+	bool quit;
+	bool busy;
+};
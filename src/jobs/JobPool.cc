@@ -0,0 +1,99 @@
+#include "jobs.h"
+#include "memory.h"
+
+JobPool::JobPool(size_t numThreads) :
+	func(nullptr), call(nullptr), count(0), grain(1), regionDepth(0), workerAllocs(0), next(0),
+	finished(0), generation(0), quit(false), busy(false) {
+	if (numThreads == 0) {
+		const size_t hw = std::thread::hardware_concurrency();
+		numThreads = hw > 1 ? hw - 1 : 0;
+	}
+
+	for (size_t t = 0; t < numThreads; ++t)
+		threads.emplace_back(&JobPool::run, this);
+}
+
+JobPool::~JobPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+
+	wake.notify_all();
+	for (auto &thread : threads)
+		thread.join();
+}
+
+void JobPool::work() {
+	size_t begin;
+	while ((begin = next.fetch_add(grain)) < count) {
+		const size_t end = begin + grain < count ? begin + grain : count;
+		call(func, begin, end);
+	}
+}
+
+void JobPool::run() {
+	size_t seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seen; });
+
+			if (quit) return;
+			seen = generation;
+		}
+
+		const uint64_t allocs = heap_allocs();
+		{
+			NoAllocRegion region(regionDepth > 0);
+			work();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			workerAllocs += heap_allocs() - allocs;
+			++finished;
+		}
+
+		done.notify_all();
+	}
+}
+
+void JobPool::dispatch(size_t count, size_t grain, const void *func, Call call) {
+	if (count == 0) return;
+	if (grain == 0) grain = 1;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		// Nested or concurrent use, or nothing to gain; just run inline.
+		if (busy || threads.empty() || count <= grain) {
+			lock.unlock();
+			for (size_t b = 0; b < count; b += grain)
+				call(func, b, b + grain < count ? b + grain : count);
+
+			return;
+		}
+
+		busy = true;
+		this->func = func;
+		this->call = call;
+		this->count = count;
+		this->grain = grain;
+		regionDepth = heap_region_depth();
+		workerAllocs = 0;
+		next = 0;
+		finished = 0;
+		++generation;
+	}
+
+	wake.notify_all();
+	work();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	// Every worker joins every job, so none can still be reading it after this.
+	done.wait(lock, [&] { return finished == threads.size(); });
+	heap_credit_allocs(workerAllocs);
+	busy = false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class JsonValue {
+public:
+	enum Type {
+		NUL,
+		BOOLEAN,
+		NUMBER,
+		STRING,
+		ARRAY,
+		OBJECT
+	};
+
+	JsonValue() : type(NUL), num(0.0) {}
+
+	// Parses an entire document, returns false on malformed input.
+	static bool parse(const char *str, size_t len, JsonValue &out);
+
+	Type getType() const { return type; }
+	bool isNull() const { return type == NUL; }
+	bool isArray() const { return type == ARRAY; }
+	bool isObject() const { return type == OBJECT; }
+
+	bool boolean(bool def = false) const { return type == BOOLEAN ? num != 0.0 : def; }
+	double number(double def = 0.0) const { return type == NUMBER ? num : def; }
+	size_t index(size_t def = SIZE_MAX) const { return type == NUMBER && num >= 0.0 ? (size_t)num : def; }
+	const std::string &string() const { return str; }
+
+	// Number of array elements or object members.
+	size_t size() const { return values.size(); }
+
+	// Out-of-range or mismatching lookups return a null value.
+	const JsonValue &operator[](size_t i) const;
+	const JsonValue &operator[](const char *key) const;
+	const JsonValue &operator[](int i) const { return (*this)[(size_t)i]; }
+	const std::string &key(size_t i) const;
+
+private:
+	struct Parser;
+
+	Type type;
+	double num;
+	std::string str;
+	std::vector<std::string> keys;
+	std::vector<JsonValue> values;
+};
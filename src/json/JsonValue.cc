@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+struct JsonValue::Parser {
+	const char *cur;
+	const char *end;
+	unsigned int depth;
+
+	void skip() {
+		while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r'))
+			++cur;
+	}
+
+	bool match(const char *lit) {
+		const size_t len = strlen(lit);
+		if ((size_t)(end - cur) < len || strncmp(cur, lit, len) != 0)
+			return false;
+
+		cur += len;
+		return true;
+	}
+
+	// Advances to the next quote or backslash (or the end).
+	void scanString() {
+#if defined(__SSE2__)
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i slash = _mm_set1_epi8('\\');
+
+		for (; end - cur >= 16; cur += 16) {
+			const __m128i chars = _mm_loadu_si128((const __m128i*)cur);
+			const int mask = _mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, slash)));
+
+			if (mask) {
+				cur += __builtin_ctz((unsigned int)mask);
+				return;
+			}
+		}
+#endif
+		while (cur < end && *cur != '"' && *cur != '\\') ++cur;
+	}
+
+	static int hex(char c) {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	void utf8(std::string &out, unsigned long cp) {
+		if (cp < 0x80)
+			out += (char)cp;
+		else if (cp < 0x800) {
+			out += (char)(0xc0 | (cp >> 6));
+			out += (char)(0x80 | (cp & 0x3f));
+		} else if (cp < 0x10000) {
+			out += (char)(0xe0 | (cp >> 12));
+			out += (char)(0x80 | ((cp >> 6) & 0x3f));
+			out += (char)(0x80 | (cp & 0x3f));
+		} else {
+			out += (char)(0xf0 | (cp >> 18));
+			out += (char)(0x80 | ((cp >> 12) & 0x3f));
+			out += (char)(0x80 | ((cp >> 6) & 0x3f));
+			out += (char)(0x80 | (cp & 0x3f));
+		}
+	}
+
+	bool parseHex4(unsigned long &cp) {
+		if (end - cur < 4) return false;
+
+		cp = 0;
+		for (int i = 0; i < 4; ++i) {
+			const int h = hex(*cur++);
+			if (h < 0) return false;
+			cp = (cp << 4) | (unsigned long)h;
+		}
+
+		return true;
+	}
+
+	bool parseString(std::string &out) {
+		if (cur >= end || *cur != '"') return false;
+		++cur;
+
+		while (cur < end && *cur != '"') {
+			// Copy unescaped runs in one go, strings can be huge (data URIs).
+			const char *run = cur;
+			scanString();
+			out.append(run, (size_t)(cur - run));
+
+			if (cur >= end || *cur == '"') break;
+
+			if (++cur >= end) return false;
+			switch (*cur++) {
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				unsigned long cp;
+				if (!parseHex4(cp)) return false;
+
+				// Surrogate pair.
+				if (cp >= 0xd800 && cp < 0xdc00 && match("\\u")) {
+					unsigned long lo;
+					if (!parseHex4(lo)) return false;
+					cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+				}
+
+				utf8(out, cp);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+
+		if (cur >= end) return false;
+		++cur;
+
+		return true;
+	}
+
+	bool parseValue(JsonValue &out) {
+		skip();
+		if (cur >= end || ++depth > 256) return false;
+
+		bool ok = true;
+		switch (*cur) {
+		case '{':
+			out.type = OBJECT;
+			++cur, skip();
+
+			if (cur < end && *cur == '}') { ++cur; break; }
+
+			while (ok) {
+				skip();
+				out.keys.emplace_back();
+				out.values.emplace_back();
+
+				ok = parseString(out.keys.back());
+				skip();
+				ok = ok && cur < end && *cur++ == ':';
+				ok = ok && parseValue(out.values.back());
+				skip();
+
+				if (!ok || cur >= end) { ok = false; break; }
+				if (*cur == '}') { ++cur; break; }
+				ok = *cur++ == ',';
+			}
+			break;
+
+		case '[':
+			out.type = ARRAY;
+			++cur, skip();
+
+			if (cur < end && *cur == ']') { ++cur; break; }
+
+			while (ok) {
+				out.values.emplace_back();
+				ok = parseValue(out.values.back());
+				skip();
+
+				if (!ok || cur >= end) { ok = false; break; }
+				if (*cur == ']') { ++cur; break; }
+				ok = *cur++ == ',';
+			}
+			break;
+
+		case '"':
+			out.type = STRING;
+			ok = parseString(out.str);
+			break;
+
+		case 't':
+			out.type = BOOLEAN;
+			out.num = 1.0;
+			ok = match("true");
+			break;
+
+		case 'f':
+			out.type = BOOLEAN;
+			out.num = 0.0;
+			ok = match("false");
+			break;
+
+		case 'n':
+			out.type = NUL;
+			ok = match("null");
+			break;
+
+		default: {
+			// strtod needs a terminated string, copy the token.
+			char buf[64];
+			size_t len = 0;
+			while (cur < end && len < sizeof(buf) - 1 &&
+				(strchr("+-.eE", *cur) || (*cur >= '0' && *cur <= '9')))
+			{
+				buf[len++] = *cur++;
+			}
+
+			buf[len] = '\0';
+			char *last;
+			out.type = NUMBER;
+			out.num = strtod(buf, &last);
+			ok = len > 0 && last == buf + len;
+			break;
+		}
+		}
+
+		--depth;
+		return ok;
+	}
+};
+
+bool JsonValue::parse(const char *str, size_t len, JsonValue &out) {
+	Parser parser = { str, str + len, 0 };
+
+	out = JsonValue();
+	if (!parser.parseValue(out))
+		return false;
+
+	parser.skip();
+	return parser.cur == parser.end;
+}
+
+static const JsonValue nullValue = {};
+static const std::string emptyString = {};
+
+const JsonValue &JsonValue::operator[](size_t i) const {
+	return (type == ARRAY || type == OBJECT) && i < values.size() ?
+		values[i] : nullValue;
+}
+
+const JsonValue &JsonValue::operator[](const char *key) const {
+	if (type == OBJECT)
+		for (size_t k = 0; k < keys.size(); ++k)
+			if (keys[k] == key) return values[k];
+
+	return nullValue;
+}
+
+const std::string &JsonValue::key(size_t i) const {
+	return type == OBJECT && i < keys.size() ? keys[i] : emptyString;
+}
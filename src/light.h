@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include "def.h"
+#include "jobs.h"
+#include "memory.h"
+
+class GraphNode;
+class LightNode;
+
+// Froxel grid dimensions & capacities, must match basic.frag.
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS 4096
+#define MAX_LIGHT_INDICES (1 << 17)
+
+// GPU layout of a binned view, as a std430 storage buffer:
+//  ClusterHeader, GpuLight[MAX_LIGHTS],
+//  uint32_t[2][CLUSTER_X * CLUSTER_Y * CLUSTER_Z] (offset, count),
+//  uint32_t[MAX_LIGHT_INDICES].
+struct ClusterHeader {
+	uint32_t grid[3];
+	uint32_t numDirectional; // Lights [0, numDirectional) apply everywhere.
+	float sliceScale; // slice = log(depth) * scale + bias.
+	float sliceBias;
+	uint32_t numLights;
+	uint32_t pad;
+};
+
+struct GpuLight {
+	float position[4];  // xyz, reach.
+	float color[4];     // rgb * intensity, type.
+	float direction[4]; // xyz, spot angle scale.
+	float spot[4];      // Spot angle offset, unused.
+};
+
+// Bins all lights of a graph into a view's clipped froxel grid,
+// exponentially sliced in depth, so shading only loops over nearby lights.
+class LightClusters {
+public:
+	struct Stats {
+		size_t lights;
+		size_t binned; // Lights overlapping the view.
+		size_t indices;
+		bool overflow; // Some clusters were truncated.
+		double binMs;
+	};
+
+	// Bins in parallel if given a job pool.
+	LightClusters(JobPool *jobs = nullptr);
+
+	// Bytes written by bin().
+	static size_t bufferSize();
+
+	// (Re)collect all light nodes of a graph.
+	void gather(GraphNode *graph);
+
+	// Must be called after the graph is updated, clusters span [near, far].
+	// `viewProj` must be a symmetric perspective projection of a rigid view.
+	void bin(const mat4<float> &viewProj, float near, float far, void *out);
+
+	size_t numLights() { return lights.size(); }
+	const Stats &stats() { return last; }
+
+private:
+	void gatherNode(GraphNode *node);
+
+	// Clip-space bounding box, inclusive slice range, empty if z0 > z1.
+	struct Bounds {
+		float x, y, w;
+		float rx, ry, rw;
+		uint16_t z0, z1;
+	};
+
+	JobPool *jobs;
+
+	std::vector<LightNode*> lights; // Directional first.
+	size_t numDirectional;
+
+	std::vector<Bounds> bounds;
+	std::vector<uint32_t> sliceOffsets;
+	std::vector<uint32_t> capacities; // Per cluster.
+
+	Stats last;
+	MemCharge charge = { MEM_GRAPH };
+};
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include "graph.h"
+#include "light.h"
+
+static const size_t NUM_CLUSTERS = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+LightClusters::LightClusters(JobPool *jobs) :
+	jobs(jobs), numDirectional(0), sliceOffsets(CLUSTER_Z), capacities(NUM_CLUSTERS), last{} {}
+
+size_t LightClusters::bufferSize() {
+	return
+		sizeof(ClusterHeader) +
+		sizeof(GpuLight) * MAX_LIGHTS +
+		sizeof(uint32_t) * 2 * NUM_CLUSTERS +
+		sizeof(uint32_t) * MAX_LIGHT_INDICES;
+}
+
+void LightClusters::gatherNode(GraphNode *node) {
+	if (LightNode *light = dynamic_cast<LightNode*>(node))
+		lights.push_back(light);
+
+	for (size_t c = 0; c < node->numChildren(); ++c)
+		gatherNode(node->getChild(c));
+}
+
+void LightClusters::gather(GraphNode *graph) {
+	lights.clear();
+
+	if (graph) gatherNode(graph);
+
+	// Directional lights are not binned, keep them up front.
+	auto mid = std::stable_partition(lights.begin(), lights.end(),
+		[](LightNode *light) { return light->type == LightNode::DIRECTIONAL; });
+
+	numDirectional = (size_t)(mid - lights.begin());
+	bounds.resize(lights.size());
+
+	charge.set(
+		lights.capacity() * sizeof(LightNode*) +
+		bounds.capacity() * sizeof(Bounds) +
+		capacities.capacity() * sizeof(uint32_t));
+}
+
+void LightClusters::bin(const mat4<float> &viewProj, float near, float far, void *out) {
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+
+	// Inline without a job pool.
+	auto run = [&](size_t count, size_t grain, const auto &func) {
+		if (jobs) jobs->parallelFor(count, grain, func);
+		else func(0, count);
+	};
+
+	char *bytes = (char*)out;
+	ClusterHeader *header = (ClusterHeader*)bytes;
+	GpuLight *gpuLights = (GpuLight*)(bytes + sizeof(ClusterHeader));
+	uint32_t *clusters = (uint32_t*)(gpuLights + MAX_LIGHTS);
+	uint32_t *indices = clusters + 2 * NUM_CLUSTERS;
+
+	const size_t count = std::min(lights.size(), (size_t)MAX_LIGHTS);
+	const size_t first = std::min(numDirectional, count);
+
+	const float logRatio = logf(far / near);
+	const float scale = (float)CLUSTER_Z / logRatio;
+	const float bias = -(float)CLUSTER_Z * logf(near) / logRatio;
+
+	*header = ClusterHeader{
+		{ CLUSTER_X, CLUSTER_Y, CLUSTER_Z },
+		(uint32_t)first, scale, bias, (uint32_t)count, 0 };
+
+	// Depth at the near side of each slice, the inverse of slicing.
+	float sliceDepths[CLUSTER_Z + 1];
+	for (size_t z = 0; z <= CLUSTER_Z; ++z)
+		sliceDepths[z] = expf(((float)z - bias) / scale);
+
+	sliceDepths[0] = near;
+	sliceDepths[CLUSTER_Z] = far;
+
+	auto slice = [&](float depth) {
+		const int s = (int)floorf(logf(depth) * scale + bias);
+		return (uint16_t)GFX_CLAMP(s, 0, CLUSTER_Z - 1);
+	};
+
+	// Normalized device bounds of a box between two positive depths,
+	// x/w & y/w are extreme at its corners.
+	struct Rect { float x0, x1, y0, y1; };
+
+	auto rect = [](const Bounds &b, float d0, float d1) {
+		return Rect{
+			GFX_MIN((b.x - b.rx) / d0, (b.x - b.rx) / d1),
+			GFX_MAX((b.x + b.rx) / d0, (b.x + b.rx) / d1),
+			GFX_MIN((b.y - b.ry) / d0, (b.y - b.ry) / d1),
+			GFX_MAX((b.y + b.ry) / d0, (b.y + b.ry) / d1)
+		};
+	};
+
+	auto tile = [](float ndc, int size) {
+		const int t = (int)floorf((ndc * 0.5f + 0.5f) * (float)size);
+		return (size_t)GFX_CLAMP(t, 0, size - 1);
+	};
+
+	// Rows of a rigid view scaled by the projection,
+	// their length scales a world-space radius to clip-space.
+	float rowScale[3];
+	for (size_t r = 0; r < 3; ++r) {
+		const float *row = viewProj[r == 2 ? 3 : r];
+		rowScale[r] = sqrtf(row[0] * row[0] + row[1] * row[1] + row[2] * row[2]);
+	}
+
+	// Convert all lights & find the slices each one overlaps.
+	run(count, 256, [&](size_t begin, size_t end) {
+		for (size_t l = begin; l < end; ++l) {
+			LightNode *light = lights[l];
+			const vec3<float> pos = light->position();
+			const vec3<float> dir = light->direction();
+			const vec3<float> color = light->color * light->intensity;
+			const float reach = light->reach();
+
+			// As recommended by KHR_lights_punctual.
+			const float cosOuter = cosf(light->outerCone);
+			const float cosInner = cosf(light->innerCone);
+			const float angleScale = 1.0f / GFX_MAX(0.001f, cosInner - cosOuter);
+
+			gpuLights[l] = GpuLight{
+				{ pos[0], pos[1], pos[2], reach },
+				{ color[0], color[1], color[2], (float)light->type },
+				{ dir[0], dir[1], dir[2], angleScale },
+				{ -cosOuter * angleScale, 0.0f, 0.0f, 0.0f }
+			};
+
+			Bounds &b = bounds[l];
+			b.z0 = 1, b.z1 = 0;
+
+			if (l < first) continue;
+
+			// Clip-space w is view depth.
+			const float *w = viewProj[3];
+			const vec3<float> clip = viewProj * pos;
+
+			b.x = clip[0];
+			b.y = clip[1];
+			b.w = w[0] * pos[0] + w[1] * pos[1] + w[2] * pos[2] + w[3];
+			b.rx = reach * rowScale[0];
+			b.ry = reach * rowScale[1];
+			b.rw = reach * rowScale[2];
+
+			const float d0 = GFX_MAX(b.w - b.rw, near);
+			const float d1 = GFX_MIN(b.w + b.rw, far);
+			if (d0 > d1) continue;
+
+			const Rect r = rect(b, d0, d1);
+			if (r.x1 < -1.0f || r.x0 > 1.0f || r.y1 < -1.0f || r.y0 > 1.0f)
+				continue;
+
+			b.z0 = slice(d0);
+			b.z1 = slice(d1);
+		}
+	});
+
+	// Visits all clusters of a slice overlapped by each light,
+	// bounded by the part of the light within the slice's depth.
+	const size_t sliceSize = CLUSTER_X * CLUSTER_Y;
+
+	auto overlaps = [&](size_t z, auto &&func) {
+		for (size_t l = first; l < count; ++l) {
+			const Bounds &b = bounds[l];
+			if (z < b.z0 || z > b.z1) continue;
+
+			const Rect r = rect(b,
+				GFX_MAX(b.w - b.rw, sliceDepths[z]),
+				GFX_MIN(b.w + b.rw, sliceDepths[z + 1]));
+
+			const size_t x0 = tile(r.x0, CLUSTER_X), x1 = tile(r.x1, CLUSTER_X);
+			const size_t y0 = tile(r.y0, CLUSTER_Y), y1 = tile(r.y1, CLUSTER_Y);
+
+			for (size_t y = y0; y <= y1; ++y)
+				for (size_t x = x0; x <= x1; ++x)
+					func(z * sliceSize + y * CLUSTER_X + x, (uint32_t)l);
+		}
+	};
+
+	// Count per cluster, each slice is owned by a single task.
+	run(CLUSTER_Z, 1, [&](size_t begin, size_t end) {
+		for (size_t z = begin; z < end; ++z) {
+			for (size_t i = z * sliceSize; i < (z + 1) * sliceSize; ++i)
+				clusters[i * 2 + 1] = 0;
+
+			overlaps(z, [&](size_t i, uint32_t) { ++clusters[i * 2 + 1]; });
+
+			uint32_t total = 0;
+			for (size_t i = z * sliceSize; i < (z + 1) * sliceSize; ++i)
+				total += clusters[i * 2 + 1];
+
+			sliceOffsets[z] = total;
+		}
+	});
+
+	uint32_t numIndices = 0;
+	for (size_t z = 0; z < CLUSTER_Z; ++z) {
+		const uint32_t total = sliceOffsets[z];
+		sliceOffsets[z] = numIndices;
+		numIndices += total;
+	}
+
+	// Assign ranges & fill, truncating whatever does not fit.
+	run(CLUSTER_Z, 1, [&](size_t begin, size_t end) {
+		for (size_t z = begin; z < end; ++z) {
+			uint32_t offset = sliceOffsets[z];
+
+			for (size_t i = z * sliceSize; i < (z + 1) * sliceSize; ++i) {
+				const uint32_t size = clusters[i * 2 + 1];
+				const uint32_t avail =
+					offset < MAX_LIGHT_INDICES ? MAX_LIGHT_INDICES - offset : 0;
+
+				capacities[i] = std::min(size, avail);
+				clusters[i * 2] = std::min(offset, (uint32_t)MAX_LIGHT_INDICES);
+				clusters[i * 2 + 1] = 0;
+				offset += size;
+			}
+
+			overlaps(z, [&](size_t i, uint32_t l) {
+				if (clusters[i * 2 + 1] < capacities[i])
+					indices[clusters[i * 2] + clusters[i * 2 + 1]++] = l;
+			});
+		}
+	});
+
+	size_t binned = 0;
+	for (size_t l = first; l < count; ++l)
+		binned += bounds[l].z0 <= bounds[l].z1;
+
+	last = Stats{
+		lights.size(),
+		binned,
+		std::min(numIndices, (uint32_t)MAX_LIGHT_INDICES),
+		numIndices > MAX_LIGHT_INDICES || lights.size() > MAX_LIGHTS,
+		std::chrono::duration<double, std::milli>(clock::now() - start).count()
+	};
+}
@@ -1,18 +1,29 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <math.h>
+#include <mutex>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include "anim.h"
+#include "assets.h"
+#include "bench.h"
+#include "cull.h"
 #include "data.h"
 #include "def.h"
 #include "graph.h"
-
-struct Input {
-	bool left;
-	bool right;
-	bool forward;
-	bool back;
-	bool up;
-	bool down;
-
-	vec2<double> mouse[2];
-};
+#include "image.h"
+#include "input.h"
+#include "light.h"
+#include "math/chain.h"
+#include "memory.h"
+#include "pacer.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "texture.h"
 
 bool key_press(GFXWindow *window, GFXKey key, int, GFXModifier mod, void*) {
 	switch (key) {
@@ -31,6 +42,8 @@ bool key_press(GFXWindow *window, GFXKey key, int, GFXModifier mod, void*) {
 	}
 
 	Input *inp = (Input*)window->ptr;
+	++inp->events;
+
 	switch (key) {
 	case GFX_KEY_A:
 	case GFX_KEY_LEFT:
@@ -63,6 +76,9 @@ bool key_press(GFXWindow *window, GFXKey key, int, GFXModifier mod, void*) {
 
 bool key_release(GFXWindow *window, GFXKey key, int, GFXModifier, void*) {
 	switch (key) {
+	case GFX_KEY_F2:
+		mem_request_dump();
+		break;
 	case GFX_KEY_F11:
 		if (gfx_window_get_monitor(window) != nullptr) {
 			gfx_window_set_monitor(
@@ -79,6 +95,8 @@ bool key_release(GFXWindow *window, GFXKey key, int, GFXModifier, void*) {
 	}
 
 	Input *inp = (Input*)window->ptr;
+	++inp->events;
+
 	switch (key) {
 	case GFX_KEY_A:
 	case GFX_KEY_LEFT:
@@ -102,6 +120,9 @@ bool key_release(GFXWindow *window, GFXKey key, int, GFXModifier, void*) {
 	case GFX_KEY_LEFT_SHIFT:
 		inp->down = false;
 		break;
+	case GFX_KEY_F3:
+		inp->overlay = !inp->overlay;
+		break;
 	default:
 		break;
 	}
@@ -113,10 +134,19 @@ bool mouse_move(GFXWindow *window, double x, double y, void*) {
 	Input *inp = (Input*)window->ptr;
 	inp->mouse[1] = inp->mouse[0];
 	inp->mouse[0] = vec2<double>(x, y);
+	++inp->events;
 
 	return 0;
 }
 
+void window_resize(GFXWindow *window, uint32_t, uint32_t, void*) {
+	++((Input*)window->ptr)->events;
+}
+
+void window_focus(GFXWindow *window, void*) {
+	++((Input*)window->ptr)->events;
+}
+
 GFXShader *load_shader(GFXShaderStage stage, const char *path) {
 	GFXFile file;
 	dassert(gfx_file_init(&file, path, "rb"));
@@ -137,154 +167,502 @@ GFXShader *load_shader(GFXShaderStage stage, const char *path) {
 	return shader;
 }
 
-GraphNode *load_gltf_node(
-		GFXTechnique *tech, GFXPass *pass, GFXSet **sets,
-		GraphNode *parent, GFXGltfNode *node) {
-	const auto matrix = mat4<float>(node->matrix).transpose(); // Column -> row major.
-	std::unique_ptr<GraphNode> parsed = {};
-
-	if (!node->mesh)
-		parsed = std::make_unique<GraphNode>(matrix);
-	else {
-		auto mesh = std::make_unique<MeshNode>(matrix);
-
-		for (size_t p = 0; p < node->mesh->numPrimitives; ++p) {
-			GFXGltfPrimitive *prim = &node->mesh->primitives[p];
-			size_t i = mesh->addPrimitive(MeshNode::Primitive{tech, prim->primitive});
-			dassert(mesh->setForward(i, pass, nullptr));
-			dassert(mesh->assignSets(i, sets));
-		}
+struct Camera {
+	vec3<float> pos;
+	float pitch;
+	float yaw;
+};
 
-		parsed = std::move(mesh);
-	}
+// Clip planes, also the depth range of the light clusters.
+static const float CAMERA_NEAR = 0.01f;
+static const float CAMERA_FAR = 100.0f;
 
-	for (size_t n = 0; n < node->numChildren; ++n)
-		load_gltf_node(
-			tech, pass, sets,
-			parsed.get(), node->children[n]);
+// Frames to grow all reused storage before allocating is an error.
+static const uint64_t ALLOC_WARMUP_FRAMES = 16;
 
-	return parent->addChild(std::move(parsed));
+mat4<float> camera_view_proj(const Camera &cam, float aspect) {
+	const float pi2 = 6.28318530718f;
+
+	// Evaluated in the cheapest order, skipping all known zeros & ones.
+	return smat_chain(
+		smat_perspective(pi2 / 4.0f, aspect, CAMERA_NEAR, CAMERA_FAR),
+		smat_rotate_x(-cam.pitch),
+		smat_rotate_y(-cam.yaw),
+		smat_translate(cam.pos * -1.0f)).dense();
 }
 
-std::unique_ptr<GraphNode> load_gltf(
-		GFXHeap *heap, GFXDependency *dep,
-		GFXTechnique *tech, GFXPass *pass, GFXSet **sets,
-		const char *path) {
-	GFXFile file;
-	dassert(gfx_file_init(&file, path, "rb"));
+void print_geometry(const GeometryArena::Stats &stats) {
+	printf(
+		"geometry: %zu pages, %zu ranges (%zu retired), "
+		"vertices %llu/%llu KiB (%.1f%%, %.1f%% fragmented), "
+		"indices %llu/%llu KiB (%.1f%%, %.1f%% fragmented)\n",
+		stats.pages, stats.ranges, stats.retired,
+		(unsigned long long)(stats.vertices.used / 1024),
+		(unsigned long long)(stats.vertices.capacity / 1024),
+		stats.vertices.occupancy() * 100.0, stats.vertices.fragmentation() * 100.0,
+		(unsigned long long)(stats.indices.used / 1024),
+		(unsigned long long)(stats.indices.capacity / 1024),
+		stats.indices.occupancy() * 100.0, stats.indices.fragmentation() * 100.0);
+}
 
-	GFXFileIncluder inc;
-	dassert(gfx_file_includer_init(&inc, path, "rb"));
+// Counters of a frame as overlay text, formatted without allocating.
+void print_overlay(
+		StatsOverlay *overlay, size_t frame,
+		double cpuMs, double recordMs, double gpuMs, float scale,
+		const FrameCounters &counters) {
+	char text[StatsOverlay::ROWS * (StatsOverlay::COLUMNS + 1)];
+	snprintf(text, sizeof(text),
+		"frame %zu, scale %.2f\n"
+		"cpu %.2f ms, record %.2f ms, gpu %.2f ms\n"
+		"nodes %zu, transforms %zu, %llu kib written\n"
+		"%llu kib uploaded, %llu allocs\n"
+		"visible %zu, culled %zu\n"
+		"draws %zu, binds %zu, tris %llu\n",
+		frame, scale,
+		cpuMs, recordMs, gpuMs,
+		counters.nodes, counters.transforms,
+		(unsigned long long)(counters.writeBytes / 1024),
+		(unsigned long long)(counters.uploadBytes / 1024),
+		(unsigned long long)counters.allocs,
+		counters.visible, counters.culled,
+		counters.draws, counters.binds,
+		(unsigned long long)counters.primitives);
+
+	overlay->setText(text);
+}
 
-	const char *attributeOrder[] = {
-		"POSITION",
-		"NORMAL"
-	};
+// Input handed from the event thread to the simulation thread.
+struct SharedInput {
+	std::mutex lock;
+	Input keys;
+	vec2<double> mouseVel;
+};
 
-	const GFXGltfOptions opts = {
-		.maxAttributes = sizeof(attributeOrder)/sizeof(char*),
-		.orderSize = sizeof(attributeOrder)/sizeof(char*),
-		.attributeOrder = attributeOrder
-	};
+// Everything owned by the simulation thread while it runs.
+struct Simulation {
+	GraphNode *graph;
+	FrameData *data;
+	Animator *animator;
+	OcclusionCuller *culler;
+	LightClusters *lights;
+	FrameData *lightData;
+	FrameData *depthData; // Optional, culling on the GPU.
+	GFXPass *pass;
+	SharedInput *input;
+	InputRecorder *recorder; // Optional.
+	InputReplay *replay;     // Optional, replaces `input`.
+	std::atomic<uint64_t> *size; // Published by the render thread.
+	double fixedStep; // In seconds, 0 to step by wall time.
+	size_t numViews;  // Side by side, each turned further around.
+	bool noAlloc;     // Mark steady-state frames as not allocating.
+	Camera cam;
+};
 
-	GFXGltfResult result;
-	dassert(gfx_load_gltf(
-		heap, dep, &opts,
-		GFX_IMAGE_ANY_FORMAT, GFX_IMAGE_SAMPLED,
-		&file.reader, &inc.includer, &result));
+void simulate(Simulation *sim, SnapshotRing *ring) {
+	auto lastFrame = std::chrono::steady_clock::now();
+	uint64_t frameCount = 0;
+	uint64_t lastSize = 0;
+	size_t lastNodes = 0;
+
+	while (SceneSnapshot *snap = ring->acquireWrite()) {
+		NoAllocRegion region(sim->noAlloc && frameCount >= ALLOC_WARMUP_FRAMES);
+		AllocScope allocs;
+
+		// Take input, stop at the end of a replay.
+		InputFrame input;
+		if (sim->replay) {
+			if (!sim->replay->read(input)) {
+				ring->close();
+				break;
+			}
+		} else {
+			std::lock_guard<std::mutex> guard(sim->input->lock);
+			input.keys = input_pack_keys(sim->input->keys);
+			input.mouseVel = vec2<float>(
+				(float)sim->input->mouseVel[0], (float)sim->input->mouseVel[1]);
+			sim->input->mouseVel = vec2<double>();
+		}
 
-	gfx_file_includer_clear(&inc);
-	gfx_file_clear(&file);
+		if (sim->recorder)
+			sim->recorder->write(input);
 
-	// Convert to graph.
-	auto root = std::make_unique<GraphNode>();
+		const vec2<float> mouseVel = input.mouseVel;
 
-	if (result.scene) {
-		for (size_t n = 0; n < result.scene->numNodes; ++n)
-			load_gltf_node(
-				tech, pass, sets,
-				root.get(), result.scene->nodes[n]);
-	}
+		// Move camera.
+		const float pi2 = 6.28318530718f;
+		const float pi4 = pi2 / 4.0f - 0.01f;
 
-	gfx_release_gltf(&result);
+		sim->cam.yaw += -(mouseVel[0] / 60);
+		sim->cam.pitch = GFX_CLAMP(sim->cam.pitch - (mouseVel[1] / 60), -pi4, pi4);
 
-	return root;
-}
+		const vec3<float> forward =
+			smat_rotate_y(sim->cam.yaw) * smat_rotate_x(sim->cam.pitch) *
+			vec3<float>(0.0f, 0.0f, -1.0f);
+		const vec3<float> right =
+			forward.cross(vec3<float>(0.0f, 1.0f, 0.0f)).normalize();
 
-struct Camera {
-	vec3<float> pos;
-	float pitch;
-	float yaw;
-};
+		const double moveSpeed = 0.01;
+		if (input.keys & INPUT_LEFT)
+			sim->cam.pos -= right * moveSpeed;
+		if (input.keys & INPUT_RIGHT)
+			sim->cam.pos += right * moveSpeed;
+		if (input.keys & INPUT_FORWARD)
+			sim->cam.pos += forward * moveSpeed;
+		if (input.keys & INPUT_BACK)
+			sim->cam.pos -= forward * moveSpeed;
+		if (input.keys & INPUT_UP)
+			sim->cam.pos[1] += moveSpeed;
+		if (input.keys & INPUT_DOWN)
+			sim->cam.pos[1] -= moveSpeed;
+
+		// Animate.
+		const auto frameTime = std::chrono::steady_clock::now();
+		sim->animator->update(sim->fixedStep > 0.0 ? sim->fixedStep :
+			std::chrono::duration<double>(frameTime - lastFrame).count());
+		lastFrame = frameTime;
+
+		// Update & stage the graph once, then cull & collect per view.
+		snapshot_scene(sim->graph, sim->data, *snap);
+		snap->views.resize(sim->numViews);
+
+		const uint64_t size = sim->size->load(std::memory_order_relaxed);
+		const uint32_t width = (uint32_t)(size >> 32), height = (uint32_t)size;
+		const float aspect = (float)width / (float)height / (float)sim->numViews;
+
+		for (size_t v = 0; v < sim->numViews; ++v) {
+			Camera cam = sim->cam;
+			cam.yaw += pi2 * (float)v / (float)sim->numViews;
+
+			const float share = 1.0f / (float)sim->numViews;
+			const float viewport[4] = { share * (float)v, 0.0f, share, 1.0f };
+
+			snapshot_view(
+				sim->graph, sim->culler, sim->pass,
+				camera_view_proj(cam, aspect), viewport, snap->views[v]);
+
+			if (sim->depthData)
+				snapshot_depth(sim->culler, sim->depthData, v, *snap);
+		}
+
+		snapshot_lights(sim->lights, sim->lightData, CAMERA_NEAR, CAMERA_FAR, *snap);
+		snapshot_textures(width, height, *snap);
+
+		// All input moves the camera, the graph changes if any node moved,
+		// was added or removed.
+		snap->changed =
+			frameCount == 0 || size != lastSize ||
+			input.keys != 0 || mouseVel[0] != 0.0f || mouseVel[1] != 0.0f ||
+			snap->counters.moved > 0 || snap->counters.nodes != lastNodes;
+
+		lastSize = size;
+		lastNodes = snap->counters.nodes;
+
+		// Animating, updating, writing, culling & collecting.
+		snap->counters.allocs = allocs.count();
+
+		snap->frame = frameCount++;
+		ring->publish();
+	}
+}
 
 struct Context {
 	GFXTechnique *tech;
-	GraphNode *graph;
-	Camera cam;
+	GFXSet **lightSets;
+	TextureStreamer *textures;
+	IndirectDraws *indirect; // Optional.
+	GFXRenderable *upscale;  // Optional.
+	GFXSet *upscaleSet;
+	StatsOverlay *overlay;   // Optional.
+	const SceneSnapshot *snap;
+	std::atomic<uint64_t> *size;
+	double recordMs; // Of the last render().
+	FrameCounters counters; // Likewise.
 };
 
 void render(GFXRecorder *recorder, void *ptr) {
 	Context *ctx = (Context*)ptr;
 
+	// Publish the output size for the next simulated frame.
 	uint32_t width, height, layers;
 	gfx_recorder_get_size(recorder, &width, &height, &layers);
 
-	const float pi2 = 6.28318530718f;
-	const float vertFov = pi2 / 4.0f;
-	const float aspect = (height != 0) ? (float)width / (float)height : 1.0f;
-	const float near = 0.01f;
-	const float far = 100.0f;
-	const float focalLen = 1.0f / tanf(vertFov / 2.0f);
-
-	const float x = focalLen / aspect;
-	const float y = -focalLen;
-	const float A = near / (far - near);
-	const float B = far * A;
-
-	const auto projection = mat4<float>(
-		x,    0.0f,  0.0f, 0.0f,
-		0.0f, y,     0.0f, 0.0f,
-		0.0f, 0.0f,  A,    B,
-		0.0f, 0.0f, -1.0f, 0.0f);
-
-	const float cosPitch = cosf(-ctx->cam.pitch);
-	const float sinPitch = sinf(-ctx->cam.pitch);
-
-	const auto camPitch = mat4<float>(
-		1.0f, 0.0f,      0.0f,     0.0f,
-		0.0f, cosPitch, -sinPitch, 0.0f,
-		0.0f, sinPitch,  cosPitch, 0.0f,
-		0.0f, 0.0f,      0.0f,     1.0f);
-
-	const float cosYaw = cosf(-ctx->cam.yaw);
-	const float sinYaw = sinf(-ctx->cam.yaw);
-
-	const auto camYaw = mat4<float>(
-		 cosYaw, 0.0f, sinYaw, 0.0f,
-		 0.0f,   1.0f, 0.0f,   0.0f,
-		-sinYaw, 0.0f, cosYaw, 0.0f,
-		 0.0f,   0.0f, 0.0f,   1.0f);
-
-	const auto camPos = mat4<float>(
-		1.0f, 0.0f, 0.0f, -ctx->cam.pos[0],
-		0.0f, 1.0f, 0.0f, -ctx->cam.pos[1],
-		0.0f, 0.0f, 1.0f, -ctx->cam.pos[2],
-		0.0f, 0.0f, 0.0f,  1.0f);
-
-	const mat4<float> viewProj = projection * camPitch * camYaw * camPos;
-
-	gfx_cmd_push(recorder, ctx->tech, 0, sizeof(viewProj.data), viewProj.data);
-	ctx->graph->record(recorder, nullptr);
+	if (width != 0 && height != 0)
+		ctx->size->store((uint64_t)width << 32 | height, std::memory_order_relaxed);
+
+	const auto start = std::chrono::steady_clock::now();
+	record_views(
+		recorder, ctx->tech, ctx->lightSets, ctx->textures, *ctx->snap,
+		&ctx->counters, ctx->indirect);
+
+	ctx->recordMs = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+void cull(GFXRecorder *recorder, void *ptr) {
+	Context *ctx = (Context*)ptr;
+	ctx->indirect->cull(recorder, *ctx->snap);
 }
 
-int main() {
+void upscale(GFXRecorder *recorder, void *ptr) {
+	Context *ctx = (Context*)ptr;
+
+	gfx_cmd_bind(
+		recorder, ctx->upscale->technique,
+		0, 1, 0, &ctx->upscaleSet, nullptr);
+	gfx_cmd_draw(
+		recorder, ctx->upscale, 3, 1, 0, 0);
+
+	ctx->counters.binds += 1;
+	ctx->counters.draws += 1;
+}
+
+void overlay(GFXRecorder *recorder, void *ptr) {
+	Context *ctx = (Context*)ptr;
+	ctx->overlay->record(recorder, &ctx->counters);
+}
+
+// Scene color at a scale of the output, upscaled to it afterwards.
+GFXAttachment scaled_color(float scale) {
+	return GFXAttachment{
+		.type = GFX_IMAGE_2D,
+		.flags = GFX_MEMORY_NONE,
+		.usage = GFX_IMAGE_SAMPLED,
+
+		.format = GFX_FORMAT_R8G8B8A8_UNORM,
+		.samples = 1,
+		.mipmaps = 1,
+		.layers = 1,
+
+		.size = GFX_SIZE_RELATIVE,
+		.ref = 0,
+		.xScale = scale,
+		.yScale = scale,
+		.zScale = 1.0f
+	};
+}
+
+int main(int argc, char **argv) {
+	bool printStats = false;
+	bool occlusion = true;
+	bool bake = false; // Rebakes the scene's textures & exits.
+	bool staticAll = false; // Batches all unanimated nodes.
+	bool gpuDriven = false; // Culls & draws shared ranges on the GPU.
+	bool warmup = true;
+	bool noAlloc = false; // Fails if a steady-state frame allocates.
+	bool showOverlay = false; // Toggled by F3, also drawn headless if set.
+	const char *statsPath = nullptr; // Per-frame counters, CSV or JSON lines.
+	bool onDemand = false; // Sleeps on window events while nothing changes.
+	double fpsLimit = 0.0; // 0 for unlimited.
+	const char *pipelineCache = "fiezta.pipelines"; // nullptr for none.
+	const char *bench = nullptr;
+	unsigned int frames = DEFAULT_VIRTUAL_FRAMES; // 0 for adaptive.
+	double resBudgetMs = 0.0; // Frame time for dynamic resolution, 0 for off.
+	float resMin = 0.5f, resMax = 1.0f;
+	size_t numViews = 1;
+	const char *scenePath = nullptr; // Defaults to assets/5t6.gltf.
+
+	// Headless renders offscreen for a fixed number of frames.
+	bool headless = false;
+	size_t frameCount = 0; // 0 for 100 if headless, otherwise unlimited.
+	uint32_t width = 600, height = 400;
+	const char *outputPath = nullptr;
+
+	// Input capture & replay.
+	const char *recordPath = nullptr;
+	const char *replayPath = nullptr;
+
+	for (int a = 1; a < argc; ++a) {
+		if (strcmp(argv[a], "--stats") == 0)
+			printStats = true;
+		else if (strcmp(argv[a], "--stats-out") == 0 && a + 1 < argc)
+			statsPath = argv[++a];
+		else if (strcmp(argv[a], "--overlay") == 0)
+			showOverlay = true;
+		else if (strcmp(argv[a], "--on-demand") == 0)
+			onDemand = true;
+		else if (strcmp(argv[a], "--fps-limit") == 0 && a + 1 < argc) {
+			fpsLimit = strtod(argv[++a], nullptr);
+			if (!(fpsLimit > 0.0)) {
+				std::cerr << "Invalid frame rate limit: " << argv[a] << '\n';
+				return 1;
+			}
+		}
+		else if (strcmp(argv[a], "--no-occlusion") == 0)
+			occlusion = false;
+		else if (strcmp(argv[a], "--frames") == 0 && a + 1 < argc) {
+			// As <count> or 'adaptive'.
+			const char *arg = argv[++a];
+			if (strcmp(arg, "adaptive") == 0)
+				frames = 0;
+			else if (
+				sscanf(arg, "%u", &frames) != 1 ||
+				frames < 1 || frames > MAX_VIRTUAL_FRAMES)
+			{
+				std::cerr << "Invalid frames in flight: " << arg << '\n';
+				return 1;
+			}
+		}
+		else if (strcmp(argv[a], "--dynamic-res") == 0 && a + 1 < argc) {
+			// As <budget ms>.
+			resBudgetMs = strtod(argv[++a], nullptr);
+			if (!(resBudgetMs > 0.0)) {
+				std::cerr << "Invalid frame time budget: " << argv[a] << '\n';
+				return 1;
+			}
+		}
+		else if (strcmp(argv[a], "--res-bounds") == 0 && a + 1 < argc) {
+			// As <min>:<max> scale per axis.
+			if (
+				sscanf(argv[++a], "%f:%f", &resMin, &resMax) != 2 ||
+				!(resMin > 0.0f) || resMin > resMax || resMax > 1.0f)
+			{
+				std::cerr << "Invalid resolution bounds: " << argv[a] << '\n';
+				return 1;
+			}
+		}
+		else if (strcmp(argv[a], "--views") == 0 && a + 1 < argc) {
+			numViews = strtoull(argv[++a], nullptr, 10);
+			if (numViews == 0) {
+				std::cerr << "Invalid number of views: " << argv[a] << '\n';
+				return 1;
+			}
+		}
+		else if (strcmp(argv[a], "--scene") == 0 && a + 1 < argc)
+			scenePath = argv[++a];
+		else if (strcmp(argv[a], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[a], "--count") == 0 && a + 1 < argc)
+			frameCount = strtoull(argv[++a], nullptr, 10);
+		else if (strcmp(argv[a], "--output") == 0 && a + 1 < argc)
+			outputPath = argv[++a];
+		else if (strcmp(argv[a], "--record") == 0 && a + 1 < argc)
+			recordPath = argv[++a];
+		else if (strcmp(argv[a], "--replay") == 0 && a + 1 < argc)
+			replayPath = argv[++a];
+		else if (strcmp(argv[a], "--size") == 0 && a + 1 < argc) {
+			// As <width>x<height>.
+			if (
+				sscanf(argv[++a], "%ux%u", &width, &height) != 2 ||
+				width == 0 || height == 0)
+			{
+				std::cerr << "Invalid size: " << argv[a] << '\n';
+				return 1;
+			}
+		}
+		else if (strcmp(argv[a], "--bake") == 0)
+			bake = true;
+		else if (strcmp(argv[a], "--static") == 0)
+			staticAll = true;
+		else if (strcmp(argv[a], "--gpu-driven") == 0)
+			gpuDriven = true;
+		else if (strcmp(argv[a], "--no-warmup") == 0)
+			warmup = false;
+		else if (strcmp(argv[a], "--no-alloc") == 0)
+			noAlloc = true;
+		else if (strcmp(argv[a], "--no-alloc-abort") == 0) {
+			// Aborts right at the allocation, for a backtrace.
+			noAlloc = true;
+			heap_set_abort(true);
+		}
+		else if (strcmp(argv[a], "--pipeline-cache") == 0 && a + 1 < argc) {
+			// As <path> or 'none'.
+			pipelineCache = argv[++a];
+			if (strcmp(pipelineCache, "none") == 0)
+				pipelineCache = nullptr;
+		}
+		else if (strcmp(argv[a], "--bench") == 0 && a + 1 < argc)
+			bench = argv[++a];
+		else if (strcmp(argv[a], "--mem-budget") == 0 && a + 1 < argc) {
+			// As <category>=<MiB>.
+			char name[64];
+			double mib;
+			MemCategory cat;
+
+			if (sscanf(argv[++a], "%63[^=]=%lf", name, &mib) != 2 ||
+				!mem_find_category(name, &cat))
+			{
+				std::cerr << "Invalid memory budget: " << argv[a] << '\n';
+				return 1;
+			}
+
+			mem_set_budget(cat, (uint64_t)(mib * 1024.0 * 1024.0));
+		}
+	}
+
+#if defined(SIGUSR1)
+	signal(SIGUSR1, [](int) { mem_request_dump(); });
+#endif
+
+	// Benchmarks need no window, nor a device except for load, indirect & instances.
+	if (bench) {
+		if (strcmp(bench, "animation") == 0)
+			return bench_animation(10000, 1000);
+		if (strcmp(bench, "load") == 0)
+			return bench_load(scenePath, 512);
+		if (strcmp(bench, "instances") == 0)
+			return bench_instances(scenePath ? scenePath : "assets/5t6.gltf", 1000);
+		if (strcmp(bench, "lights") == 0)
+			return bench_lights(MAX_LIGHTS, 1000);
+		if (strcmp(bench, "indirect") == 0)
+			return bench_indirect(20000, 200);
+
+		std::cerr << "Unknown benchmark: " << bench << '\n';
+		return 1;
+	}
+
+	// Replays step by the recorded timestep, headless by a fixed one.
+	InputRecorder inputRecorder;
+	InputReplay inputReplay;
+	double fixedStep = headless ? 1.0 / 60.0 : 0.0;
+
+	if (replayPath) {
+		if (!inputReplay.open(replayPath)) return 1;
+		fixedStep = inputReplay.step();
+	}
+
+	if (recordPath && !inputRecorder.open(recordPath, fixedStep > 0.0 ? fixedStep : 1.0 / 60.0))
+		return 1;
+
+	StatsStream statsStream;
+	if (statsPath && !statsStream.open(statsPath))
+		return 1;
+
+	if (frameCount == 0)
+		frameCount = (headless && !replayPath) ? 100 : SIZE_MAX;
+
+	// Print per-frame timings when the run is reproducible.
+	const bool timed = headless || replayPath;
+
+	if (!scenePath)
+		scenePath = "assets/5t6.gltf";
+
+	// Baking needs no device either.
+	if (bake) {
+		JobPool jobs;
+		GltfData gltf;
+		if (!gltf.load(scenePath, &jobs)) {
+			std::cerr << "Could not load scene: " << scenePath << '\n';
+			return 1;
+		}
+
+		const auto paths = bake_images(gltf, &jobs, true);
+		const size_t baked = (size_t)std::count_if(
+			paths.begin(), paths.end(), [](const std::string &p) { return !p.empty(); });
+
+		printf("baked %zu/%zu images of %s\n", baked, paths.size(), scenePath);
+		return baked == paths.size() ? 0 : 1;
+	}
+
 	dassert(gfx_init());
 
-	GFXWindow *window = gfx_create_window(
-		GFX_WINDOW_RESIZABLE | GFX_WINDOW_CAPTURE_MOUSE |
-		GFX_WINDOW_DOUBLE_BUFFER | GFX_WINDOW_FOCUS,
-		nullptr, nullptr, {600, 400, 0}, "fiezta");
-	dassert(window);
+	GFXWindow *window = nullptr;
+	if (!headless) {
+		window = gfx_create_window(
+			GFX_WINDOW_RESIZABLE | GFX_WINDOW_CAPTURE_MOUSE |
+			GFX_WINDOW_DOUBLE_BUFFER | GFX_WINDOW_FOCUS,
+			nullptr, nullptr, {width, height, 0}, "fiezta");
+		dassert(window);
+	}
 
 	Input input = {
 		.left = false,
@@ -293,24 +671,67 @@ int main() {
 		.back = false,
 		.up = false,
 		.down = false,
+		.overlay = showOverlay,
+		.events = 0,
 		.mouse = {vec2<double>(),vec2<double>()}
 	};
 
-	window->ptr = &input;
-	window->events.key.press = key_press;
-	window->events.key.release = key_release;
-	window->events.mouse.move = mouse_move;
+	if (window) {
+		window->ptr = &input;
+		window->events.key.press = key_press;
+		window->events.key.release = key_release;
+		window->events.mouse.move = mouse_move;
+		window->events.resize = window_resize;
+		window->events.focus = window_focus;
+	}
 
 	GFXHeap *heap = gfx_create_heap(nullptr);
 	dassert(heap);
 
-	GFXDependency *dep = gfx_create_dep(nullptr, NUM_VIRTUAL_FRAMES);
+	// Adaptive mode needs room for the most frames in flight.
+	const unsigned int numFrames = (frames == 0) ? MAX_VIRTUAL_FRAMES : frames;
+
+	GFXDependency *dep = gfx_create_dep(nullptr, numFrames);
 	dassert(dep);
 
-	GFXRenderer *renderer = gfx_create_renderer(heap, NUM_VIRTUAL_FRAMES);
+	GFXRenderer *renderer = gfx_create_renderer(heap, numFrames);
 	dassert(renderer);
 
-	dassert(gfx_renderer_attach_window(renderer, 0, window));
+	// Before any pipeline is built.
+	const bool cacheLoaded =
+		pipelineCache && load_pipeline_cache(renderer, pipelineCache);
+
+	if (window) {
+		dassert(gfx_renderer_attach_window(renderer, 0, window));
+	} else {
+		// Offscreen, readable for the final image.
+		dassert(gfx_renderer_attach(renderer, 0,
+			GFXAttachment{
+				.type = GFX_IMAGE_2D,
+				.flags = GFX_MEMORY_NONE,
+				.usage = GFX_IMAGE_READ,
+
+				.format = GFX_FORMAT_R8G8B8A8_UNORM,
+				.samples = 1,
+				.mipmaps = 1,
+				.layers = 1,
+
+				.size = GFX_SIZE_ABSOLUTE,
+				.width = width,
+				.height = height,
+				.depth = 1
+			}));
+	}
+
+	// The scene renders to the output, or to a scaled attachment.
+	std::unique_ptr<ResolutionScaler> scaler = {};
+	size_t sceneColor = 0;
+
+	if (resBudgetMs > 0.0) {
+		scaler = std::make_unique<ResolutionScaler>(resBudgetMs, resMin, resMax);
+		sceneColor = 2;
+		dassert(gfx_renderer_attach(renderer, 2, scaled_color(scaler->scale())));
+	}
 
 	dassert(gfx_renderer_attach(renderer, 1,
 		GFXAttachment{
@@ -324,13 +745,22 @@ int main() {
 			.layers = 1,
 
 			.size = GFX_SIZE_RELATIVE,
-			.ref = 0,
+			.ref = sceneColor,
 			.xScale = 1.0f,
 			.yScale = 1.0f,
 			.zScale = 1.0f
 		}));
 
-	GFXPass *pass = gfx_renderer_add_pass(renderer, GFX_PASS_RENDER, 0, 0, nullptr);
+	// Culling writes the draws of the render pass first.
+	GFXPass *cullPass = nullptr;
+	if (gpuDriven) {
+		cullPass = gfx_renderer_add_pass(
+			renderer, GFX_PASS_COMPUTE_INLINE, 0, 0, nullptr);
+		dassert(cullPass);
+	}
+
+	GFXPass *pass = gfx_renderer_add_pass(
+		renderer, GFX_PASS_RENDER, 0, cullPass ? 1 : 0, &cullPass);
 	dassert(pass);
 
 	GFXDepthState depth = {
@@ -343,15 +773,40 @@ int main() {
 	gfx_pass_set_state(pass, GFXRenderState{&raster, nullptr, &depth, nullptr});
 
 	dassert(gfx_pass_consume(
-		pass, 0, GFX_ACCESS_ATTACHMENT_WRITE, GFX_STAGE_ANY));
+		pass, sceneColor, GFX_ACCESS_ATTACHMENT_WRITE, GFX_STAGE_ANY));
 	gfx_pass_clear(
-		pass, 0, GFX_IMAGE_COLOR, {{0.0f, 0.0f, 0.0f, 0.0f}});
+		pass, sceneColor, GFX_IMAGE_COLOR, {{0.0f, 0.0f, 0.0f, 0.0f}});
 
 	dassert(gfx_pass_consume(
 		pass, 1, GFX_ACCESS_ATTACHMENT_TEST, GFX_STAGE_ANY));
 	gfx_pass_clear(
 		pass, 1, GFX_IMAGE_DEPTH, {.test={0.0f}});
 
+	// Upscales the scene to the output, covering all of it.
+	GFXPass *upscalePass = nullptr;
+	if (scaler) {
+		upscalePass = gfx_renderer_add_pass(
+			renderer, GFX_PASS_RENDER, 0, 1, &pass);
+		dassert(upscalePass);
+
+		dassert(gfx_pass_consume(
+			upscalePass, 0, GFX_ACCESS_ATTACHMENT_WRITE, GFX_STAGE_ANY));
+		dassert(gfx_pass_consume(
+			upscalePass, sceneColor, GFX_ACCESS_SAMPLED_READ, GFX_STAGE_FRAGMENT));
+	}
+
+	// Draws text over the final output, only if it can ever be shown.
+	GFXPass *overlayPass = nullptr;
+	if (window || showOverlay) {
+		GFXPass *last = upscalePass ? upscalePass : pass;
+		overlayPass = gfx_renderer_add_pass(
+			renderer, GFX_PASS_RENDER, 0, 1, &last);
+		dassert(overlayPass);
+
+		dassert(gfx_pass_consume(
+			overlayPass, 0, GFX_ACCESS_ATTACHMENT_WRITE, GFX_STAGE_ANY));
+	}
+
 	GFXRecorder *recorder = gfx_renderer_add_recorder(renderer);
 	dassert(recorder);
 
@@ -365,10 +820,96 @@ int main() {
 		renderer, sizeof(shaders)/sizeof(GFXShader*), shaders);
 	dassert(tech);
 	dassert(gfx_tech_dynamic(tech, 0, 0));
+	dassert(gfx_tech_dynamic(tech, 1, 0));
 	dassert(gfx_tech_lock(tech));
 
-	GFXSet *sets[NUM_VIRTUAL_FRAMES];
-	for (unsigned int f = 0; f < NUM_VIRTUAL_FRAMES; ++f) {
+	// Per view dynamic offset into the depth hierarchies.
+	GFXShader *cullShader = nullptr;
+	GFXTechnique *cullTech = nullptr;
+
+	if (gpuDriven) {
+		cullShader = load_shader(GFX_STAGE_COMPUTE, "assets/cull.comp");
+		cullTech = gfx_renderer_add_tech(renderer, 1, &cullShader);
+		dassert(cullTech);
+		dassert(gfx_tech_dynamic(cullTech, 0, 2));
+		dassert(gfx_tech_lock(cullTech));
+	}
+
+	// Samples the scaled scene, a single set as attachments are not per frame.
+	GFXShader *upscaleShaders[] = { nullptr, nullptr };
+	GFXRenderable upscaleRenderable = {};
+	GFXSet *upscaleSet = nullptr;
+
+	GFXRasterState upscaleRaster = {
+		GFX_RASTER_FILL,
+		GFX_FRONT_FACE_CCW, GFX_CULL_NONE,
+		GFX_TOPO_TRIANGLE_LIST, 1};
+	GFXRenderState upscaleState = { &upscaleRaster, nullptr, nullptr, nullptr };
+
+	if (upscalePass) {
+		upscaleShaders[0] = load_shader(GFX_STAGE_VERTEX, "assets/upscale.vert");
+		upscaleShaders[1] = load_shader(GFX_STAGE_FRAGMENT, "assets/upscale.frag");
+
+		GFXTechnique *upscaleTech = gfx_renderer_add_tech(renderer, 2, upscaleShaders);
+		dassert(upscaleTech);
+		dassert(gfx_tech_lock(upscaleTech));
+
+		const GFXSetResource res = {
+			.binding = 0, .index = 0, .ref = gfx_ref_attach(renderer, sceneColor) };
+
+		const GFXSampler sampler = {
+			.binding = 0,
+			.index = 0,
+			.flags = GFX_SAMPLER_NONE,
+			.mode = 0,
+			.minFilter = GFX_FILTER_LINEAR,
+			.magFilter = GFX_FILTER_LINEAR,
+			.mipFilter = GFX_FILTER_LINEAR,
+			.wrapU = GFX_WRAP_CLAMP_TO_EDGE,
+			.wrapV = GFX_WRAP_CLAMP_TO_EDGE,
+			.wrapW = GFX_WRAP_CLAMP_TO_EDGE,
+			.mipLodBias = 0.0f,
+			.minLod = 0.0f,
+			.maxLod = 0.0f,
+			.maxAnisotropy = 1.0f,
+			.cmp = {}
+		};
+
+		upscaleSet = gfx_renderer_add_set(
+			renderer, upscaleTech, 0,
+			1, 0, 0, 1,
+			&res, nullptr, nullptr, &sampler);
+		dassert(upscaleSet);
+
+		// No primitive, the vertex shader makes up the triangle.
+		dassert(gfx_renderable(
+			&upscaleRenderable, upscalePass, upscaleTech, nullptr, &upscaleState));
+	}
+
+	// Statistics of the last frame, set 0.
+	GFXShader *overlayShaders[] = { nullptr, nullptr };
+	std::unique_ptr<StatsOverlay> statsOverlay = {};
+
+	if (overlayPass) {
+		overlayShaders[0] = load_shader(GFX_STAGE_VERTEX, "assets/overlay.vert");
+		overlayShaders[1] = load_shader(GFX_STAGE_FRAGMENT, "assets/overlay.frag");
+
+		GFXTechnique *overlayTech = gfx_renderer_add_tech(renderer, 2, overlayShaders);
+		dassert(overlayTech);
+		dassert(gfx_tech_lock(overlayTech));
+
+		statsOverlay = std::make_unique<StatsOverlay>(
+			renderer, heap, overlayPass, overlayTech);
+	}
+
+	// Base color textures, set 2, the budget defaults to 256 MiB.
+	const uint64_t textureBudget = mem_get_usage(MEM_TEXTURES).budget;
+	auto textures = std::make_unique<TextureStreamer>(
+		renderer, heap, dep, tech, 2,
+		textureBudget > 0 ? textureBudget : (uint64_t)256 << 20);
+
+	std::vector<GFXSet*> sets(numFrames);
+	for (unsigned int f = 0; f < numFrames; ++f) {
 		sets[f] = gfx_renderer_add_set(
 			renderer, tech, 0,
 			0, 0, 0, 0,
@@ -376,111 +917,491 @@ int main() {
 		dassert(sets[f]);
 	}
 
+	// Binned lights, an element per view.
+	auto lightData = std::make_unique<FrameData>(
+		heap, numFrames, (uint32_t)numViews, (uint32_t)LightClusters::bufferSize(),
+		GFX_MEMORY_NONE, GFX_BUFFER_STORAGE);
+
+	std::vector<GFXSet*> lightSets(numFrames);
+	for (unsigned int f = 0; f < numFrames; ++f) {
+		GFXSetGroup group = lightData->getAsGroup(f, 0);
+		lightSets[f] = gfx_renderer_add_set(
+			renderer, tech, 1,
+			0, 1, 0, 0,
+			nullptr, &group, nullptr, nullptr);
+		dassert(lightSets[f]);
+	}
+
 	// Load glTF & setup data.
+	JobPool jobs;
+	Animator animator(&jobs);
+	auto geometry = std::make_unique<GeometryArena>(
+		heap, dep, gfx_renderer_get_num_frames(renderer));
+	AssetCache assets(heap, geometry.get(), &jobs, textures.get());
+	assets.staticAll = staticAll;
+
+	std::shared_ptr<GltfAsset> scene = assets.load(scenePath);
+	if (!scene) {
+		std::cerr << "Could not load scene: " << scenePath << '\n';
+		return 1;
+	}
+
 	std::unique_ptr<GraphNode> graph =
-		load_gltf(heap, dep, tech, pass, sets, "assets/5t6.gltf");
+		scene->instantiate(tech, pass, sets, &animator);
+
+	// The scene holds on to everything it uses, forget the rest.
+	assets.purge();
+
+	if (printStats || timed)
+		print_geometry(geometry->stats());
+
+	if (printStats) {
+		const GltfAsset::BatchStats &batchStats = scene->batchStats();
+		printf(
+			"batching: %zu static nodes, %zu primitives into %zu batches, "
+			"%llu vertices, %llu KiB\n",
+			batchStats.nodes, batchStats.primitives, batchStats.batches,
+			(unsigned long long)batchStats.vertices,
+			(unsigned long long)(batchStats.bytes / 1024));
+	}
+
+	for (size_t a = 0; a < animator.numAnimations(); ++a)
+		animator.play(a);
 
 	dassert(gfx_heap_flush(heap));
 
+	// Compile everything the scene draws before the first frame.
+	if (warmup) {
+		const auto warmStart = std::chrono::steady_clock::now();
+		size_t numPipelines = warmup_pipelines(graph.get(), &jobs);
+		if (upscalePass && gfx_renderable_warmup(&upscaleRenderable))
+			++numPipelines;
+		if (statsOverlay && gfx_renderable_warmup(statsOverlay->renderable()))
+			++numPipelines;
+
+		if (printStats || timed)
+			printf("warmup: %zu pipelines in %.3f ms, %s pipeline cache\n",
+				numPipelines,
+				std::chrono::duration<double, std::milli>(
+					std::chrono::steady_clock::now() - warmStart).count(),
+				cacheLoaded ? "with" : "without");
+	}
+
+	// Per object uniforms & all of them as storage for indirect draws,
+	// which is also bound (but not uploaded to) when not GPU-driven.
 	std::unique_ptr<FrameData> data = {};
+	std::unique_ptr<FrameData> transformData = {};
 	const size_t dataCount = graph->writes();
 
 	if (dataCount > 0) {
 		data = std::make_unique<FrameData>(
-			heap, NUM_VIRTUAL_FRAMES, dataCount, sizeof(float) * 16,
+			heap, numFrames, dataCount, sizeof(float) * 12,
 			GFX_MEMORY_NONE, GFX_BUFFER_UNIFORM);
-
-		for (unsigned int f = 0; f < NUM_VIRTUAL_FRAMES; ++f) {
-			GFXSetGroup group = data->getAsGroup(f, 0);
-			dassert(gfx_set_groups(sets[f], 1, &group));
+		transformData = std::make_unique<FrameData>(
+			heap, numFrames, 1, (uint32_t)data->frameSize(),
+			GFX_MEMORY_NONE, GFX_BUFFER_STORAGE);
+
+		for (unsigned int f = 0; f < numFrames; ++f) {
+			GFXSetGroup groups[] = {
+				data->getAsGroup(f, 0),
+				transformData->getAsGroup(f, 1)
+			};
+			dassert(gfx_set_groups(sets[f], 2, groups));
 		}
 	}
 
-	// Main loop.
-	Context ctx = {
-		.tech = tech,
+	// Setup culling.
+	OcclusionCuller culler(&jobs);
+	culler.enabled = occlusion;
+	culler.gather(graph.get());
+
+	// Shared ranges are culled & drawn on the GPU, the rest as usual.
+	std::unique_ptr<FrameData> depthData = {};
+	std::unique_ptr<IndirectDraws> indirect = {};
+
+	if (gpuDriven && data) {
+		depthData = std::make_unique<FrameData>(
+			heap, numFrames, (uint32_t)numViews, (uint32_t)culler.hierarchySize(),
+			GFX_MEMORY_NONE, GFX_BUFFER_STORAGE);
+
+		indirect = std::make_unique<IndirectDraws>(renderer, heap, cullTech, numViews);
+		dassert(indirect->build(
+			graph.get(), pass,
+			data.get(), transformData.get(), depthData.get(), &jobs));
+
+		if (printStats || timed)
+			printf("gpu-driven: %zu objects in %zu multi-draws per view\n",
+				indirect->stats().objects, indirect->stats().groups);
+	}
+
+	LightClusters lights(&jobs);
+	lights.gather(graph.get());
+
+	// Start simulating, one frame ahead of rendering.
+	SharedInput shared = { .keys = input };
+	std::atomic<uint64_t> size = { (uint64_t)width << 32 | height };
+
+	Simulation sim = {
 		.graph = graph.get(),
+		.data = data.get(),
+		.animator = &animator,
+		.culler = &culler,
+		.lights = &lights,
+		.lightData = lightData.get(),
+		.depthData = depthData.get(),
+		.pass = pass,
+		.input = &shared,
+		.recorder = recordPath ? &inputRecorder : nullptr,
+		.replay = replayPath ? &inputReplay : nullptr,
+		.size = &size,
+		.fixedStep = fixedStep,
+		.numViews = numViews,
+		.noAlloc = noAlloc,
 		.cam = {vec3<float>(0.0f, 0.0f, 2.0f), 0.0f, 0.0f}
 	};
 
 	gfx_poll_events(); // Init mouse pos.
 
-	while (!gfx_window_should_close(window)) {
-		GFXFrame *frame = gfx_renderer_acquire(renderer);
-		gfx_frame_start(frame);
+	SnapshotRing ring(2);
+	std::thread simThread(simulate, &sim, &ring);
+
+	// Main loop, renders the latest snapshot.
+	Context ctx = {
+		.tech = tech,
+		.lightSets = lightSets.data(),
+		.textures = textures.get(),
+		.indirect = indirect.get(),
+		.upscale = upscalePass ? &upscaleRenderable : nullptr,
+		.upscaleSet = upscaleSet,
+		.overlay = statsOverlay.get(),
+		.snap = nullptr,
+		.size = &size,
+		.recordMs = 0.0,
+		.counters = {}
+	};
+
+	FramePacer pacer(renderer, frames);
+	FrameStats frameStats;
+
+	std::unique_ptr<FrameLimiter> limiter = {};
+	if (fpsLimit > 0.0)
+		limiter = std::make_unique<FrameLimiter>(fpsLimit);
+
+	// Without a window there are no events to wake up for.
+	const bool idling = onDemand && window;
+	size_t skippedFrames = 0;
+	uint32_t seenEvents = input.events;
+
+	// Every virtual frame has its own data to catch up on after a change,
+	// input only shows up in snapshots after the ones already taken.
+	const size_t inputRedraws = numFrames + ring.numSlots();
+	size_t redraws = inputRedraws;
+
+	const auto runStart = std::chrono::steady_clock::now();
+	double firstFrameMs = 0.0, startupWorstMs = 0.0;
+	auto lastStats = std::chrono::steady_clock::now();
+
+	size_t frameIndex = 0;
+	double lastGpuMs = 0.0; // Of the last frame the GPU finished.
+	double cpuTotalMs = 0.0, gpuTotalMs = 0.0;
+	double sharedTotalMs = 0.0, viewTotalMs = 0.0, recordTotalMs = 0.0;
+
+	while (frameIndex < frameCount && !(window && gfx_window_should_close(window))) {
+		// Nothing changed for a while, sleep on events instead of the limiter.
+		const bool idle = idling && redraws == 0;
+		if (idle && limiter)
+			limiter->reset();
+		else if (limiter)
+			limiter->wait();
+
+		NoAllocRegion region(noAlloc && frameIndex >= ALLOC_WARMUP_FRAMES);
 
 		// Update input.
 		input.mouse[1] = input.mouse[0];
-		gfx_poll_events();
+		if (idle) gfx_wait_events();
+		else if (window) gfx_poll_events();
 
-		// Move camera.
-		const float pi2 = 6.28318530718f;
-		const float pi4 = pi2 / 4.0f - 0.01f;
+		const auto frameStart = std::chrono::steady_clock::now();
+		AllocScope allocs;
 
-		const vec2<double> mouseVel = input.mouse[0] - input.mouse[1];
-		ctx.cam.yaw += -(mouseVel[0] / 60);
-		ctx.cam.pitch = GFX_CLAMP(ctx.cam.pitch - (mouseVel[1] / 60), -pi4, pi4);
+		{
+			std::lock_guard<std::mutex> guard(shared.lock);
+			shared.keys = input;
+			shared.mouseVel += input.mouse[0] - input.mouse[1];
+		}
 
-		const float cosPitch = cosf(ctx.cam.pitch);
-		const float sinPitch = sinf(ctx.cam.pitch);
+		const SceneSnapshot *snap = ring.acquireRead();
+		if (!snap) break;
 
-		const auto camPitch = mat4<float>(
-			1.0f, 0.0f,      0.0f,     0.0f,
-			0.0f, cosPitch, -sinPitch, 0.0f,
-			0.0f, sinPitch,  cosPitch, 0.0f,
-			0.0f, 0.0f,      0.0f,     1.0f);
+		if (input.events != seenEvents)
+			redraws = inputRedraws;
+		else if (snap->changed)
+			redraws = GFX_MAX(redraws, (size_t)numFrames);
 
-		const float cosYaw = cosf(ctx.cam.yaw);
-		const float sinYaw = sinf(ctx.cam.yaw);
+		seenEvents = input.events;
 
-		const auto camYaw = mat4<float>(
-			 cosYaw, 0.0f, sinYaw, 0.0f,
-			 0.0f,   1.0f, 0.0f,   0.0f,
-			-sinYaw, 0.0f, cosYaw, 0.0f,
-			 0.0f,   0.0f, 0.0f,   1.0f);
+		// Renders the same as before, let the simulation catch up.
+		if (idling && redraws == 0) {
+			++skippedFrames;
+			ring.release();
 
-		const vec3<float> forward =
-			camYaw * camPitch * vec3<float>(0.0f, 0.0f, -1.0f);
-		const vec3<float> right =
-			forward.cross(vec3<float>(0.0f, 1.0f, 0.0f)).normalize();
+			if (mem_dump_requested())
+				mem_dump_json(stdout);
 
-		const double moveSpeed = 0.01;
-		if (input.left)
-			ctx.cam.pos -= right * moveSpeed;
-		if (input.right)
-			ctx.cam.pos += right * moveSpeed;
-		if (input.forward)
-			ctx.cam.pos += forward * moveSpeed;
-		if (input.back)
-			ctx.cam.pos -= forward * moveSpeed;
-		if (input.up)
-			ctx.cam.pos[1] += moveSpeed;
-		if (input.down)
-			ctx.cam.pos[1] -= moveSpeed;
-
-		// Update data.
-		if (data) {
-			data->setOutput(gfx_frame_get_index(frame));
-			graph->update();
-			graph->write(data.get());
+			continue;
 		}
 
+		GFXFrame *frame = pacer.acquire();
+		gfx_frame_start(frame);
+
+		// Continue the snapshot's counters.
+		ctx.counters = snap->counters;
+
+		if (data)
+			ctx.counters.uploadBytes +=
+				data->upload(gfx_frame_get_index(frame), snap->transforms.data());
+
+		ctx.counters.uploadBytes +=
+			lightData->upload(gfx_frame_get_index(frame), snap->lights.data());
+		textures->update(snap->textures, gfx_frame_get_index(frame));
+
+		// Levels streamed in & out show up, more might follow.
+		if (textures->stats().streamed > 0)
+			redraws = GFX_MAX(redraws, (size_t)numFrames);
+
 		// Record frame.
-		gfx_pass_inject(pass, 1, ref(gfx_dep_wait(dep)));
+		ctx.snap = snap;
+
+		if (indirect) {
+			ctx.counters.uploadBytes +=
+				transformData->upload(gfx_frame_get_index(frame), snap->transforms.data());
+			ctx.counters.uploadBytes +=
+				depthData->upload(gfx_frame_get_index(frame), snap->depth.data());
+
+			gfx_pass_inject(cullPass, 1, ref(indirect->signal()));
+			gfx_recorder_compute(recorder, cullPass, cull, &ctx);
+
+			const GFXInject waits[] = { gfx_dep_wait(dep), indirect->wait() };
+			gfx_pass_inject(pass, 2, waits);
+		}
+		else
+			gfx_pass_inject(pass, 1, ref(gfx_dep_wait(dep)));
+
 		gfx_recorder_render(recorder, pass, render, &ctx);
 
-		gfx_frame_submit(frame);
+		if (upscalePass)
+			gfx_recorder_render(recorder, upscalePass, upscale, &ctx);
+
+		if (statsOverlay && input.overlay)
+			gfx_recorder_render(recorder, overlayPass, overlay, &ctx);
+
+		pacer.submit(frame);
+		geometry->update();
+		// Recording, uploading & submitting, on top of the snapshot's.
+		ctx.counters.allocs += allocs.count();
+
+		const auto frameEnd = std::chrono::steady_clock::now();
+		const double frameMs =
+			std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+
+		frameStats.addFrame(frameMs, ctx.recordMs, ctx.counters);
+		if (scaler) scaler->addCpu(frameMs - pacer.waitMs());
+
+		// Hitches from building pipelines show up early on.
+		if (frameIndex == 0) firstFrameMs = frameMs;
+		if (frameEnd - runStart < std::chrono::seconds(10))
+			startupWorstMs = GFX_MAX(startupWorstMs, frameMs);
+
+		// GPU times of earlier frames, as noticed by the pacer,
+		// unless timed below by waiting for every frame.
+		FramePacer::Completion done;
+		while (pacer.poll(done))
+			if (!timed) {
+				lastGpuMs = done.gpuMs;
+				frameStats.addGpu(done.gpuMs, done.exact);
+				if (scaler) scaler->addGpu(done.gpuMs, done.exact);
+			}
+
+		// Wait for the GPU so its time is measurable in isolation,
+		// includes submission latency, which is negligible offscreen.
+		if (timed) {
+			const auto cpuEnd = std::chrono::steady_clock::now();
+			gfx_frame_block(frame);
+			const auto gpuEnd = std::chrono::steady_clock::now();
+
+			const double cpuMs =
+				std::chrono::duration<double, std::milli>(cpuEnd - frameStart).count();
+			const double gpuMs =
+				std::chrono::duration<double, std::milli>(gpuEnd - cpuEnd).count();
+
+			const TextureStreamer::Stats &texStats = textures->stats();
+			printf(
+				"frame %zu: cpu %.3f ms, gpu %.3f ms, %zu draws, %zu binds, %llu allocs, "
+				"textures %llu KiB resident, %llu KiB read\n",
+				frameIndex, cpuMs, gpuMs, ctx.counters.draws, ctx.counters.binds,
+				(unsigned long long)ctx.counters.allocs,
+				(unsigned long long)(texStats.residentBytes / 1024),
+				(unsigned long long)(texStats.readBytes / 1024));
+			cpuTotalMs += cpuMs;
+			gpuTotalMs += gpuMs;
+			lastGpuMs = gpuMs;
+			frameStats.addGpu(gpuMs, true);
+			if (scaler) scaler->addGpu(gpuMs, true);
+
+			sharedTotalMs += snap->sharedMs;
+			recordTotalMs += ctx.recordMs;
+			for (const SnapshotView &view : snap->views)
+				viewTotalMs += view.prepareMs;
+		}
+
+		// All counters are final, the overlay shows them next frame.
+		statsStream.addGpu(lastGpuMs);
+		statsStream.write(frameIndex, frameMs, ctx.recordMs, ctx.counters);
+
+		if (statsOverlay && input.overlay)
+			print_overlay(
+				statsOverlay.get(), frameIndex, frameMs, ctx.recordMs, lastGpuMs,
+				scaler ? scaler->scale() : 1.0f, ctx.counters);
+
+		// Takes effect when the renderer next rebuilds, before the next frame.
+		if (scaler && scaler->update()) {
+			dassert(gfx_renderer_attach(renderer, sceneColor, scaled_color(scaler->scale())));
+			redraws = GFX_MAX(redraws, (size_t)numFrames);
+		}
+
+		if (redraws > 0) --redraws;
+		++frameIndex;
+
+		if (mem_dump_requested())
+			mem_dump_json(stdout);
+
+		// Report once per second.
+		const auto now = std::chrono::steady_clock::now();
+		if (printStats && now - lastStats >= std::chrono::seconds(1)) {
+			frameStats.print(stdout);
+
+			if (scaler)
+				printf("resolution: scale %.2f, %zu changes\n",
+					scaler->scale(), scaler->changes());
+
+			const OcclusionCuller::Stats &stats = snap->views[0].cull;
+			printf(
+				"occlusion: %zu occluders, %zu tris, raster %.3f ms, "
+				"test %.3f ms, culled %zu/%zu (%.1f%%)\n",
+				stats.occluders, stats.occluderTris, stats.rasterMs,
+				stats.testMs, stats.culled, stats.candidates, stats.culledPercent());
+
+			const LightClusters::Stats &lightStats = snap->views[0].lighting;
+			printf(
+				"lights: %zu total, %zu binned, %zu indices%s, bin %.3f ms\n",
+				lightStats.lights, lightStats.binned, lightStats.indices,
+				lightStats.overflow ? " (overflow)" : "", lightStats.binMs);
+
+			const TextureStreamer::Stats &texStats = textures->stats();
+			printf(
+				"textures: %zu textures, %llu/%llu KiB resident, "
+				"%zu levels streamed, %zu evicted, %llu KiB read, %llu KiB uploaded\n",
+				texStats.textures,
+				(unsigned long long)(texStats.residentBytes / 1024),
+				(unsigned long long)(texStats.budget / 1024),
+				texStats.streamed, texStats.evicted,
+				(unsigned long long)(texStats.readBytes / 1024),
+				(unsigned long long)(texStats.uploadBytes / 1024));
+
+			const AssetCache::Stats assetStats = assets.stats();
+			printf(
+				"assets: %zu loads, %.1f%% hits, %zu resident, %llu KiB\n",
+				assetStats.loads, assetStats.hitRate() * 100.0, assetStats.resident,
+				(unsigned long long)(assetStats.residentBytes / 1024));
+
+			print_geometry(geometry->stats());
+
+			lastStats = now;
+		}
+
+		ring.release();
+	}
+
+	ring.close();
+	simThread.join();
+
+	// Counted on both threads.
+	const uint64_t steadyAllocs = heap_region_allocs();
+	if (noAlloc) {
+		const size_t steadyFrames =
+			frameIndex > ALLOC_WARMUP_FRAMES ? frameIndex - ALLOC_WARMUP_FRAMES : 0;
+
+		printf("allocations: %llu in %zu steady-state frames\n",
+			(unsigned long long)steadyAllocs, steadyFrames);
+	}
+
+	if (printStats && idling)
+		printf("on-demand: %zu frames drawn, %zu skipped\n", frameIndex, skippedFrames);
+
+	if ((printStats || timed) && frameIndex > 0)
+		printf("startup: first frame %.3f ms, worst in the first 10 s %.3f ms\n",
+			firstFrameMs, startupWorstMs);
+
+	if (timed && frameIndex > 0) {
+		printf(
+			"%zu frames: cpu %.3f ms avg, gpu %.3f ms avg\n",
+			frameIndex, cpuTotalMs / frameIndex, gpuTotalMs / frameIndex);
+
+		// Compare runs with a different --views for the GPU's share.
+		const double perView = (double)(frameIndex * numViews);
+		printf(
+			"%zu views: shared %.3f ms, per view: cull & collect %.3f ms, record %.3f ms\n",
+			numViews, sharedTotalMs / frameIndex,
+			viewTotalMs / perView, recordTotalMs / perView);
+
+		frameStats.print(stdout);
+	}
+
+	if (headless && outputPath && frameIndex > 0) {
+		std::vector<uint8_t> pixels;
+		gfx_renderer_block(renderer);
+
+		if (
+			!read_attachment(renderer, 0, width, height, pixels) ||
+			!write_ppm(outputPath, width, height, pixels.data()))
+		{
+			std::cerr << "Could not save image to " << outputPath << '\n';
+		}
 	}
 
-	// Cleanup.
+	// Cleanup, keep the pipelines for the next start.
+	gfx_renderer_block(renderer);
+
+	if (pipelineCache && !store_pipeline_cache(renderer, pipelineCache))
+		std::cerr << "Could not store pipeline cache: " << pipelineCache << '\n';
+
+	indirect.reset();
 	gfx_destroy_renderer(renderer);
+	statsOverlay.reset();
 	data.reset();
+	transformData.reset();
+	depthData.reset();
+	lightData.reset();
+	graph.reset();
+	scene.reset();
+	textures.reset();
+	geometry.reset();
 	gfx_destroy_heap(heap);
 	gfx_destroy_dep(dep);
-	gfx_destroy_window(window);
+	if (window) gfx_destroy_window(window);
 
 	for (size_t s = 0; s < sizeof(shaders)/sizeof(GFXShader*); ++s)
 		gfx_destroy_shader(shaders[s]);
 
+	if (cullShader) gfx_destroy_shader(cullShader);
+
+	for (GFXShader *shader : upscaleShaders)
+		if (shader) gfx_destroy_shader(shader);
+
+	for (GFXShader *shader : overlayShaders)
+		if (shader) gfx_destroy_shader(shader);
+
 	gfx_terminate();
+
+	return (noAlloc && steadyAllocs > 0) ? 1 : 0;
 }
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <limits>
+#include "affine.h"
+#include "mat.h"
+#include "vec.h"
+
+template <typename T>
+struct aabb {
+	vec3<T> min;
+	vec3<T> max;
+
+	// Empty (inverted) box.
+	aabb() :
+		min(
+			std::numeric_limits<T>::max(),
+			std::numeric_limits<T>::max(),
+			std::numeric_limits<T>::max()),
+		max(
+			std::numeric_limits<T>::lowest(),
+			std::numeric_limits<T>::lowest(),
+			std::numeric_limits<T>::lowest()) {}
+
+	aabb(const vec3<T> &min, const vec3<T> &max) : min(min), max(max) {}
+
+	bool empty() const {
+		return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+	}
+
+	vec3<T> corner(size_t i) const {
+		return vec3<T>(
+			(i & 1) ? max[0] : min[0],
+			(i & 2) ? max[1] : min[1],
+			(i & 4) ? max[2] : min[2]);
+	}
+
+	vec3<T> size() const {
+		return empty() ? vec3<T>() : max - min;
+	}
+
+	void extend(const vec3<T> &point) {
+		for (size_t i = 0; i < 3; ++i) {
+			if (point[i] < min[i]) min[i] = point[i];
+			if (point[i] > max[i]) max[i] = point[i];
+		}
+	}
+
+	void extend(const aabb &box) {
+		if (!box.empty()) {
+			extend(box.min);
+			extend(box.max);
+		}
+	}
+
+	// Bounds of this box after an affine transform.
+	template <typename M>
+	aabb transform(const M &mat) const {
+		aabb out;
+		if (!empty())
+			for (size_t c = 0; c < 8; ++c)
+				out.extend(mat * corner(c));
+
+		return out;
+	}
+};
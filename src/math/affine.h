@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string.h>
+#include "mat.h"
+#include "vec.h"
+
+// Row-major 3x4 matrix with an implicit last row of [0 0 0 1].
+template <typename T>
+struct affine3x4 {
+	T data[12];
+
+	affine3x4() : data{
+		T(1), T(0), T(0), T(0),
+		T(0), T(1), T(0), T(0),
+		T(0), T(0), T(1), T(0)} {}
+
+	affine3x4(
+		T m00, T m01, T m02, T m03,
+		T m10, T m11, T m12, T m13,
+		T m20, T m21, T m22, T m23
+	) : data{
+		m00, m01, m02, m03,
+		m10, m11, m12, m13,
+		m20, m21, m22, m23} {}
+
+	affine3x4(const affine3x4 &mat) : affine3x4(mat.data) {}
+
+	// Drops the last row.
+	explicit affine3x4(const mat4<T> &mat) : affine3x4(mat.data) {}
+
+	affine3x4(const T *mat) {
+		memcpy(data, mat, sizeof(data));
+	}
+
+	const T *operator[](size_t i) const {
+		return &data[i * 4];
+	}
+
+	T *operator[](size_t i) {
+		return &data[i * 4];
+	}
+
+	mat4<T> toMat4() const {
+		const affine3x4 &m = *this;
+
+		return mat4<T>(
+			m[0][0], m[0][1], m[0][2], m[0][3],
+			m[1][0], m[1][1], m[1][2], m[1][3],
+			m[2][0], m[2][1], m[2][2], m[2][3],
+			T(0),    T(0),    T(0),    T(1));
+	}
+
+	vec3<T> translation() const {
+		return vec3<T>(data[3], data[7], data[11]);
+	}
+
+	vec3<T> operator*(const vec3<T> &vec) const {
+		const affine3x4 &m = *this;
+
+		return vec3<T>(
+			vec[0] * m[0][0] + vec[1] * m[0][1] + vec[2] * m[0][2] + m[0][3],
+			vec[0] * m[1][0] + vec[1] * m[1][1] + vec[2] * m[1][2] + m[1][3],
+			vec[0] * m[2][0] + vec[1] * m[2][1] + vec[2] * m[2][2] + m[2][3]);
+	}
+
+	// Ignores translation.
+	vec3<T> rotate(const vec3<T> &vec) const {
+		const affine3x4 &m = *this;
+
+		return vec3<T>(
+			vec[0] * m[0][0] + vec[1] * m[0][1] + vec[2] * m[0][2],
+			vec[0] * m[1][0] + vec[1] * m[1][1] + vec[2] * m[1][2],
+			vec[0] * m[2][0] + vec[1] * m[2][1] + vec[2] * m[2][2]);
+	}
+
+	// From translation, unit quaternion (xyzw) & scale.
+	static affine3x4 trs(const T *t, const T *r, const T *s) {
+		const T x = r[0], y = r[1], z = r[2], w = r[3];
+
+		return affine3x4(
+			(T(1) - T(2) * (y * y + z * z)) * s[0],
+			(T(2) * (x * y - z * w)) * s[1],
+			(T(2) * (x * z + y * w)) * s[2],
+			t[0],
+
+			(T(2) * (x * y + z * w)) * s[0],
+			(T(1) - T(2) * (x * x + z * z)) * s[1],
+			(T(2) * (y * z - x * w)) * s[2],
+			t[1],
+
+			(T(2) * (x * z - y * w)) * s[0],
+			(T(2) * (y * z + x * w)) * s[1],
+			(T(1) - T(2) * (x * x + y * y)) * s[2],
+			t[2]);
+	}
+
+	affine3x4 &operator=(const affine3x4 &mat) {
+		memcpy(data, mat.data, sizeof(data));
+		return *this;
+	}
+
+	// 36 multiplies & 27 adds, versus 64 & 48 for a full mat4.
+	affine3x4 operator*(const affine3x4 &mat) const {
+		const affine3x4 &m = *this;
+
+		return affine3x4(
+			m[0][0] * mat[0][0] + m[0][1] * mat[1][0] + m[0][2] * mat[2][0],
+			m[0][0] * mat[0][1] + m[0][1] * mat[1][1] + m[0][2] * mat[2][1],
+			m[0][0] * mat[0][2] + m[0][1] * mat[1][2] + m[0][2] * mat[2][2],
+			m[0][0] * mat[0][3] + m[0][1] * mat[1][3] + m[0][2] * mat[2][3] + m[0][3],
+
+			m[1][0] * mat[0][0] + m[1][1] * mat[1][0] + m[1][2] * mat[2][0],
+			m[1][0] * mat[0][1] + m[1][1] * mat[1][1] + m[1][2] * mat[2][1],
+			m[1][0] * mat[0][2] + m[1][1] * mat[1][2] + m[1][2] * mat[2][2],
+			m[1][0] * mat[0][3] + m[1][1] * mat[1][3] + m[1][2] * mat[2][3] + m[1][3],
+
+			m[2][0] * mat[0][0] + m[2][1] * mat[1][0] + m[2][2] * mat[2][0],
+			m[2][0] * mat[0][1] + m[2][1] * mat[1][1] + m[2][2] * mat[2][1],
+			m[2][0] * mat[0][2] + m[2][1] * mat[1][2] + m[2][2] * mat[2][2],
+			m[2][0] * mat[0][3] + m[2][1] * mat[1][3] + m[2][2] * mat[2][3] + m[2][3]);
+	}
+
+	affine3x4 &operator*=(const affine3x4 &mat) {
+		*this = *this * mat;
+		return *this;
+	}
+
+	// Full projective matrix times affine, skips the implicit last row.
+	friend mat4<T> operator*(const mat4<T> &m, const affine3x4 &mat) {
+		return mat4<T>(
+			m[0][0] * mat[0][0] + m[0][1] * mat[1][0] + m[0][2] * mat[2][0],
+			m[0][0] * mat[0][1] + m[0][1] * mat[1][1] + m[0][2] * mat[2][1],
+			m[0][0] * mat[0][2] + m[0][1] * mat[1][2] + m[0][2] * mat[2][2],
+			m[0][0] * mat[0][3] + m[0][1] * mat[1][3] + m[0][2] * mat[2][3] + m[0][3],
+
+			m[1][0] * mat[0][0] + m[1][1] * mat[1][0] + m[1][2] * mat[2][0],
+			m[1][0] * mat[0][1] + m[1][1] * mat[1][1] + m[1][2] * mat[2][1],
+			m[1][0] * mat[0][2] + m[1][1] * mat[1][2] + m[1][2] * mat[2][2],
+			m[1][0] * mat[0][3] + m[1][1] * mat[1][3] + m[1][2] * mat[2][3] + m[1][3],
+
+			m[2][0] * mat[0][0] + m[2][1] * mat[1][0] + m[2][2] * mat[2][0],
+			m[2][0] * mat[0][1] + m[2][1] * mat[1][1] + m[2][2] * mat[2][1],
+			m[2][0] * mat[0][2] + m[2][1] * mat[1][2] + m[2][2] * mat[2][2],
+			m[2][0] * mat[0][3] + m[2][1] * mat[1][3] + m[2][2] * mat[2][3] + m[2][3],
+
+			m[3][0] * mat[0][0] + m[3][1] * mat[1][0] + m[3][2] * mat[2][0],
+			m[3][0] * mat[0][1] + m[3][1] * mat[1][1] + m[3][2] * mat[2][1],
+			m[3][0] * mat[0][2] + m[3][1] * mat[1][2] + m[3][2] * mat[2][2],
+			m[3][0] * mat[0][3] + m[3][1] * mat[1][3] + m[3][2] * mat[2][3] + m[3][3]);
+	}
+
+	// Inverse of the 3x3 part, translation is then a rotated negation.
+	affine3x4 inverse() const {
+		const affine3x4 &m = *this;
+
+		const T c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+		const T c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+		const T c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+
+		const T det = T(1) / (m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02);
+
+		const T i00 = det * c00;
+		const T i01 = det * (m[0][2] * m[2][1] - m[0][1] * m[2][2]);
+		const T i02 = det * (m[0][1] * m[1][2] - m[0][2] * m[1][1]);
+		const T i10 = det * c01;
+		const T i11 = det * (m[0][0] * m[2][2] - m[0][2] * m[2][0]);
+		const T i12 = det * (m[0][2] * m[1][0] - m[0][0] * m[1][2]);
+		const T i20 = det * c02;
+		const T i21 = det * (m[0][1] * m[2][0] - m[0][0] * m[2][1]);
+		const T i22 = det * (m[0][0] * m[1][1] - m[0][1] * m[1][0]);
+
+		return affine3x4(
+			i00, i01, i02, -(i00 * m[0][3] + i01 * m[1][3] + i02 * m[2][3]),
+			i10, i11, i12, -(i10 * m[0][3] + i11 * m[1][3] + i12 * m[2][3]),
+			i20, i21, i22, -(i20 * m[0][3] + i21 * m[1][3] + i22 * m[2][3]));
+	}
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <array>
+#include <math.h>
+#include <stdint.h>
+#include <tuple>
+#include <utility>
+#include "affine.h"
+#include "mat.h"
+#include "vec.h"
+
+// 4x4 matrices with a zero & one pattern known at compile time.
+// Bit (row * 4 + col) of NonZero is set if an element may be non-zero,
+// the same bit of One is set if it is always exactly one.
+// Products only evaluate terms that may be non-zero, and chains of
+// products are evaluated in the cheapest order; all at compile time.
+
+constexpr uint16_t smat_bit(size_t r, size_t c) {
+	return (uint16_t)(1u << (r * 4 + c));
+}
+
+constexpr uint16_t smat_product_nz(uint16_t a, uint16_t b) {
+	uint16_t out = 0;
+	for (size_t r = 0; r < 4; ++r)
+		for (size_t c = 0; c < 4; ++c)
+			for (size_t k = 0; k < 4; ++k)
+				if ((a & smat_bit(r, k)) && (b & smat_bit(k, c)))
+					out |= smat_bit(r, c);
+
+	return out;
+}
+
+// An element of a product is one if its only term is one times one.
+constexpr uint16_t smat_product_one(uint16_t an, uint16_t ao, uint16_t bn, uint16_t bo) {
+	uint16_t out = 0;
+	for (size_t r = 0; r < 4; ++r)
+		for (size_t c = 0; c < 4; ++c) {
+			size_t terms = 0;
+			bool one = false;
+
+			for (size_t k = 0; k < 4; ++k)
+				if ((an & smat_bit(r, k)) && (bn & smat_bit(k, c))) {
+					++terms;
+					one = (ao & smat_bit(r, k)) && (bo & smat_bit(k, c));
+				}
+
+			if (terms == 1 && one)
+				out |= smat_bit(r, c);
+		}
+
+	return out;
+}
+
+// Multiplies & adds needed for a product, multiplying by one is free.
+constexpr size_t smat_product_cost(uint16_t an, uint16_t ao, uint16_t bn, uint16_t bo) {
+	size_t cost = 0;
+	for (size_t r = 0; r < 4; ++r)
+		for (size_t c = 0; c < 4; ++c) {
+			size_t terms = 0;
+
+			for (size_t k = 0; k < 4; ++k)
+				if ((an & smat_bit(r, k)) && (bn & smat_bit(k, c))) {
+					++terms;
+					if (!(ao & smat_bit(r, k)) && !(bo & smat_bit(k, c)))
+						++cost;
+				}
+
+			cost += terms > 0 ? terms - 1 : 0;
+		}
+
+	return cost;
+}
+
+constexpr bool smat_has_terms(uint16_t an, uint16_t bn, size_t r, size_t c, size_t k) {
+	for (; k < 4; ++k)
+		if ((an & smat_bit(r, k)) && (bn & smat_bit(k, c)))
+			return true;
+
+	return false;
+}
+
+template <typename T, uint16_t NonZero, uint16_t One = 0>
+struct smat4 {
+	static_assert((One & ~NonZero) == 0, "ones must be non-zero");
+
+	static constexpr uint16_t nonZero = NonZero;
+	static constexpr uint16_t ones = One;
+
+	// Elements that are zero or one are never read.
+	T data[16];
+
+	smat4() : data{} {}
+
+	template <size_t I>
+	T at() const {
+		if constexpr (One & (1u << I))
+			return T(1);
+		else if constexpr (NonZero & (1u << I))
+			return data[I];
+		else
+			return T(0);
+	}
+
+	T get(size_t r, size_t c) const {
+		const uint16_t bit = smat_bit(r, c);
+		return (One & bit) ? T(1) : (NonZero & bit) ? data[r * 4 + c] : T(0);
+	}
+
+	mat4<T> dense() const {
+		mat4<T> out;
+		for (size_t i = 0; i < 16; ++i)
+			out.data[i] = get(i / 4, i % 4);
+
+		return out;
+	}
+
+	affine3x4<T> affine() const {
+		static_assert(
+			(NonZero & 0xf000) == 0x8000 && (One & 0x8000),
+			"last row must be [0 0 0 1]");
+
+		affine3x4<T> out;
+		for (size_t i = 0; i < 12; ++i)
+			out.data[i] = get(i / 4, i % 4);
+
+		return out;
+	}
+
+	vec3<T> operator*(const vec3<T> &vec) const {
+		return affine() * vec;
+	}
+};
+
+template <typename T, size_t R, size_t C, size_t K, typename A, typename B>
+T smat_sum(const A &a, const B &b) {
+	constexpr bool has =
+		(A::nonZero & smat_bit(R, K)) && (B::nonZero & smat_bit(K, C));
+	constexpr bool rest =
+		smat_has_terms(A::nonZero, B::nonZero, R, C, K + 1);
+
+	if constexpr (has && rest)
+		return
+			a.template at<R * 4 + K>() * b.template at<K * 4 + C>() +
+			smat_sum<T, R, C, K + 1>(a, b);
+	else if constexpr (has)
+		return a.template at<R * 4 + K>() * b.template at<K * 4 + C>();
+	else
+		return smat_sum<T, R, C, K + 1>(a, b);
+}
+
+template <typename T, size_t I, typename A, typename B>
+T smat_element(const A &a, const B &b) {
+	if constexpr (smat_has_terms(A::nonZero, B::nonZero, I / 4, I % 4, 0))
+		return smat_sum<T, I / 4, I % 4, 0>(a, b);
+	else
+		return T(0);
+}
+
+template <typename T, typename Out, typename A, typename B, size_t... I>
+void smat_multiply(Out &out, const A &a, const B &b, std::index_sequence<I...>) {
+	// Only store elements that are not known to be zero or one.
+	((void)(((Out::nonZero & ~Out::ones) & (1u << I)) ?
+		(out.data[I] = smat_element<T, I>(a, b), 0) : 0), ...);
+}
+
+template <typename T, uint16_t AN, uint16_t AO, uint16_t BN, uint16_t BO>
+smat4<T, smat_product_nz(AN, BN), smat_product_one(AN, AO, BN, BO)>
+operator*(const smat4<T, AN, AO> &a, const smat4<T, BN, BO> &b) {
+	smat4<T, smat_product_nz(AN, BN), smat_product_one(AN, AO, BN, BO)> out;
+	smat_multiply<T>(out, a, b, std::make_index_sequence<16>());
+	return out;
+}
+
+// Chain ordering, plain dynamic programming over all splits.
+struct smat_plan {
+	size_t cost;
+	uint16_t nonZero;
+	uint16_t ones;
+	size_t split;
+};
+
+template <size_t N>
+constexpr smat_plan smat_best(
+		const std::array<uint16_t, N> &nz, const std::array<uint16_t, N> &one,
+		size_t i, size_t j) {
+	if (i == j)
+		return smat_plan{0, nz[i], one[i], i};
+
+	smat_plan best = {SIZE_MAX, 0, 0, i};
+	for (size_t k = i; k < j; ++k) {
+		const smat_plan l = smat_best(nz, one, i, k);
+		const smat_plan r = smat_best(nz, one, k + 1, j);
+		const size_t cost = l.cost + r.cost +
+			smat_product_cost(l.nonZero, l.ones, r.nonZero, r.ones);
+
+		if (cost < best.cost)
+			best = smat_plan{
+				cost,
+				smat_product_nz(l.nonZero, r.nonZero),
+				smat_product_one(l.nonZero, l.ones, r.nonZero, r.ones),
+				k
+			};
+	}
+
+	return best;
+}
+
+template <size_t I, size_t J, typename... M>
+auto smat_eval(const std::tuple<const M&...> &chain) {
+	if constexpr (I == J)
+		return std::get<I>(chain);
+	else {
+		constexpr std::array<uint16_t, sizeof...(M)> nz = { M::nonZero... };
+		constexpr std::array<uint16_t, sizeof...(M)> one = { M::ones... };
+		constexpr size_t K = smat_best(nz, one, I, J).split;
+
+		return smat_eval<I, K>(chain) * smat_eval<K + 1, J>(chain);
+	}
+}
+
+// Cost of evaluating a chain, in multiplies & adds.
+template <typename... M>
+constexpr size_t smat_chain_cost() {
+	constexpr std::array<uint16_t, sizeof...(M)> nz = { M::nonZero... };
+	constexpr std::array<uint16_t, sizeof...(M)> one = { M::ones... };
+	return smat_best(nz, one, 0, sizeof...(M) - 1).cost;
+}
+
+// Product of all matrices, left to right, in the cheapest order.
+template <typename... M>
+auto smat_chain(const M&... ms) {
+	return smat_eval<0, sizeof...(M) - 1>(std::tuple<const M&...>(ms...));
+}
+
+// Common building blocks.
+template <typename T>
+using smat_translation = smat4<T, 0x8ca9, 0x8421>;
+
+template <typename T>
+smat_translation<T> smat_translate(const vec3<T> &t) {
+	smat_translation<T> out;
+	out.data[3] = t[0];
+	out.data[7] = t[1];
+	out.data[11] = t[2];
+	return out;
+}
+
+template <typename T>
+using smat_rotation_x = smat4<T, 0x8661, 0x8001>;
+
+template <typename T>
+smat_rotation_x<T> smat_rotate_x(T angle) {
+	smat_rotation_x<T> out;
+	out.data[5] = cos(angle), out.data[6] = -sin(angle);
+	out.data[9] = sin(angle), out.data[10] = cos(angle);
+	return out;
+}
+
+template <typename T>
+using smat_rotation_y = smat4<T, 0x8525, 0x8020>;
+
+template <typename T>
+smat_rotation_y<T> smat_rotate_y(T angle) {
+	smat_rotation_y<T> out;
+	out.data[0] = cos(angle), out.data[2] = sin(angle);
+	out.data[8] = -sin(angle), out.data[10] = cos(angle);
+	return out;
+}
+
+// Reverse depth perspective projection, maps near to 1 and far to 0.
+template <typename T>
+using smat_projection = smat4<T, 0x4c21, 0x0000>;
+
+template <typename T>
+smat_projection<T> smat_perspective(T vertFov, T aspect, T near, T far) {
+	const T focalLen = T(1) / tan(vertFov / T(2));
+	const T A = near / (far - near);
+
+	smat_projection<T> out;
+	out.data[0] = focalLen / aspect;
+	out.data[5] = -focalLen;
+	out.data[10] = A;
+	out.data[11] = far * A;
+	out.data[14] = T(-1);
+	return out;
+}
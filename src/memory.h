@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+enum MemCategory {
+	MEM_GPU_ASSETS, // GFXHeap memory of loaded glTF assets.
+	MEM_FRAME_DATA, // FrameData groups.
+	MEM_GRAPH,      // Graph nodes.
+	MEM_LOADER,     // CPU-side glTF documents & buffers.
+	MEM_ANIMATION,  // Keyframe tracks & poses.
+	MEM_CULLING,    // Occluder meshes & depth buffers.
+	MEM_TEXTURES,   // Resident mip levels of streamed textures.
+
+	MEM_NUM_CATEGORIES
+};
+
+struct MemUsage {
+	uint64_t current;
+	uint64_t peak;
+	uint64_t allocs; // Total number of allocations made.
+	uint64_t live;   // Allocations not yet freed.
+	uint64_t budget; // 0 for none.
+};
+
+// All thread-safe.
+void mem_track_alloc(MemCategory cat, uint64_t bytes);
+void mem_track_free(MemCategory cat, uint64_t bytes);
+
+MemUsage mem_get_usage(MemCategory cat);
+const char *mem_get_name(MemCategory cat);
+bool mem_find_category(const char *name, MemCategory *cat);
+
+// Soft budget, exceeding it only prints a warning (once per excess).
+void mem_set_budget(MemCategory cat, uint64_t bytes);
+
+// Writes all categories as a JSON object.
+void mem_dump_json(FILE *out);
+
+// Requests a dump from a signal handler or event callback,
+// returns & clears whether one was requested.
+void mem_request_dump();
+bool mem_dump_requested();
+
+// Tracked allocation that can be resized, freed on destruction.
+class MemCharge {
+public:
+	MemCharge(MemCategory cat, uint64_t bytes = 0) : cat(cat), bytes(0) { set(bytes); }
+	MemCharge(const MemCharge &other) : cat(other.cat), bytes(0) { set(other.bytes); }
+	~MemCharge() { set(0); }
+
+	MemCharge &operator=(const MemCharge &other) {
+		if (this != &other) {
+			set(0);
+			cat = other.cat;
+			set(other.bytes);
+		}
+		return *this;
+	}
+
+	void set(uint64_t bytes);
+	uint64_t get() const { return bytes; }
+
+private:
+	MemCategory cat;
+	uint64_t bytes;
+};
+
+// Heap allocations made through operator new, counted per thread
+// & in total, sizes are not tracked. malloc & friends are not intercepted:
+// that replaces the C allocator of the whole process (groufix, the Vulkan
+// driver & libc itself) through a per-platform hook, counting allocations
+// we have no control over. Our own code allocates through new only.
+uint64_t heap_allocs();       // By the calling thread & work it dispatched.
+uint64_t heap_allocs_total(); // By all threads.
+
+// Adds allocations made on behalf of the calling thread to its count,
+// for threads doing work for it.
+void heap_credit_allocs(uint64_t allocs);
+
+// Allocations made inside a NoAllocRegion, by all threads.
+uint64_t heap_region_allocs();
+
+// Abort with a message on any allocation inside a NoAllocRegion,
+// instead of only counting it.
+void heap_set_abort(bool abort);
+
+// Counts the calling thread's allocations since construction.
+class AllocScope {
+public:
+	AllocScope() : start(heap_allocs()) {}
+	uint64_t count() const { return heap_allocs() - start; }
+
+private:
+	uint64_t start;
+};
+
+// NoAllocRegions the calling thread is in, to carry over to threads
+// doing work on its behalf.
+unsigned int heap_region_depth();
+
+// Marks code the calling thread runs until destruction as not allowed
+// to allocate, nests, does nothing if not active.
+class NoAllocRegion {
+public:
+	NoAllocRegion(bool active = true);
+	~NoAllocRegion();
+
+	NoAllocRegion(const NoAllocRegion&) = delete;
+	NoAllocRegion &operator=(const NoAllocRegion&) = delete;
+
+private:
+	bool active;
+};
+
+// Linear allocator for data that lives no longer than a frame,
+// reset() frees everything at once. Blocks are kept across resets,
+// so only frames needing more than any frame before allocate.
+class FrameArena {
+public:
+	FrameArena(size_t blockSize = 64 << 10);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena &operator=(const FrameArena&) = delete;
+
+	void *alloc(size_t bytes, size_t align);
+	void reset();
+
+	size_t capacity() const;
+
+private:
+	struct Block {
+		uint8_t *data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t block; // Currently allocating from.
+	size_t used;  // Of the current block.
+	size_t blockSize;
+};
+
+// Standard allocator on top of a FrameArena, deallocation is a no-op.
+template<typename T>
+struct ArenaAllocator {
+	using value_type = T;
+
+	FrameArena *arena;
+
+	ArenaAllocator(FrameArena *arena) : arena(arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(size_t n) { return (T*)arena->alloc(n * sizeof(T), alignof(T)); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
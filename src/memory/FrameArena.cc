@@ -0,0 +1,48 @@
+#include <algorithm>
+#include "memory.h"
+
+FrameArena::FrameArena(size_t blockSize) :
+	block(0), used(0), blockSize(blockSize)
+{
+}
+
+FrameArena::~FrameArena() {
+	for (const Block &b : blocks)
+		::operator delete(b.data);
+}
+
+void *FrameArena::alloc(size_t bytes, size_t align) {
+	// Next fitting block, larger requests get a block of their own.
+	while (true) {
+		if (block < blocks.size()) {
+			const Block &b = blocks[block];
+			const size_t offset = (used + align - 1) & ~(align - 1);
+
+			if (offset + bytes <= b.size) {
+				used = offset + bytes;
+				return b.data + offset;
+			}
+
+			++block;
+			used = 0;
+			continue;
+		}
+
+		// Fundamental alignment from operator new.
+		const size_t size = std::max(bytes, blockSize);
+		blocks.push_back(Block{ (uint8_t*)::operator new(size), size });
+	}
+}
+
+void FrameArena::reset() {
+	block = 0;
+	used = 0;
+}
+
+size_t FrameArena::capacity() const {
+	size_t bytes = 0;
+	for (const Block &b : blocks)
+		bytes += b.size;
+
+	return bytes;
+}
@@ -0,0 +1,157 @@
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include "memory.h"
+
+// Replaces the global operator new & delete to count allocations,
+// thread-local counters need no dynamic initialization.
+static thread_local uint64_t threadAllocs = 0;
+static thread_local unsigned int regionDepth = 0;
+
+static std::atomic<uint64_t> totalAllocs(0);
+static std::atomic<uint64_t> regionAllocs(0);
+static std::atomic<bool> abortInRegion(false);
+
+static void count_alloc(size_t size) {
+	++threadAllocs;
+	totalAllocs.fetch_add(1, std::memory_order_relaxed);
+
+	if (regionDepth > 0) {
+		regionAllocs.fetch_add(1, std::memory_order_relaxed);
+
+		// stdio goes through malloc, it cannot recurse.
+		if (abortInRegion.load(std::memory_order_relaxed)) {
+			fprintf(stderr,
+				"Allocated %zu bytes inside a no-allocation region.\n", size);
+			abort();
+		}
+	}
+}
+
+static void *heap_alloc(size_t size) {
+	count_alloc(size);
+	return malloc(size > 0 ? size : 1);
+}
+
+static void *heap_alloc_aligned(size_t size, size_t align) {
+	count_alloc(size);
+
+#if defined(_WIN32)
+	return _aligned_malloc(size > 0 ? size : 1, align);
+#else
+	// Must be a multiple of the alignment.
+	size = ((size > 0 ? size : 1) + align - 1) & ~(align - 1);
+	return aligned_alloc(align, size);
+#endif
+}
+
+static void heap_free_aligned(void *ptr) {
+#if defined(_WIN32)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+uint64_t heap_allocs() {
+	return threadAllocs;
+}
+
+void heap_credit_allocs(uint64_t allocs) {
+	threadAllocs += allocs;
+}
+
+uint64_t heap_allocs_total() {
+	return totalAllocs.load(std::memory_order_relaxed);
+}
+
+uint64_t heap_region_allocs() {
+	return regionAllocs.load(std::memory_order_relaxed);
+}
+
+unsigned int heap_region_depth() {
+	return regionDepth;
+}
+
+void heap_set_abort(bool abort) {
+	abortInRegion = abort;
+}
+
+NoAllocRegion::NoAllocRegion(bool active) : active(active) {
+	if (active) ++regionDepth;
+}
+
+NoAllocRegion::~NoAllocRegion() {
+	if (active) --regionDepth;
+}
+
+void *operator new(size_t size) {
+	void *ptr = heap_alloc(size);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size) {
+	void *ptr = heap_alloc(size);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+	return heap_alloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return heap_alloc(size);
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+	void *ptr = heap_alloc_aligned(size, (size_t)align);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size, std::align_val_t align) {
+	void *ptr = heap_alloc_aligned(size, (size_t)align);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+	return heap_alloc_aligned(size, (size_t)align);
+}
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+	return heap_alloc_aligned(size, (size_t)align);
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { free(ptr); }
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+	heap_free_aligned(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+	heap_free_aligned(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+	heap_free_aligned(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+	heap_free_aligned(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+	heap_free_aligned(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+	heap_free_aligned(ptr);
+}
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <string.h>
+#include "memory.h"
+
+struct MemCounters {
+	std::atomic<uint64_t> current;
+	std::atomic<uint64_t> peak;
+	std::atomic<uint64_t> allocs;
+	std::atomic<uint64_t> live;
+	std::atomic<uint64_t> budget;
+	std::atomic<bool> warned;
+};
+
+static MemCounters counters[MEM_NUM_CATEGORIES];
+static std::atomic<bool> dumpRequested(false);
+
+static const char *names[MEM_NUM_CATEGORIES] = {
+	"gpu_assets",
+	"frame_data",
+	"graph",
+	"loader",
+	"animation",
+	"culling",
+	"textures"
+};
+
+void mem_track_alloc(MemCategory cat, uint64_t bytes) {
+	MemCounters &c = counters[cat];
+	const uint64_t current = c.current += bytes;
+	++c.allocs;
+	++c.live;
+
+	uint64_t peak = c.peak;
+	while (current > peak && !c.peak.compare_exchange_weak(peak, current));
+
+	const uint64_t budget = c.budget;
+	if (budget > 0 && current > budget && !c.warned.exchange(true))
+		fprintf(stderr,
+			"Memory budget exceeded: %s uses %llu of %llu bytes.\n",
+			names[cat], (unsigned long long)current, (unsigned long long)budget);
+}
+
+void mem_track_free(MemCategory cat, uint64_t bytes) {
+	MemCounters &c = counters[cat];
+	const uint64_t current = c.current -= bytes;
+	--c.live;
+
+	// Warn again next time it is exceeded.
+	if (current <= c.budget)
+		c.warned = false;
+}
+
+MemUsage mem_get_usage(MemCategory cat) {
+	const MemCounters &c = counters[cat];
+	return MemUsage{c.current, c.peak, c.allocs, c.live, c.budget};
+}
+
+const char *mem_get_name(MemCategory cat) {
+	return names[cat];
+}
+
+bool mem_find_category(const char *name, MemCategory *cat) {
+	for (int c = 0; c < MEM_NUM_CATEGORIES; ++c)
+		if (strcmp(names[c], name) == 0) {
+			*cat = (MemCategory)c;
+			return true;
+		}
+
+	return false;
+}
+
+void mem_set_budget(MemCategory cat, uint64_t bytes) {
+	counters[cat].budget = bytes;
+	counters[cat].warned = false;
+}
+
+void mem_dump_json(FILE *out) {
+	uint64_t current = 0, peak = 0;
+
+	fprintf(out, "{\n  \"categories\": {\n");
+
+	for (int c = 0; c < MEM_NUM_CATEGORIES; ++c) {
+		const MemUsage use = mem_get_usage((MemCategory)c);
+		current += use.current;
+		peak += use.peak;
+
+		fprintf(out,
+			"    \"%s\": {\"current\": %llu, \"peak\": %llu, "
+			"\"allocs\": %llu, \"live\": %llu, \"budget\": %llu}%s\n",
+			names[c],
+			(unsigned long long)use.current, (unsigned long long)use.peak,
+			(unsigned long long)use.allocs, (unsigned long long)use.live,
+			(unsigned long long)use.budget,
+			c + 1 < MEM_NUM_CATEGORIES ? "," : "");
+	}
+
+	// Sum of peaks is an upper bound, they need not coincide.
+	fprintf(out,
+		"  },\n  \"total\": {\"current\": %llu, \"peak_bound\": %llu}\n}\n",
+		(unsigned long long)current, (unsigned long long)peak);
+
+	fflush(out);
+}
+
+void mem_request_dump() {
+	dumpRequested = true;
+}
+
+bool mem_dump_requested() {
+	return dumpRequested.exchange(false);
+}
+
+void MemCharge::set(uint64_t bytes) {
+	if (bytes == this->bytes) return;
+
+	// Each resize counts as a new allocation.
+	if (this->bytes > 0) mem_track_free(cat, this->bytes);
+	if (bytes > 0) mem_track_alloc(cat, bytes);
+
+	this->bytes = bytes;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include "def.h"
+
+// Limits the frames in flight to at most the renderer's frame count.
+// In adaptive mode the limit moves between 1 (lowest latency) and
+// MAX_VIRTUAL_FRAMES (highest throughput) depending on whether the
+// CPU or the wait for the GPU dominates the frame time.
+//
+// Also times the GPU from the completion of submitted frames, as observed
+// when their virtual frame is acquired again, so nothing extra stalls.
+class FramePacer {
+public:
+	// A submitted frame the GPU has finished.
+	struct Completion {
+		uint64_t frame;  // Counting submits from 0.
+		double gpuMs;    // From the later of its submit & the previous
+		                 // completion, to its own completion.
+		bool exact;      // Waited for, otherwise gpuMs is an upper bound.
+	};
+
+	// 0 frames means adaptive, otherwise clamped to the renderer's count.
+	FramePacer(GFXRenderer *renderer, unsigned int frames);
+
+	bool adaptive() { return isAdaptive; }
+	unsigned int framesInFlight() { return limit; }
+
+	// Use in place of gfx_renderer_acquire and gfx_frame_submit.
+	GFXFrame *acquire();
+	void submit(GFXFrame *frame);
+
+	// Pops the oldest completion not yet polled, in submission order.
+	bool poll(Completion &out);
+
+	// Time the last acquire() waited, for the GPU or the swapchain.
+	double waitMs() { return lastWaitMs; }
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Submission {
+		GFXFrame *frame;
+		uint64_t id;
+		clock::time_point time;
+	};
+
+	void adapt();
+	void complete(GFXFrame *frame, clock::time_point time, bool exact);
+
+	GFXRenderer *renderer;
+	bool isAdaptive;
+	unsigned int limit;
+
+	// All short & reserved up front, so frames never allocate.
+	std::vector<GFXFrame*> inFlight;
+
+	// Not yet known to be done, oldest first.
+	std::vector<Submission> pending;
+	std::vector<Completion> completions;
+	clock::time_point lastCompletion;
+	uint64_t submits;
+
+	// Accumulated over the current adaptation window.
+	clock::time_point frameStart;
+	double lastWaitMs;
+	double cpuMs;
+	double blockedMs;
+	unsigned int samples;
+};
+
+// Steps the render scale to keep the GPU within a frame time budget.
+// Only lowers the scale when the GPU is the one exceeding it, which
+// is only certain for frames the CPU waited for, and only raises it
+// when the frame is predicted to fit at the next scale, as GPU time
+// is assumed proportional to the number of pixels.
+class ResolutionScaler {
+public:
+	// Scales are per axis, clamped to (0,1].
+	ResolutionScaler(double budgetMs, float minScale, float maxScale);
+
+	float scale() { return current; }
+	size_t changes() { return numChanges; }
+
+	// Feed every frame, GPU times as they arrive, possibly frames later.
+	void addCpu(double cpuMs);
+	void addGpu(double gpuMs, bool exact);
+
+	// Call once per frame after feeding it, returns whether the scale changed.
+	bool update();
+
+private:
+	double budgetMs;
+	float minScale;
+	float maxScale;
+	float current;
+	size_t numChanges;
+	uint64_t frames;
+
+	// Accumulated since the last decision.
+	unsigned int samples;
+	unsigned int settle; // Frames still rendered at the previous scale.
+	double cpuMs;
+	double gpuMs;    // Upper bound of all.
+	double gpuExact; // Of frames waited for only.
+	unsigned int gpuSamples;
+	unsigned int exactSamples;
+};
+
+// Paces frames to a target rate: sleeps for most of the wait, then yields
+// up to the deadline, sleeping no closer to it than the scheduler tends
+// to overshoot. Deadlines advance by a fixed period so the average rate is exact,
+// a frame over a period late starts over instead of catching up in a burst.
+class FrameLimiter {
+public:
+	// In frames per second.
+	FrameLimiter(double rate);
+
+	double rate() { return 1.0 / std::chrono::duration<double>(period).count(); }
+
+	// Blocks until the next frame is due, returns the time waited.
+	double wait();
+
+	// Call after blocking elsewhere, so the next frame starts right away.
+	void reset() { started = false; }
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	clock::duration period;
+	clock::duration slack; // Expected oversleep, yielded instead.
+	clock::time_point next;
+	bool started;
+};
@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <thread>
+#include "pacer.h"
+
+// Bounds of the time yielded before a deadline, rather than slept.
+#define LIMITER_MIN_SLACK std::chrono::microseconds(100)
+#define LIMITER_MAX_SLACK std::chrono::microseconds(4000)
+
+// Slack moves 1/n towards an oversleep, or decays by 1/n per frame without.
+#define LIMITER_RISE 4
+#define LIMITER_DECAY 64
+
+FrameLimiter::FrameLimiter(double rate) :
+	period(std::chrono::duration_cast<clock::duration>(
+		std::chrono::duration<double>(1.0 / GFX_MAX(rate, 1.0)))),
+	slack(std::chrono::microseconds(1000)),
+	started(false)
+{
+}
+
+double FrameLimiter::wait() {
+	const auto start = clock::now();
+
+	if (!started || start > next + period)
+		next = start;
+
+	started = true;
+
+	// Sleep coarsely, learning how late the scheduler wakes us.
+	const auto target = next - slack;
+	if (start < target) {
+		std::this_thread::sleep_until(target);
+
+		// Rises quickly, but not all the way for a single outlier.
+		const auto over = clock::now() - target;
+		slack = std::clamp<clock::duration>(
+			over > slack ?
+				slack + (over - slack) / LIMITER_RISE :
+				slack - slack / LIMITER_DECAY,
+			LIMITER_MIN_SLACK, LIMITER_MAX_SLACK);
+	}
+
+	while (clock::now() < next)
+		std::this_thread::yield();
+
+	next += period;
+
+	return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+}
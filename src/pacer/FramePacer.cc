@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <stdio.h>
+#include "pacer.h"
+
+// Frames to average over before (re)considering the limit.
+#define PACER_WINDOW 60
+
+// Switch to 1 frame in flight if the CPU takes less of the frame,
+// which would be serialized with the GPU again.
+#define PACER_LATENCY_RATIO 0.1
+
+// Switch to MAX frames in flight if overlap could save more of the frame.
+#define PACER_THROUGHPUT_RATIO 0.25
+
+// Blocking this long means the frame was still running.
+#define PACER_BLOCKED_MS 0.05
+
+// Completions kept when never polled.
+#define PACER_MAX_COMPLETIONS 256
+
+FramePacer::FramePacer(GFXRenderer *renderer, unsigned int frames) :
+	renderer(renderer), isAdaptive(frames == 0),
+	submits(0),
+	lastWaitMs(0.0), cpuMs(0.0), blockedMs(0.0), samples(0)
+{
+	const unsigned int max = gfx_renderer_get_num_frames(renderer);
+	limit = isAdaptive ? max : GFX_CLAMP(frames, 1u, max);
+	frameStart = clock::now();
+	lastCompletion = frameStart;
+
+	// Every submit completes by the time its frame is acquired again.
+	inFlight.reserve(max);
+	pending.reserve(max * 2);
+	completions.reserve(PACER_MAX_COMPLETIONS + max * 2);
+}
+
+GFXFrame *FramePacer::acquire() {
+	const auto begin = clock::now();
+
+	auto blocked = [](clock::time_point since, clock::time_point until) {
+		return std::chrono::duration<double, std::milli>(until - since).count() >=
+			PACER_BLOCKED_MS;
+	};
+
+	// Wait for frames beyond the limit, acquiring waits for the rest.
+	while (inFlight.size() >= limit) {
+		const auto blockStart = clock::now();
+		gfx_frame_block(inFlight.front());
+
+		const auto blockEnd = clock::now();
+		complete(inFlight.front(), blockEnd, blocked(blockStart, blockEnd));
+		inFlight.erase(inFlight.begin());
+	}
+
+	const auto acquireStart = clock::now();
+	GFXFrame *frame = gfx_renderer_acquire(renderer);
+	const auto end = clock::now();
+
+	complete(frame, end, blocked(acquireStart, end));
+
+	cpuMs += std::chrono::duration<double, std::milli>(begin - frameStart).count();
+	lastWaitMs = std::chrono::duration<double, std::milli>(end - begin).count();
+	blockedMs += lastWaitMs;
+	frameStart = end;
+
+	return frame;
+}
+
+void FramePacer::submit(GFXFrame *frame) {
+	gfx_frame_submit(frame);
+	pending.push_back(Submission{ frame, submits++, clock::now() });
+
+	// The renderer reuses its frames, forget the acquired one's last use.
+	for (auto it = inFlight.begin(); it != inFlight.end(); ++it)
+		if (*it == frame) {
+			inFlight.erase(it);
+			break;
+		}
+
+	inFlight.push_back(frame);
+
+	if (isAdaptive && ++samples >= PACER_WINDOW)
+		adapt();
+}
+
+void FramePacer::complete(GFXFrame *frame, clock::time_point time, bool exact) {
+	// The last submit of this frame & everything before it are done,
+	// only the one waited for is timed exactly.
+	auto it = std::find_if(pending.begin(), pending.end(),
+		[&](const Submission &s) { return s.frame == frame; });
+
+	if (it == pending.end())
+		return;
+
+	for (auto s = pending.begin(); s <= it; ++s) {
+		const auto start = GFX_MAX(s->time, lastCompletion);
+		completions.push_back(Completion{
+			s->id,
+			std::chrono::duration<double, std::milli>(time - start).count(),
+			exact && s == it });
+
+		lastCompletion = time;
+	}
+
+	pending.erase(pending.begin(), it + 1);
+
+	if (completions.size() > PACER_MAX_COMPLETIONS)
+		completions.erase(
+			completions.begin(),
+			completions.end() - PACER_MAX_COMPLETIONS);
+}
+
+bool FramePacer::poll(Completion &out) {
+	if (completions.empty())
+		return false;
+
+	out = completions.front();
+	completions.erase(completions.begin());
+	return true;
+}
+
+void FramePacer::adapt() {
+	const double cpu = cpuMs / samples;
+	const double blocked = blockedMs / samples;
+	const double total = cpu + blocked;
+
+	const unsigned int max = gfx_renderer_get_num_frames(renderer);
+	unsigned int next = limit;
+
+	// With 1 frame the CPU waits for the GPU every frame, overlapping them
+	// would save the smaller of the two. With more frames, going down to 1
+	// costs the CPU time on top of the GPU-bound frame time.
+	if (limit == 1 && GFX_MIN(cpu, blocked) > total * PACER_THROUGHPUT_RATIO)
+		next = max;
+	else if (limit > 1 && cpu < total * PACER_LATENCY_RATIO)
+		next = 1;
+
+	if (next != limit) {
+		printf(
+			"frames in flight: %u -> %u (cpu %.3f ms, blocked %.3f ms)\n",
+			limit, next, cpu, blocked);
+
+		limit = next;
+	}
+
+	cpuMs = 0.0;
+	blockedMs = 0.0;
+	samples = 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include "pacer.h"
+
+// Frames to average over before (re)considering the scale.
+#define SCALER_WINDOW 30
+
+// Frames to ignore after a change, still in flight at the previous scale.
+#define SCALER_SETTLE (MAX_VIRTUAL_FRAMES + 2)
+
+// Per axis, per step.
+#define SCALER_STEP 0.1f
+
+// Raise the scale only if the frame is predicted to take less of the budget.
+#define SCALER_HEADROOM 0.85
+
+ResolutionScaler::ResolutionScaler(double budgetMs, float minScale, float maxScale) :
+	budgetMs(budgetMs),
+	numChanges(0), frames(0),
+	samples(0), settle(0),
+	cpuMs(0.0), gpuMs(0.0), gpuExact(0.0),
+	gpuSamples(0), exactSamples(0)
+{
+	this->maxScale = GFX_CLAMP(maxScale, SCALER_STEP, 1.0f);
+	this->minScale = GFX_CLAMP(minScale, SCALER_STEP, this->maxScale);
+	current = this->maxScale;
+}
+
+void ResolutionScaler::addCpu(double cpuMs) {
+	if (settle > 0) return;
+
+	this->cpuMs += cpuMs;
+	++samples;
+}
+
+void ResolutionScaler::addGpu(double gpuMs, bool exact) {
+	if (settle > 0) return;
+
+	this->gpuMs += gpuMs;
+	++gpuSamples;
+
+	if (exact) {
+		gpuExact += gpuMs;
+		++exactSamples;
+	}
+}
+
+bool ResolutionScaler::update() {
+	++frames;
+
+	if (settle > 0) {
+		--settle;
+		return false;
+	}
+
+	if (samples < SCALER_WINDOW || gpuSamples == 0)
+		return false;
+
+	const double cpu = cpuMs / samples;
+	const double gpu = gpuMs / gpuSamples;
+	const double exact = exactSamples > 0 ? gpuExact / exactSamples : 0.0;
+
+	samples = 0;
+	gpuSamples = 0;
+	exactSamples = 0;
+	cpuMs = 0.0;
+	gpuMs = 0.0;
+	gpuExact = 0.0;
+
+	float next = current;
+
+	// Only GPU time scales with the resolution, the CPU could also
+	// exceed the budget, at which point nothing is gained.
+	if (exact > budgetMs)
+		next = GFX_MAX(current - SCALER_STEP, minScale);
+	else if (current < maxScale) {
+		const float up = GFX_MIN(current + SCALER_STEP, maxScale);
+		const double ratio = (double)(up * up) / (double)(current * current);
+
+		if (cpu < budgetMs && gpu * ratio < budgetMs * SCALER_HEADROOM)
+			next = up;
+	}
+
+	if (next == current)
+		return false;
+
+	printf(
+		"resolution: scale %.2f -> %.2f at frame %llu "
+		"(cpu %.3f ms, gpu %.3f ms, budget %.3f ms)\n",
+		current, next, (unsigned long long)frames,
+		cpu, exact > 0.0 ? exact : gpu, budgetMs);
+
+	current = next;
+	settle = SCALER_SETTLE;
+	++numChanges;
+
+	return true;
+}
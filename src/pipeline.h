@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "cull.h"
+#include "def.h"
+#include "graph.h"
+#include "light.h"
+#include "stats.h"
+#include "texture.h"
+
+class IndirectDraws;
+
+// One camera's part of a snapshot, culled & collected on its own.
+struct SnapshotView {
+	mat4<float> viewProj;
+	float viewport[4]; // Normalized x, y, width, height.
+	std::vector<DrawItem> draws;
+	OcclusionCuller::Stats cull;
+	LightClusters::Stats lighting;
+	uint32_t lightOffset; // Into the light FrameData.
+	uint32_t depthOffset; // Into the depth FrameData, if culling on the GPU.
+	double prepareMs; // Culling & collecting.
+};
+
+// Everything needed to record a frame without touching the graph,
+// immutable between publish() and release().
+struct SceneSnapshot {
+	uint64_t frame;
+	std::vector<uint8_t> transforms; // Laid out like one FrameData frame.
+	std::vector<uint8_t> lights; // Likewise, an element per view.
+	std::vector<uint8_t> depth; // Likewise, if culling on the GPU.
+	std::vector<TextureRequest> textures; // Of all views.
+	std::vector<SnapshotView> views;
+	FrameCounters counters; // Of updating & writing, the render thread adds the rest.
+	bool changed; // If not, renders the same as the previous snapshot.
+	double sharedMs; // Updating & writing, done once for all views.
+};
+
+// Updates the graph & stages its output, shared by all views.
+void snapshot_scene(GraphNode *graph, FrameData *data, SceneSnapshot &out);
+
+// Culls for & collects the draws of a single view, after snapshot_scene.
+void snapshot_view(
+	GraphNode *graph, OcclusionCuller *culler, GFXPass *pass,
+	const mat4<float> &viewProj, const float viewport[4], SnapshotView &out);
+
+// Bins the lights of every view into its own element, after snapshot_view.
+void snapshot_lights(
+	LightClusters *lights, FrameData *data,
+	float near, float far, SceneSnapshot &out);
+
+// Stages the depth hierarchy the culler left behind for view `v`
+// as its element, right after its snapshot_view.
+void snapshot_depth(
+	OcclusionCuller *culler, FrameData *data, size_t v, SceneSnapshot &out);
+
+// Requests the texture levels of all textured draws of all views
+// from their screen-space footprint, after snapshot_view.
+void snapshot_textures(uint32_t width, uint32_t height, SceneSnapshot &out);
+
+// Records all views of a snapshot into the recorder's current pass,
+// binds each view's lights to set 1 if given sets (one per virtual frame)
+// and each draw's texture to set 2 if given a streamer.
+// Adds to `counters` if not nullptr, including the visible & culled draws
+// of each view, records the indirect draws of each view before its own if given.
+void record_views(
+	GFXRecorder *recorder, GFXTechnique *tech,
+	GFXSet **lightSets, TextureStreamer *textures, const SceneSnapshot &snap,
+	FrameCounters *counters = nullptr, IndirectDraws *indirect = nullptr);
+
+// Builds the pipelines of all distinct pass, technique & state combinations
+// of the graph up front, in parallel if given a job pool.
+// Returns the number of combinations, all renderables are assumed to share
+// their vertex layout with one of the same combination.
+size_t warmup_pipelines(GraphNode *graph, JobPool *jobs = nullptr);
+
+// Driver pipeline cache of the renderer, load before any pipeline is built.
+// A missing file only means a cold start.
+bool load_pipeline_cache(GFXRenderer *renderer, const char *path);
+bool store_pipeline_cache(GFXRenderer *renderer, const char *path);
+
+// GPU-driven drawing of all primitives with a shared range: their bounds
+// & transforms live in GPU buffers, a compute pass culls them per view
+// and writes indirect draw arguments, the render pass then draws
+// all primitives sharing a technique, buffers & texture with one multi-draw.
+// Culled primitives are drawn with no instances, all draws are kept.
+class IndirectDraws {
+public:
+	struct Stats {
+		size_t objects;
+		size_t groups; // Multi-draws per view.
+	};
+
+	// `cullTech` must be assets/cull.comp, sets are created for it.
+	IndirectDraws(
+		GFXRenderer *renderer, GFXHeap *heap,
+		GFXTechnique *cullTech, size_t numViews);
+
+	~IndirectDraws();
+
+	// (Re)collects all primitives of a graph drawn in `pass` & flags them as
+	// indirect, so they are no longer culled or collected on the CPU.
+	// `transforms` receives each frame's staged `data`, as one element,
+	// `depth` the snapshot's depth, an element per view.
+	// Builds the pipelines of all groups, in parallel if given a job pool.
+	bool build(
+		GraphNode *graph, GFXPass *pass,
+		FrameData *data, FrameData *transforms, FrameData *depth,
+		JobPool *jobs = nullptr);
+
+	// Records the culling of all views, in the compute pass.
+	void cull(GFXRecorder *recorder, const SceneSnapshot &snap);
+
+	// Records the multi-draws of view `v`, in the render pass after
+	// its view-projection is pushed. Adds to `counters` if not nullptr.
+	void draw(
+		GFXRecorder *recorder, size_t v,
+		TextureStreamer *textures, FrameCounters *counters = nullptr);
+
+	// Inject into the compute & the render pass respectively.
+	GFXInject signal();
+	GFXInject wait();
+
+	const Stats &stats() { return counts; }
+
+private:
+	struct Object; // As read by the GPU.
+
+	// Consecutive objects drawn with one multi-draw.
+	struct Group {
+		GFXRenderable renderable; // Of the span.
+		GFXSet **sets; // One per virtual frame.
+		Texture *texture; // Optional.
+		uint32_t first;
+		uint32_t count;
+	};
+
+	void clear();
+
+	GFXRenderer *renderer;
+	GFXHeap *heap;
+	GFXTechnique *cullTech;
+	GFXComputable computable;
+	GFXDependency *dep;
+	size_t numFrames;
+	size_t numViews;
+
+	std::vector<Group> groups;
+	std::vector<GFXSet*> cullSets; // One per virtual frame.
+	GFXBuffer *objects;
+	GFXBuffer *commands; // Per frame, per view, per object.
+
+	Stats counts;
+	MemCharge charge = { MEM_CULLING };
+};
+
+// A grid of text drawn over the top-left of its pass, a box per character
+// with the glyph in it, empty cells are left alone. Glyphs are 3x5 pixels
+// in the shader, ASCII space through underscore, lower case as upper case.
+class StatsOverlay {
+public:
+	// Must match assets/overlay.vert & .frag.
+	static const size_t COLUMNS = 64;
+	static const size_t ROWS = 8;
+
+	// `tech` must be assets/overlay.vert & .frag, sets are created for it.
+	// Drawn at `scale` screen pixels per glyph pixel.
+	StatsOverlay(
+		GFXRenderer *renderer, GFXHeap *heap,
+		GFXPass *pass, GFXTechnique *tech, float scale = 2.0f);
+
+	// Replaces all text, lines separated by '\n' & clipped to the grid.
+	void setText(const char *text);
+
+	// Uploads the text & records its draw, in the pass.
+	// Adds to `counters` if not nullptr.
+	void record(GFXRecorder *recorder, FrameCounters *counters = nullptr);
+
+	GFXRenderable *renderable() { return &rend; }
+
+private:
+	GFXTechnique *tech;
+	GFXRasterState raster;
+	GFXRenderState state;
+	GFXRenderable rend;
+	float scale;
+
+	FrameData data; // A single element of the grid.
+	std::vector<GFXSet*> sets; // One per virtual frame.
+	char text[ROWS * COLUMNS];
+};
+
+// Single-producer single-consumer ring of snapshots, lock-free.
+// The producer can run at most `numSlots - 1` snapshots ahead
+// of the one being consumed.
+class SnapshotRing {
+public:
+	SnapshotRing(size_t numSlots = 2);
+
+	// Blocks until a slot is free, nullptr once closed.
+	SceneSnapshot *acquireWrite();
+	void publish();
+
+	// Blocks until a snapshot is published,
+	// nullptr once closed and all published ones are read.
+	SceneSnapshot *acquireRead();
+	void release();
+
+	// Wakes up & fails all current and future acquires.
+	void close();
+
+	// Snapshots that can be taken before the one being consumed is released.
+	size_t numSlots() const { return slots.size(); }
+
+private:
+	static const uint64_t CLOSED = 1ull << 63;
+
+	std::vector<SceneSnapshot> slots;
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> read;
+};
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <tuple>
+#include "pipeline.h"
+
+// As VkDrawIndexedIndirectCommand.
+#define INDIRECT_COMMAND_SIZE (sizeof(uint32_t) * 5)
+
+// Must match assets/cull.comp.
+#define INDIRECT_GROUP_SIZE 64
+
+struct IndirectDraws::Object {
+	float boundsMin[3]; // Local-space, empty means always visible.
+	uint32_t transform; // Offset into the transforms in vec4s.
+	float boundsMax[3];
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t pad[2];
+};
+
+IndirectDraws::IndirectDraws(
+		GFXRenderer *renderer, GFXHeap *heap,
+		GFXTechnique *cullTech, size_t numViews) :
+	renderer(renderer),
+	heap(heap),
+	cullTech(cullTech),
+	numFrames(gfx_renderer_get_num_frames(renderer)),
+	numViews(numViews),
+	objects(nullptr),
+	commands(nullptr),
+	counts{}
+{
+	dassert(gfx_computable(&computable, cullTech));
+
+	dep = gfx_create_dep(nullptr, (unsigned int)numFrames);
+	dassert(dep);
+}
+
+IndirectDraws::~IndirectDraws() {
+	clear();
+	gfx_destroy_dep(dep);
+}
+
+void IndirectDraws::clear() {
+	// Sets are owned by the renderer.
+	for (GFXSet *set : cullSets)
+		gfx_erase_set(set);
+
+	if (objects) gfx_free_buffer(objects);
+	if (commands) gfx_free_buffer(commands);
+
+	cullSets.clear();
+	groups.clear();
+	objects = nullptr;
+	commands = nullptr;
+	counts = {};
+	charge.set(0);
+}
+
+// A primitive drawn by a group.
+struct IndirectEntry {
+	MeshNode *mesh;
+	size_t prim;
+	MeshNode::Renderable *renderable;
+	MeshNode::Primitive primitive;
+};
+
+static void gather_shared(
+		GraphNode *node, GFXPass *pass, std::vector<IndirectEntry> &out) {
+	if (MeshNode *mesh = dynamic_cast<MeshNode*>(node))
+		for (size_t p = 0; p < mesh->numPrimitives(); ++p) {
+			MeshNode::Renderable *r = mesh->getRenderable(p);
+			MeshNode::Primitive prim = mesh->getPrimitive(p);
+
+			if (r->forward.pass == pass && prim.shared.prim && !r->sets.empty())
+				out.push_back(IndirectEntry{ mesh, p, r, std::move(prim) });
+		}
+
+	for (size_t c = 0; c < node->numChildren(); ++c)
+		gather_shared(node->getChild(c), pass, out);
+}
+
+bool IndirectDraws::build(
+		GraphNode *graph, GFXPass *pass,
+		FrameData *data, FrameData *transforms, FrameData *depth,
+		JobPool *jobs) {
+	clear();
+
+	dassert(transforms->frameSize() >= data->frameSize());
+	dassert(depth->numElements() >= numViews);
+
+	// Offsets only change with the graph, write once to learn them.
+	std::vector<uint8_t> staging(data->frameSize());
+	data->setStaging(staging.data());
+	graph->write(data);
+
+	std::vector<IndirectEntry> entries;
+	gather_shared(graph, pass, entries);
+
+	if (entries.empty())
+		return true;
+
+	// Everything a group must share, consecutively.
+	// Sets by value, every primitive holds its own copy of the same sets.
+	auto key = [](const IndirectEntry &e) {
+		return std::tie(
+			e.primitive.tech, e.primitive.shared.prim, e.renderable->forward.state,
+			e.renderable->sets, e.primitive.texture);
+	};
+
+	std::stable_sort(entries.begin(), entries.end(),
+		[&](const IndirectEntry &l, const IndirectEntry &r) { return key(l) < key(r); });
+
+	std::vector<Object> objs(entries.size());
+
+	for (size_t e = 0; e < entries.size(); ++e) {
+		const IndirectEntry &entry = entries[e];
+		const aabb<float> &bounds = entry.primitive.bounds;
+
+		Object &obj = objs[e];
+		obj = {};
+		memcpy(obj.boundsMin, bounds.min.data, sizeof(obj.boundsMin));
+		memcpy(obj.boundsMax, bounds.max.data, sizeof(obj.boundsMax));
+		obj.transform = entry.mesh->dataOffset() / (uint32_t)(sizeof(float) * 4);
+		obj.indexCount = entry.primitive.numVertices;
+		obj.firstIndex = entry.primitive.shared.firstIndex;
+		obj.vertexOffset = entry.primitive.shared.vertexOffset;
+
+		if (e > 0 && key(entries[e - 1]) == key(entry)) {
+			++groups.back().count;
+			continue;
+		}
+
+		// The first primitive's sets stand in for all of the group.
+		Group group = {};
+		group.sets = entry.renderable->sets.data();
+		group.texture = entry.primitive.texture.get();
+		group.first = (uint32_t)e;
+		group.count = 1;
+
+		if (!gfx_renderable(
+			&group.renderable, pass, entry.primitive.tech,
+			entry.primitive.shared.prim, entry.renderable->forward.state))
+		{
+			clear();
+			return false;
+		}
+
+		groups.push_back(group);
+	}
+
+	// Objects never change, commands are rewritten by every cull().
+	const uint64_t objectBytes = objs.size() * sizeof(Object);
+	const uint64_t commandBytes =
+		numFrames * numViews * objs.size() * INDIRECT_COMMAND_SIZE;
+
+	objects = gfx_alloc_buffer(
+		heap, GFX_MEMORY_WRITE, GFX_BUFFER_STORAGE, objectBytes);
+	commands = gfx_alloc_buffer(
+		heap, GFX_MEMORY_NONE, GFX_BUFFER_STORAGE | GFX_BUFFER_INDIRECT, commandBytes);
+
+	const GFXRegion region = { .offset = 0, .rowSize = 0, .numRows = 0 };
+
+	if (!objects || !commands || !gfx_write(
+		objs.data(), gfx_ref_buffer(objects),
+		GFX_TRANSFER_BLOCK, 1, 0, &region, &region, nullptr))
+	{
+		clear();
+		return false;
+	}
+
+	cullSets.resize(numFrames, nullptr);
+
+	for (size_t f = 0; f < numFrames; ++f) {
+		const GFXSetResource resources[] = {
+			{ .binding = 0, .index = 0, .ref = gfx_ref_buffer(objects) },
+			{ .binding = 3, .index = 0, .ref = gfx_ref_buffer(commands) }
+		};
+
+		const GFXSetGroup setGroups[] = {
+			transforms->getAsGroup(f, 1),
+			depth->getAsGroup(f, 2)
+		};
+
+		cullSets[f] = gfx_renderer_add_set(
+			renderer, cullTech, 0,
+			2, 2, 0, 0,
+			resources, setGroups, nullptr, nullptr);
+
+		if (!cullSets[f]) {
+			cullSets.resize(f);
+			clear();
+			return false;
+		}
+	}
+
+	// Only flag them once nothing can fail anymore.
+	for (const IndirectEntry &entry : entries)
+		entry.mesh->setIndirect(entry.prim, true);
+
+	counts.objects = objs.size();
+	counts.groups = groups.size();
+	charge.set(objectBytes + commandBytes);
+
+	// A handful of pipelines, none are built by the graph's renderables.
+	auto warm = [&](size_t begin, size_t end) {
+		for (size_t g = begin; g < end; ++g)
+			if (!gfx_renderable_warmup(&groups[g].renderable))
+				fprintf(stderr, "Could not warm up a pipeline.\n");
+	};
+
+	if (jobs) jobs->parallelFor(groups.size(), 1, warm);
+	else warm(0, groups.size());
+
+	return true;
+}
+
+void IndirectDraws::cull(GFXRecorder *recorder, const SceneSnapshot &snap) {
+	if (counts.objects == 0)
+		return;
+
+	const unsigned int frame = gfx_recorder_get_frame_index(recorder);
+
+	struct {
+		float viewProj[16];
+		uint32_t numObjects;
+		uint32_t commandBase;
+	} constants;
+
+	for (size_t v = 0; v < snap.views.size() && v < numViews; ++v) {
+		const SnapshotView &view = snap.views[v];
+
+		memcpy(constants.viewProj, view.viewProj.data, sizeof(constants.viewProj));
+		constants.numObjects = (uint32_t)counts.objects;
+		constants.commandBase = (uint32_t)((frame * numViews + v) * counts.objects);
+
+		gfx_cmd_bind(
+			recorder, cullTech,
+			0, 1, 1, &cullSets[frame], &view.depthOffset);
+		gfx_cmd_push(
+			recorder, cullTech, 0, sizeof(constants), &constants);
+		gfx_cmd_dispatch(
+			recorder, &computable,
+			(uint32_t)((counts.objects + INDIRECT_GROUP_SIZE - 1) / INDIRECT_GROUP_SIZE),
+			1, 1);
+	}
+}
+
+void IndirectDraws::draw(
+		GFXRecorder *recorder, size_t v,
+		TextureStreamer *textures, FrameCounters *counters) {
+	if (counts.objects == 0 || v >= numViews)
+		return;
+
+	const unsigned int frame = gfx_recorder_get_frame_index(recorder);
+	const uint64_t base = (frame * numViews + v) * counts.objects;
+	const uint32_t zero = 0; // The per-object uniform is unused.
+
+	GFXSet *boundSet = nullptr;
+	GFXSet *boundTexture = nullptr;
+	FrameCounters count = {};
+
+	for (Group &group : groups) {
+		GFXTechnique *tech = group.renderable.technique;
+
+		if (group.sets[frame] != boundSet) {
+			gfx_cmd_bind(
+				recorder, tech,
+				0, 1, 1, &group.sets[frame], &zero);
+			boundSet = group.sets[frame];
+			++count.binds;
+		}
+
+		if (textures) {
+			GFXSet *set = group.texture ?
+				group.texture->sets()[frame] : textures->fallback()[frame];
+
+			if (set != boundTexture) {
+				gfx_cmd_bind(
+					recorder, tech,
+					2, 1, 0, &set, nullptr);
+				boundTexture = set;
+				++count.binds;
+			}
+		}
+
+		gfx_cmd_draw_indexed_indirect(
+			recorder, &group.renderable,
+			group.count, INDIRECT_COMMAND_SIZE,
+			gfx_ref_buffer_at(commands, (base + group.first) * INDIRECT_COMMAND_SIZE));
+
+		++count.draws;
+	}
+
+	// Vertices & primitives are only known to the GPU.
+	if (counters) {
+		counters->draws += count.draws;
+		counters->binds += count.binds;
+	}
+}
+
+GFXInject IndirectDraws::signal() {
+	return gfx_dep_sigra(
+		dep, gfx_ref_buffer(commands), GFX_ACCESS_INDIRECT_READ, GFX_STAGE_ANY);
+}
+
+GFXInject IndirectDraws::wait() {
+	return gfx_dep_wait(dep);
+}
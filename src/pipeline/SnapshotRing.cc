@@ -0,0 +1,49 @@
+#include "pipeline.h"
+
+SnapshotRing::SnapshotRing(size_t numSlots) :
+	slots(numSlots > 1 ? numSlots : 2), written(0), read(0) {}
+
+SceneSnapshot *SnapshotRing::acquireWrite() {
+	// Only the producer changes `written`.
+	const uint64_t w = written.load(std::memory_order_relaxed) & ~CLOSED;
+
+	while (true) {
+		const uint64_t r = read.load(std::memory_order_acquire);
+		if (r & CLOSED) return nullptr;
+		if (w - r < slots.size()) return &slots[w % slots.size()];
+
+		read.wait(r, std::memory_order_acquire);
+	}
+}
+
+void SnapshotRing::publish() {
+	// Add, don't store, so a concurrent close() is not lost.
+	written.fetch_add(1, std::memory_order_release);
+	written.notify_one();
+}
+
+SceneSnapshot *SnapshotRing::acquireRead() {
+	// Only the consumer changes `read`.
+	const uint64_t r = read.load(std::memory_order_relaxed) & ~CLOSED;
+
+	while (true) {
+		// Drain published snapshots before reporting closed.
+		const uint64_t w = written.load(std::memory_order_acquire);
+		if ((w & ~CLOSED) > r) return &slots[r % slots.size()];
+		if (w & CLOSED) return nullptr;
+
+		written.wait(w, std::memory_order_acquire);
+	}
+}
+
+void SnapshotRing::release() {
+	read.fetch_add(1, std::memory_order_release);
+	read.notify_one();
+}
+
+void SnapshotRing::close() {
+	written.fetch_or(CLOSED, std::memory_order_acq_rel);
+	read.fetch_or(CLOSED, std::memory_order_acq_rel);
+	written.notify_all();
+	read.notify_all();
+}
@@ -0,0 +1,86 @@
+#include <ctype.h>
+#include <string.h>
+#include "pipeline.h"
+
+StatsOverlay::StatsOverlay(
+		GFXRenderer *renderer, GFXHeap *heap,
+		GFXPass *pass, GFXTechnique *tech, float scale) :
+	tech(tech),
+	raster{
+		GFX_RASTER_FILL,
+		GFX_FRONT_FACE_CCW, GFX_CULL_NONE,
+		GFX_TOPO_TRIANGLE_LIST, 1},
+	state{ &raster, nullptr, nullptr, nullptr },
+	rend{},
+	scale(scale),
+	data(
+		heap, gfx_renderer_get_num_frames(renderer),
+		1, (uint32_t)sizeof(text),
+		GFX_MEMORY_NONE, GFX_BUFFER_UNIFORM),
+	sets(gfx_renderer_get_num_frames(renderer), nullptr)
+{
+	for (size_t f = 0; f < sets.size(); ++f) {
+		GFXSetGroup group = data.getAsGroup(f, 0);
+		sets[f] = gfx_renderer_add_set(
+			renderer, tech, 0,
+			0, 1, 0, 0,
+			nullptr, &group, nullptr, nullptr);
+		dassert(sets[f]);
+	}
+
+	// No primitive, the vertex shader makes up the grid.
+	dassert(gfx_renderable(&rend, pass, tech, nullptr, &state));
+
+	setText("");
+}
+
+void StatsOverlay::setText(const char *str) {
+	memset(text, 0, sizeof(text));
+
+	for (size_t row = 0, col = 0; *str != '\0' && row < ROWS; ++str) {
+		if (*str == '\n') {
+			++row;
+			col = 0;
+		}
+		else if (col < COLUMNS)
+			text[row * COLUMNS + col++] = (char)toupper((unsigned char)*str);
+	}
+}
+
+void StatsOverlay::record(GFXRecorder *recorder, FrameCounters *counters) {
+	const unsigned int frame = gfx_recorder_get_frame_index(recorder);
+
+	uint32_t width, height, layers;
+	gfx_recorder_get_size(recorder, &width, &height, &layers);
+
+	if (width == 0 || height == 0)
+		return;
+
+	struct {
+		float origin[2]; // In pixels.
+		float size[2];   // Of the pass, in pixels.
+		float scale;
+	} constants = {
+		{ 4.0f * scale, 4.0f * scale },
+		{ (float)width, (float)height },
+		scale
+	};
+
+	const size_t bytes = data.upload(frame, text);
+
+	gfx_cmd_bind(
+		recorder, tech,
+		0, 1, 0, &sets[frame], nullptr);
+	gfx_cmd_push(
+		recorder, tech, 0, sizeof(constants), &constants);
+	gfx_cmd_draw(
+		recorder, &rend, 6, 1, 0, 0);
+
+	if (counters) {
+		counters->uploadBytes += bytes;
+		counters->binds += 1;
+		counters->draws += 1;
+		counters->vertices += 6;
+		counters->primitives += 2;
+	}
+}
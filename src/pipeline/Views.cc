@@ -0,0 +1,220 @@
+#include <chrono>
+#include <math.h>
+#include "pipeline.h"
+
+using clock_type = std::chrono::steady_clock;
+
+static double elapsed_ms(clock_type::time_point since) {
+	return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+void snapshot_scene(GraphNode *graph, FrameData *data, SceneSnapshot &out) {
+	const auto start = clock_type::now();
+
+	out.counters = {};
+	graph->update(&out.counters);
+
+	if (data) {
+		out.transforms.resize(data->frameSize());
+		data->setStaging(out.transforms.data());
+		graph->write(data);
+
+		out.counters.transforms = data->written();
+		out.counters.writeBytes = data->writtenBytes();
+	}
+
+	out.sharedMs = elapsed_ms(start);
+}
+
+void snapshot_view(
+		GraphNode *graph, OcclusionCuller *culler, GFXPass *pass,
+		const mat4<float> &viewProj, const float viewport[4], SnapshotView &out) {
+	const auto start = clock_type::now();
+
+	// Visibility flags are overwritten per view, collect right after.
+	if (culler) {
+		culler->cull(viewProj);
+		out.cull = culler->stats();
+	}
+
+	out.draws.clear();
+	graph->collect(pass, out.draws);
+
+	out.viewProj = viewProj;
+	for (size_t i = 0; i < 4; ++i) out.viewport[i] = viewport[i];
+
+	out.prepareMs = elapsed_ms(start);
+}
+
+void snapshot_lights(
+		LightClusters *lights, FrameData *data,
+		float near, float far, SceneSnapshot &out) {
+	dassert(data->numElements() >= out.views.size());
+
+	out.lights.resize(data->frameSize());
+	data->setStaging(out.lights.data());
+
+	// Bin straight into staging memory, no copy.
+	for (SnapshotView &view : out.views) {
+		view.lightOffset = data->next();
+		lights->bin(view.viewProj, near, far, out.lights.data() + view.lightOffset);
+		view.lighting = lights->stats();
+	}
+}
+
+void snapshot_depth(
+		OcclusionCuller *culler, FrameData *data, size_t v, SceneSnapshot &out) {
+	dassert(v < data->numElements() && v < out.views.size());
+	dassert(culler->hierarchySize() <= data->elementSize());
+
+	// Elements are laid out at the binding's stride.
+	const size_t stride = data->frameSize() / data->numElements();
+	out.depth.resize(data->frameSize());
+	out.views[v].depthOffset = (uint32_t)(stride * v);
+
+	culler->copyHierarchy(out.depth.data() + out.views[v].depthOffset);
+}
+
+// Longest side of the bounds on screen in pixels, infinite if crossing the near plane.
+static float footprint(
+		const mat4<float> &viewProj, const aabb<float> &bounds,
+		float width, float height) {
+	float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+
+	for (size_t c = 0; c < 8; ++c) {
+		const vec3<float> p = bounds.corner(c);
+		auto row = [&](size_t r) {
+			return
+				viewProj[r][0] * p[0] + viewProj[r][1] * p[1] +
+				viewProj[r][2] * p[2] + viewProj[r][3];
+		};
+
+		const float w = row(3);
+		if (w <= 0.0f)
+			return INFINITY;
+
+		const float x = row(0) / w, y = row(1) / w;
+		minX = GFX_MIN(minX, x), maxX = GFX_MAX(maxX, x);
+		minY = GFX_MIN(minY, y), maxY = GFX_MAX(maxY, y);
+	}
+
+	// Clip to the view, from [-1,1] to pixels.
+	const float x = GFX_MIN(maxX, 1.0f) - GFX_MAX(minX, -1.0f);
+	const float y = GFX_MIN(maxY, 1.0f) - GFX_MAX(minY, -1.0f);
+
+	return GFX_MAX(x * 0.5f * width, y * 0.5f * height);
+}
+
+void snapshot_textures(uint32_t width, uint32_t height, SceneSnapshot &out) {
+	out.textures.clear();
+
+	// Assumes a texture spans its primitive once, ignores tiling.
+	for (const SnapshotView &view : out.views)
+		for (const DrawItem &item : view.draws)
+			if (item.texture)
+				out.textures.push_back(TextureRequest{
+					item.texture,
+					texture_level(item.texture, footprint(
+						view.viewProj, item.bounds,
+						view.viewport[2] * (float)width,
+						view.viewport[3] * (float)height)) });
+}
+
+void record_views(
+		GFXRecorder *recorder, GFXTechnique *tech,
+		GFXSet **lightSets, TextureStreamer *textures, const SceneSnapshot &snap,
+		FrameCounters *counters, IndirectDraws *indirect) {
+	const unsigned int frame = gfx_recorder_get_frame_index(recorder);
+	FrameCounters count = {};
+
+	for (size_t v = 0; v < snap.views.size(); ++v) {
+		const SnapshotView &view = snap.views[v];
+		count.visible += view.draws.size();
+		count.culled += view.cull.culled;
+
+		// Relative to the pass, so resizing needs no new snapshot.
+		GFXViewport viewport = {
+			.size = GFX_SIZE_RELATIVE,
+			.xOffset = view.viewport[0],
+			.yOffset = view.viewport[1],
+			.xScale = view.viewport[2],
+			.yScale = view.viewport[3],
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+
+		GFXScissor scissor = {
+			.size = GFX_SIZE_RELATIVE,
+			.xOffset = view.viewport[0],
+			.yOffset = view.viewport[1],
+			.xScale = view.viewport[2],
+			.yScale = view.viewport[3]
+		};
+
+		gfx_cmd_set_viewport(recorder, viewport);
+		gfx_cmd_set_scissor(recorder, scissor);
+		gfx_cmd_push(recorder, tech, 0, sizeof(view.viewProj.data), view.viewProj.data);
+
+		if (lightSets) {
+			gfx_cmd_bind(
+				recorder, tech,
+				1, 1, 1, &lightSets[frame], &view.lightOffset);
+			++count.binds;
+		}
+
+		// The vertex shader reads transforms from storage if drawn indirectly.
+		const uint32_t drawIndirect = 1, drawDirect = 0;
+		const uint32_t flagOffset = sizeof(view.viewProj.data);
+
+		if (indirect) {
+			gfx_cmd_push(recorder, tech, flagOffset, sizeof(uint32_t), &drawIndirect);
+			indirect->draw(recorder, v, textures, &count);
+		}
+
+		gfx_cmd_push(recorder, tech, flagOffset, sizeof(uint32_t), &drawDirect);
+
+		GFXSet *bound = nullptr;
+
+		for (const DrawItem &item : view.draws) {
+			gfx_cmd_bind(
+				recorder, item.tech,
+				0, 1, 1, &item.sets[frame], &item.offset);
+			++count.binds;
+
+			if (textures) {
+				GFXSet *set = item.texture ?
+					item.texture->sets()[frame] : textures->fallback()[frame];
+
+				if (set != bound) {
+					gfx_cmd_bind(
+						recorder, item.tech,
+						2, 1, 0, &set, nullptr);
+					++count.binds;
+				}
+
+				bound = set;
+			}
+
+			if (item.ranged)
+				gfx_cmd_draw_indexed(
+					recorder, item.renderable,
+					item.numVertices, 1, item.firstIndex, item.vertexOffset, 0);
+			else
+				gfx_cmd_draw_prim(
+					recorder, item.renderable, 1, 0);
+
+			++count.draws;
+			count.vertices += item.numVertices;
+			count.primitives += item.numVertices / 3;
+		}
+	}
+
+	if (counters) {
+		counters->visible += count.visible;
+		counters->culled += count.culled;
+		counters->draws += count.draws;
+		counters->binds += count.binds;
+		counters->vertices += count.vertices;
+		counters->primitives += count.primitives;
+	}
+}
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <stdio.h>
+#include <tuple>
+#include "pipeline.h"
+
+size_t warmup_pipelines(GraphNode *graph, JobPool *jobs) {
+	std::vector<GFXRenderable*> all;
+	graph->renderables(all);
+
+	// One renderable per combination, the rest hit the same pipeline.
+	auto key = [](const GFXRenderable *r) {
+		return std::make_tuple(r->pass, r->technique, r->state);
+	};
+
+	std::sort(all.begin(), all.end(), [&](const GFXRenderable *l, const GFXRenderable *r) {
+		return key(l) < key(r);
+	});
+
+	all.erase(std::unique(all.begin(), all.end(), [&](const GFXRenderable *l, const GFXRenderable *r) {
+		return key(l) == key(r);
+	}), all.end());
+
+	// The renderer's pipeline cache is thread-safe.
+	auto warm = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			if (!gfx_renderable_warmup(all[i]))
+				fprintf(stderr, "Could not warm up a pipeline.\n");
+	};
+
+	if (jobs) jobs->parallelFor(all.size(), 1, warm);
+	else warm(0, all.size());
+
+	return all.size();
+}
+
+bool load_pipeline_cache(GFXRenderer *renderer, const char *path) {
+	GFXFile file;
+	if (!gfx_file_init(&file, path, "rb"))
+		return false;
+
+	const bool ok = gfx_renderer_load_cache(renderer, &file.reader);
+	gfx_file_clear(&file);
+
+	return ok;
+}
+
+bool store_pipeline_cache(GFXRenderer *renderer, const char *path) {
+	GFXFile file;
+	if (!gfx_file_init(&file, path, "wb"))
+		return false;
+
+	const bool ok = gfx_renderer_store_cache(renderer, &file.writer);
+	gfx_file_clear(&file);
+
+	return ok;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// The last `size` samples of a value, for percentiles over time.
+class RollingStats {
+public:
+	RollingStats(size_t size = 240);
+
+	void add(double value);
+	void clear();
+
+	size_t count() const { return filled; }
+	double mean() const;
+
+	// For p in [0,1], 0 if empty.
+	double percentile(double p) const;
+
+private:
+	std::vector<double> samples;
+	size_t next;
+	size_t filled;
+
+	mutable std::vector<double> sorted;
+};
+
+// Counters of a single frame, as recorded by the CPU.
+// Plain increments only, filled by the simulation (scene & views)
+// and then the render thread (the rest) of the same frame.
+struct FrameCounters {
+	size_t nodes;      // Updated.
+	size_t moved;      // Updated to a different world transform.
+	size_t transforms; // Written to staging memory.
+	uint64_t writeBytes;  // Likewise.
+	uint64_t uploadBytes; // Staging memory copied to the GPU.
+
+	size_t visible; // Collected draws of all views.
+	size_t culled;  // Candidates culled by the CPU, of all views.
+
+	size_t draws;
+	size_t binds; // All gfx_cmd_bind calls.
+
+	// Pipeline statistics as submitted, vertices before any reuse
+	// & primitives (triangles) as input to clipping.
+	uint64_t vertices;
+	uint64_t primitives;
+
+	// Heap allocations of the simulation & render thread's scopes of the frame,
+	// including their job pool work.
+	uint64_t allocs;
+};
+
+// Rolling per-frame statistics, GPU times arrive frames later
+// than the CPU side of the same frame.
+class FrameStats {
+public:
+	FrameStats(size_t size = 240);
+
+	void addFrame(double cpuMs, double recordMs, const FrameCounters &counters);
+
+	// Only frames the CPU waited for are timed, the GPU was idle
+	// for an unknown part of the others.
+	void addGpu(double gpuMs, bool bound);
+
+	// A line of p50/p99 of everything.
+	void print(FILE *out) const;
+
+	RollingStats cpuMs;
+	RollingStats recordMs;
+	RollingStats gpuMs;    // Of GPU-bound frames.
+	RollingStats gpuBound; // 1 if the CPU had to wait for the frame.
+	RollingStats draws;
+	RollingStats binds;
+	RollingStats vertices;
+	RollingStats primitives;
+	RollingStats nodes;
+	RollingStats visible;
+	RollingStats culled;
+	RollingStats uploadBytes;
+	RollingStats allocs;
+};
+
+// Writes a line per frame of all counters, for offline analysis.
+// As CSV with a header, or JSON lines if the path ends in ".json"/".jsonl".
+// GPU times arrive later, they are written as of the last addGpu().
+class StatsStream {
+public:
+	StatsStream() : file(nullptr), json(false), gpuMs(0.0) {}
+	~StatsStream() { close(); }
+
+	bool open(const char *path);
+	void close();
+
+	void addGpu(double gpuMs) { this->gpuMs = gpuMs; }
+
+	bool write(
+		uint64_t frame, double cpuMs, double recordMs,
+		const FrameCounters &counters);
+
+private:
+	FILE *file;
+	bool json;
+	double gpuMs;
+
+	char buffer[1 << 16]; // Flushed in full blocks only.
+};
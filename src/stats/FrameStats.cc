@@ -0,0 +1,83 @@
+#include <algorithm>
+#include "def.h"
+#include "stats.h"
+
+RollingStats::RollingStats(size_t size) :
+	samples(GFX_MAX(size, (size_t)1), 0.0), next(0), filled(0)
+{
+}
+
+void RollingStats::add(double value) {
+	samples[next] = value;
+	next = (next + 1) % samples.size();
+	filled = GFX_MIN(filled + 1, samples.size());
+}
+
+void RollingStats::clear() {
+	next = 0;
+	filled = 0;
+}
+
+double RollingStats::mean() const {
+	double sum = 0.0;
+	for (size_t s = 0; s < filled; ++s)
+		sum += samples[s];
+
+	return filled > 0 ? sum / (double)filled : 0.0;
+}
+
+double RollingStats::percentile(double p) const {
+	if (filled == 0)
+		return 0.0;
+
+	// Nearest rank, only the window is ever partially sorted.
+	const size_t rank = (size_t)(GFX_CLAMP(p, 0.0, 1.0) * (double)(filled - 1) + 0.5);
+	sorted.assign(samples.begin(), samples.begin() + filled);
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+
+	return sorted[rank];
+}
+
+FrameStats::FrameStats(size_t size) :
+	cpuMs(size), recordMs(size), gpuMs(size), gpuBound(size),
+	draws(size), binds(size), vertices(size), primitives(size),
+	nodes(size), visible(size), culled(size), uploadBytes(size), allocs(size)
+{
+}
+
+void FrameStats::addFrame(double cpuMs, double recordMs, const FrameCounters &counters) {
+	this->cpuMs.add(cpuMs);
+	this->recordMs.add(recordMs);
+	draws.add((double)counters.draws);
+	binds.add((double)counters.binds);
+	vertices.add((double)counters.vertices);
+	primitives.add((double)counters.primitives);
+	nodes.add((double)counters.nodes);
+	visible.add((double)counters.visible);
+	culled.add((double)counters.culled);
+	uploadBytes.add((double)counters.uploadBytes);
+	allocs.add((double)counters.allocs);
+}
+
+void FrameStats::addGpu(double gpuMs, bool bound) {
+	if (bound) this->gpuMs.add(gpuMs);
+	gpuBound.add(bound ? 1.0 : 0.0);
+}
+
+void FrameStats::print(FILE *out) const {
+	fprintf(out,
+		"frame: cpu %.3f/%.3f ms, record %.3f/%.3f ms, "
+		"gpu %.3f/%.3f ms (%.0f%% gpu-bound), "
+		"%.0f draws, %.0f binds, %.0f verts, %.0f prims, %.0f nodes, "
+		"%.0f visible, %.0f culled, %.0f KiB uploaded (p50/p99, counts p50), "
+		"%.0f allocs max\n",
+		cpuMs.percentile(0.5), cpuMs.percentile(0.99),
+		recordMs.percentile(0.5), recordMs.percentile(0.99),
+		gpuMs.percentile(0.5), gpuMs.percentile(0.99),
+		gpuBound.mean() * 100.0,
+		draws.percentile(0.5), binds.percentile(0.5),
+		vertices.percentile(0.5), primitives.percentile(0.5),
+		nodes.percentile(0.5), visible.percentile(0.5), culled.percentile(0.5),
+		uploadBytes.percentile(0.5) / 1024.0,
+		allocs.percentile(1.0));
+}
@@ -0,0 +1,62 @@
+#include <string.h>
+#include "def.h"
+#include "stats.h"
+
+static bool ends_with(const char *str, const char *suffix) {
+	const size_t len = strlen(str), suffixLen = strlen(suffix);
+	return len >= suffixLen && strcmp(str + len - suffixLen, suffix) == 0;
+}
+
+bool StatsStream::open(const char *path) {
+	close();
+
+	file = fopen(path, "w");
+	if (!file) {
+		std::cerr << "Could not open " << path << " for writing.\n";
+		return false;
+	}
+
+	// Our own buffer, so writing never allocates.
+	setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+
+	json = ends_with(path, ".json") || ends_with(path, ".jsonl");
+	gpuMs = 0.0;
+
+	if (!json && fputs(
+		"frame,cpu_ms,record_ms,gpu_ms,nodes,transforms,write_bytes,upload_bytes,"
+		"visible,culled,draws,binds,vertices,triangles,allocs\n", file) < 0)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void StatsStream::close() {
+	if (file) fclose(file);
+	file = nullptr;
+}
+
+bool StatsStream::write(
+		uint64_t frame, double cpuMs, double recordMs,
+		const FrameCounters &counters) {
+	if (!file) return false;
+
+	const char *format = json ?
+		"{\"frame\":%llu,\"cpu_ms\":%.4f,\"record_ms\":%.4f,\"gpu_ms\":%.4f,"
+		"\"nodes\":%zu,\"transforms\":%zu,\"write_bytes\":%llu,\"upload_bytes\":%llu,"
+		"\"visible\":%zu,\"culled\":%zu,\"draws\":%zu,\"binds\":%zu,"
+		"\"vertices\":%llu,\"triangles\":%llu,\"allocs\":%llu}\n" :
+		"%llu,%.4f,%.4f,%.4f,%zu,%zu,%llu,%llu,%zu,%zu,%zu,%zu,%llu,%llu,%llu\n";
+
+	return fprintf(file, format,
+		(unsigned long long)frame, cpuMs, recordMs, gpuMs,
+		counters.nodes, counters.transforms,
+		(unsigned long long)counters.writeBytes,
+		(unsigned long long)counters.uploadBytes,
+		counters.visible, counters.culled, counters.draws, counters.binds,
+		(unsigned long long)counters.vertices,
+		(unsigned long long)counters.primitives,
+		(unsigned long long)counters.allocs) > 0;
+}
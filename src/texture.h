@@ -0,0 +1,183 @@
+#pragma once
+
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "def.h"
+#include "gltf.h"
+#include "jobs.h"
+#include "memory.h"
+
+// Decodes a non-interlaced PNG to RGBA8, returns false if unsupported.
+bool png_decode(
+	const uint8_t *data, size_t size,
+	uint32_t &width, uint32_t &height, std::vector<uint8_t> &rgba);
+
+// Bytes of a BC1 (opaque) or BC3 (with alpha) compressed image.
+size_t bc_size(uint32_t width, uint32_t height, bool alpha);
+
+// Compresses RGBA8 pixels as BC1 or BC3, edge blocks are clamped.
+void bc_compress(
+	const uint8_t *rgba, uint32_t width, uint32_t height,
+	bool alpha, uint8_t *out);
+
+// The subset of KTX2 written & read here: a single 2D face & layer,
+// no supercompression, sRGB BC1 or BC3.
+#define KTX2_BC1_SRGB 132 // VkFormat values.
+#define KTX2_BC3_SRGB 138
+#define KTX2_MAX_LEVELS 32
+
+struct Ktx2Info {
+	struct Level {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	uint32_t vkFormat;
+	uint32_t width;
+	uint32_t height;
+	std::vector<Level> levels; // Level 0 is the largest.
+};
+
+bool ktx2_write(
+	const char *path, uint32_t vkFormat, uint32_t width, uint32_t height,
+	const std::vector<std::vector<uint8_t>> &levels);
+
+bool ktx2_read_info(FILE *file, Ktx2Info &out);
+
+// Transcodes RGBA8 pixels to a KTX2 file with a full mip chain,
+// mips are filtered in linear space & compressed in parallel.
+bool bake_texture(
+	const char *path, const uint8_t *rgba, uint32_t width, uint32_t height,
+	JobPool *jobs = nullptr);
+
+// Paths of the texture cache of all images of a document, stored next to
+// the images (or the document if embedded), missing or stale entries
+// are baked first unless `force` rebakes all. Empty if unsupported.
+std::vector<std::string> bake_images(
+	const GltfData &gltf, JobPool *jobs = nullptr, bool force = false);
+
+
+// A texture streamed from the cache, mip levels [tail, numLevels)
+// are always resident, higher ones stream in & out on demand.
+class Texture {
+public:
+	Texture(const Texture&) = delete;
+	~Texture();
+
+	uint32_t width() const { return info.width; }
+	uint32_t height() const { return info.height; }
+	uint32_t numLevels() const { return (uint32_t)info.levels.size(); }
+	uint32_t residentLevel() const { return base; }
+
+	// Per virtual frame, binding 0 is the sampled image.
+	GFXSet **sets() { return setList.data(); }
+
+private:
+	friend class TextureStreamer;
+	Texture() = default;
+
+	std::string path;
+	Ktx2Info info;
+	uint32_t tail;
+
+	GFXImage *image = nullptr; // Levels [base, numLevels).
+	uint32_t base;
+	uint64_t bytes = 0;
+
+	std::vector<GFXSet*> setList;
+	std::vector<GFXImage*> bound; // Per virtual frame, in its set.
+
+	uint32_t wanted; // As of the last update().
+	uint64_t lastUsed;
+
+	MemCharge charge = { MEM_TEXTURES };
+};
+
+// A level of detail wanted by a draw, as computed from its footprint.
+struct TextureRequest {
+	Texture *texture;
+	uint32_t level;
+};
+
+// Wanted level for `texels` over `pixels`, the longest screen-space extent.
+uint32_t texture_level(const Texture *texture, float pixels);
+
+// Streams mip levels under a global residency budget,
+// evicting the high levels of the least recently used textures.
+// Not thread-safe, lives on the render thread.
+class TextureStreamer {
+public:
+	struct Stats {
+		size_t textures;
+		uint64_t residentBytes;
+		uint64_t budget;
+		uint64_t readBytes;   // Of the last update().
+		uint64_t uploadBytes; // Likewise.
+		size_t streamed;      // Likewise, levels in & out.
+		size_t evicted;
+	};
+
+	TextureStreamer(
+		GFXRenderer *renderer, GFXHeap *heap, GFXDependency *dep,
+		GFXTechnique *tech, size_t set, uint64_t budget);
+
+	~TextureStreamer();
+
+	// Opens a baked texture & uploads its mip tail,
+	// returns nullptr on failure.
+	std::shared_ptr<Texture> open(const std::string &path);
+
+	// Per virtual frame sets of a 4x4 white texture, for untextured draws.
+	GFXSet **fallback() { return fallbackTex->sets(); }
+
+	// Applies the requests of a frame, streams in at most a fixed number
+	// of bytes & updates the sets of the virtual frame being recorded.
+	void update(const std::vector<TextureRequest> &requests, unsigned int frame);
+
+	// Drops textures that are no longer referenced elsewhere.
+	void purge();
+
+	const Stats &stats() { return last; }
+
+private:
+	bool setBase(Texture *texture, uint32_t base);
+	bool createSets(Texture *texture);
+	void retire(GFXImage *image, uint64_t bytes);
+	uint64_t residentBytes() const;
+	bool makeRoom(uint64_t bytes, const Texture *keep);
+
+	GFXRenderer *renderer;
+	GFXHeap *heap;
+	GFXDependency *dep;
+	GFXTechnique *tech;
+	size_t set;
+	uint64_t budget;
+	unsigned int numFrames;
+	uint64_t updates;
+
+	std::vector<std::shared_ptr<Texture>> textures;
+	std::shared_ptr<Texture> fallbackTex;
+
+	// Replaced images, freed once no set references them.
+	struct Retired {
+		GFXImage *image;
+		uint64_t bytes;
+		uint64_t update; // Retired during.
+	};
+
+	std::vector<Retired> retired;
+	uint64_t retiredBytes;
+	MemCharge retiredCharge = { MEM_TEXTURES };
+
+	// Candidate lists, reset by every update().
+	FrameArena scratch;
+
+	// File contents of the levels being streamed in, sized for
+	// the largest texture on open() so streaming never allocates.
+	std::vector<uint8_t> readBuffer;
+	MemCharge readCharge = { MEM_TEXTURES };
+
+	Stats last;
+};
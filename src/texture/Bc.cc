@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "texture.h"
+
+size_t bc_size(uint32_t width, uint32_t height, bool alpha) {
+	const size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (alpha ? 16 : 8);
+}
+
+static uint16_t pack_565(const float *c) {
+	auto q = [](float v, int max) {
+		return (uint16_t)GFX_CLAMP((int)(v * (float)max / 255.0f + 0.5f), 0, max);
+	};
+
+	return (uint16_t)(q(c[0], 31) << 11 | q(c[1], 63) << 5 | q(c[2], 31));
+}
+
+static void unpack_565(uint16_t v, int *c) {
+	const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints along the principal axis of the block's colors,
+// always in 4 color mode (or a single color).
+static void compress_color(const uint8_t px[16][4], uint8_t *out) {
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int p = 0; p < 16; ++p)
+		for (int c = 0; c < 3; ++c)
+			mean[c] += (float)px[p][c] / 16.0f;
+
+	float cov[6] = { 0.0f }; // xx, xy, xz, yy, yz, zz.
+	for (int p = 0; p < 16; ++p) {
+		const float d[3] = {
+			(float)px[p][0] - mean[0],
+			(float)px[p][1] - mean[1],
+			(float)px[p][2] - mean[2] };
+
+		cov[0] += d[0] * d[0], cov[1] += d[0] * d[1], cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1], cov[4] += d[1] * d[2], cov[5] += d[2] * d[2];
+	}
+
+	// Power iteration converges quickly enough for 16 points.
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int i = 0; i < 4; ++i) {
+		const float next[3] = {
+			cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+			cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+			cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+
+		const float len = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (len < 1e-6f) break;
+
+		for (int c = 0; c < 3; ++c) axis[c] = next[c] / len;
+	}
+
+	float lo = 0.0f, hi = 0.0f;
+	for (int p = 0; p < 16; ++p) {
+		float t = 0.0f;
+		for (int c = 0; c < 3; ++c)
+			t += ((float)px[p][c] - mean[c]) * axis[c];
+
+		lo = std::min(lo, t);
+		hi = std::max(hi, t);
+	}
+
+	// Inset a little, the extremes are rarely hit exactly.
+	const float inset = (hi - lo) / 16.0f;
+	float e0[3], e1[3];
+	for (int c = 0; c < 3; ++c) {
+		e0[c] = GFX_CLAMP(mean[c] + axis[c] * (hi - inset), 0.0f, 255.0f);
+		e1[c] = GFX_CLAMP(mean[c] + axis[c] * (lo + inset), 0.0f, 255.0f);
+	}
+
+	uint16_t c0 = pack_565(e0), c1 = pack_565(e1);
+	if (c0 < c1) std::swap(c0, c1);
+
+	uint32_t indices = 0;
+
+	if (c0 != c1) {
+		int pal[4][3];
+		unpack_565(c0, pal[0]);
+		unpack_565(c1, pal[1]);
+		for (int c = 0; c < 3; ++c) {
+			pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+			pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+		}
+
+		for (int p = 0; p < 16; ++p) {
+			int best = 0, bestDist = INT32_MAX;
+			for (int i = 0; i < 4; ++i) {
+				int dist = 0;
+				for (int c = 0; c < 3; ++c)
+					dist += (px[p][c] - pal[i][c]) * (px[p][c] - pal[i][c]);
+
+				if (dist < bestDist) best = i, bestDist = dist;
+			}
+
+			indices |= (uint32_t)best << (p * 2);
+		}
+	}
+
+	memcpy(out, &c0, 2);
+	memcpy(out + 2, &c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+// Always in 8 alpha mode (or a single alpha).
+static void compress_alpha(const uint8_t px[16][4], uint8_t *out) {
+	int a0 = 0, a1 = 255;
+	for (int p = 0; p < 16; ++p) {
+		a0 = std::max(a0, (int)px[p][3]);
+		a1 = std::min(a1, (int)px[p][3]);
+	}
+
+	uint64_t indices = 0;
+
+	if (a0 != a1) {
+		int pal[8] = { a0, a1 };
+		for (int i = 2; i < 8; ++i)
+			pal[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+
+		for (int p = 0; p < 16; ++p) {
+			int best = 0, bestDist = INT32_MAX;
+			for (int i = 0; i < 8; ++i) {
+				const int dist = abs(px[p][3] - pal[i]);
+				if (dist < bestDist) best = i, bestDist = dist;
+			}
+
+			indices |= (uint64_t)best << (p * 3);
+		}
+	}
+
+	out[0] = (uint8_t)a0;
+	out[1] = (uint8_t)a1;
+	for (int b = 0; b < 6; ++b)
+		out[2 + b] = (uint8_t)(indices >> (b * 8));
+}
+
+void bc_compress(
+		const uint8_t *rgba, uint32_t width, uint32_t height,
+		bool alpha, uint8_t *out) {
+	const size_t blockSize = alpha ? 16 : 8;
+
+	for (uint32_t by = 0; by < height; by += 4)
+		for (uint32_t bx = 0; bx < width; bx += 4) {
+			uint8_t px[16][4];
+			for (uint32_t y = 0; y < 4; ++y)
+				for (uint32_t x = 0; x < 4; ++x) {
+					const uint32_t sx = std::min(bx + x, width - 1);
+					const uint32_t sy = std::min(by + y, height - 1);
+					memcpy(px[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+				}
+
+			if (alpha) {
+				compress_alpha(px, out);
+				compress_color(px, out + 8);
+			}
+			else
+				compress_color(px, out);
+
+			out += blockSize;
+		}
+}
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+#include <string.h>
+#include "texture.h"
+
+static const uint8_t KTX2_IDENTIFIER[12] = {
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// Identifier, 9 header fields & the index.
+#define KTX2_HEADER_SIZE 80
+
+static void put_u32(std::vector<uint8_t> &out, uint32_t val) {
+	out.insert(out.end(), (const uint8_t*)&val, (const uint8_t*)&val + 4);
+}
+
+static void put_u64(std::vector<uint8_t> &out, uint64_t val) {
+	out.insert(out.end(), (const uint8_t*)&val, (const uint8_t*)&val + 8);
+}
+
+static uint32_t get_u32(const uint8_t *ptr) {
+	uint32_t val;
+	memcpy(&val, ptr, 4);
+	return val;
+}
+
+static uint64_t get_u64(const uint8_t *ptr) {
+	uint64_t val;
+	memcpy(&val, ptr, 8);
+	return val;
+}
+
+// Basic data format descriptor of sRGB BC1 or BC3.
+static std::vector<uint8_t> ktx2_dfd(bool bc3) {
+	const uint32_t numSamples = bc3 ? 2 : 1;
+	const uint32_t blockSize = 24 + 16 * numSamples;
+
+	std::vector<uint8_t> dfd;
+	put_u32(dfd, 4 + blockSize);
+	put_u32(dfd, 0); // Khronos vendor, basic descriptor.
+	put_u32(dfd, 2 | blockSize << 16);
+	put_u32(dfd, (bc3 ? 130 : 128) | 1 << 8 | 2 << 16); // BC model, BT709, sRGB.
+	put_u32(dfd, 3 | 3 << 8); // 4x4 texel blocks.
+	put_u32(dfd, bc3 ? 16 : 8);
+	put_u32(dfd, 0);
+
+	// Alpha comes first in BC3 blocks.
+	if (bc3) {
+		put_u32(dfd, 0 | 63 << 16 | 15u << 24);
+		put_u32(dfd, 0);
+		put_u32(dfd, 0);
+		put_u32(dfd, UINT32_MAX);
+	}
+
+	put_u32(dfd, (bc3 ? 64 : 0) | 63 << 16);
+	put_u32(dfd, 0);
+	put_u32(dfd, 0);
+	put_u32(dfd, UINT32_MAX);
+
+	return dfd;
+}
+
+bool ktx2_write(
+		const char *path, uint32_t vkFormat, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>> &levels) {
+	const bool bc3 = vkFormat == KTX2_BC3_SRGB;
+	const size_t align = bc3 ? 16 : 8;
+	const std::vector<uint8_t> dfd = ktx2_dfd(bc3);
+
+	std::vector<uint8_t> out(KTX2_IDENTIFIER, KTX2_IDENTIFIER + 12);
+	put_u32(out, vkFormat);
+	put_u32(out, 1); // Type size.
+	put_u32(out, width);
+	put_u32(out, height);
+	put_u32(out, 0); // Depth.
+	put_u32(out, 0); // Layers.
+	put_u32(out, 1); // Faces.
+	put_u32(out, (uint32_t)levels.size());
+	put_u32(out, 0); // No supercompression.
+
+	const size_t dfdOffset = KTX2_HEADER_SIZE + levels.size() * 24;
+	put_u32(out, (uint32_t)dfdOffset);
+	put_u32(out, (uint32_t)dfd.size());
+	put_u32(out, 0); // No key/value data.
+	put_u32(out, 0);
+	put_u64(out, 0); // No supercompression data.
+	put_u64(out, 0);
+
+	// Smallest level first, so the always resident tail is contiguous.
+	std::vector<uint64_t> offsets(levels.size());
+	uint64_t offset = dfdOffset + dfd.size();
+
+	for (size_t l = levels.size(); l-- > 0; ) {
+		offset = (offset + align - 1) / align * align;
+		offsets[l] = offset;
+		offset += levels[l].size();
+	}
+
+	for (size_t l = 0; l < levels.size(); ++l) {
+		put_u64(out, offsets[l]);
+		put_u64(out, levels[l].size());
+		put_u64(out, levels[l].size());
+	}
+
+	out.insert(out.end(), dfd.begin(), dfd.end());
+
+	for (size_t l = levels.size(); l-- > 0; ) {
+		out.resize(offsets[l], 0);
+		out.insert(out.end(), levels[l].begin(), levels[l].end());
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (!file) return false;
+
+	const bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+	return (fclose(file) == 0) && ok;
+}
+
+bool ktx2_read_info(FILE *file, Ktx2Info &out) {
+	uint8_t header[KTX2_HEADER_SIZE];
+	if (fseek(file, 0, SEEK_SET) != 0 ||
+		fread(header, 1, sizeof(header), file) != sizeof(header) ||
+		memcmp(header, KTX2_IDENTIFIER, 12) != 0)
+	{
+		return false;
+	}
+
+	out.vkFormat = get_u32(header + 12);
+	out.width = get_u32(header + 20);
+	out.height = get_u32(header + 24);
+	const uint32_t numLevels = get_u32(header + 40);
+
+	// Only what ktx2_write produces.
+	if ((out.vkFormat != KTX2_BC1_SRGB && out.vkFormat != KTX2_BC3_SRGB) ||
+		get_u32(header + 28) != 0 || get_u32(header + 32) > 1 ||
+		get_u32(header + 36) != 1 || get_u32(header + 44) != 0 ||
+		numLevels == 0 || numLevels > KTX2_MAX_LEVELS || out.width == 0 || out.height == 0)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> index(numLevels * 24);
+	if (fread(index.data(), 1, index.size(), file) != index.size())
+		return false;
+
+	out.levels.resize(numLevels);
+	for (uint32_t l = 0; l < numLevels; ++l)
+		out.levels[l] = Ktx2Info::Level{
+			get_u64(index.data() + l * 24), get_u64(index.data() + l * 24 + 8) };
+
+	return true;
+}
+
+static float srgb_to_linear(uint8_t v) {
+	const float f = (float)v / 255.0f;
+	return f <= 0.04045f ? f / 12.92f : powf((f + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linear_to_srgb(float v) {
+	const float f = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+	return (uint8_t)GFX_CLAMP((int)(f * 255.0f + 0.5f), 0, 255);
+}
+
+bool bake_texture(
+		const char *path, const uint8_t *rgba, uint32_t width, uint32_t height,
+		JobPool *jobs) {
+	bool alpha = false;
+	for (size_t p = 0; p < (size_t)width * height && !alpha; ++p)
+		alpha = rgba[p * 4 + 3] < 255;
+
+	float toLinear[256];
+	for (int v = 0; v < 256; ++v)
+		toLinear[v] = srgb_to_linear((uint8_t)v);
+
+	auto run = [&](size_t count, size_t grain, const auto &func) {
+		if (jobs) jobs->parallelFor(count, grain, func);
+		else func(0, count);
+	};
+
+	// Box filter down to 1x1, averaging color in linear space.
+	struct Level {
+		uint32_t width, height;
+		std::vector<uint8_t> pixels; // Empty for the source.
+	};
+
+	std::vector<Level> levels(1, Level{ width, height, {} });
+	std::vector<const uint8_t*> sources(1, rgba);
+
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		const Level &src = levels.back();
+		const uint8_t *srcPixels = sources.back();
+		Level dst = { std::max(src.width / 2, 1u), std::max(src.height / 2, 1u), {} };
+		dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+		run(dst.height, 16, [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; ++y)
+				for (size_t x = 0; x < dst.width; ++x) {
+					float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+					for (size_t s = 0; s < 4; ++s) {
+						const size_t sx = std::min(x * 2 + (s & 1), (size_t)src.width - 1);
+						const size_t sy = std::min(y * 2 + (s >> 1), (size_t)src.height - 1);
+						const uint8_t *px = srcPixels + (sy * src.width + sx) * 4;
+
+						for (size_t c = 0; c < 3; ++c) sum[c] += toLinear[px[c]];
+						sum[3] += (float)px[3];
+					}
+
+					uint8_t *out = dst.pixels.data() + (y * dst.width + x) * 4;
+					for (size_t c = 0; c < 3; ++c) out[c] = linear_to_srgb(sum[c] * 0.25f);
+					out[3] = (uint8_t)(sum[3] * 0.25f + 0.5f);
+				}
+		});
+
+		levels.push_back(std::move(dst));
+		sources.push_back(levels.back().pixels.data());
+	}
+
+	// Compress all levels in strips of a block row.
+	std::vector<std::vector<uint8_t>> blocks(levels.size());
+	struct Strip { size_t level; uint32_t y; };
+	std::vector<Strip> strips;
+
+	for (size_t l = 0; l < levels.size(); ++l) {
+		blocks[l].resize(bc_size(levels[l].width, levels[l].height, alpha));
+		for (uint32_t y = 0; y < levels[l].height; y += 4)
+			strips.push_back(Strip{ l, y });
+	}
+
+	run(strips.size(), 8, [&](size_t begin, size_t end) {
+		for (size_t s = begin; s < end; ++s) {
+			const Level &level = levels[strips[s].level];
+			const uint32_t y = strips[s].y;
+
+			bc_compress(
+				sources[strips[s].level] + (size_t)y * level.width * 4,
+				level.width, std::min(4u, level.height - y), alpha,
+				blocks[strips[s].level].data() + bc_size(level.width, y, alpha));
+		}
+	});
+
+	return ktx2_write(
+		path, alpha ? KTX2_BC3_SRGB : KTX2_BC1_SRGB, width, height, blocks);
+}
+
+std::vector<std::string> bake_images(const GltfData &gltf, JobPool *jobs, bool force) {
+	namespace fs = std::filesystem;
+
+	const size_t numImages = gltf.json()["images"].size();
+	std::vector<std::string> paths(numImages);
+
+	for (size_t i = 0; i < numImages; ++i) {
+		// Embedded images are cached next to the document.
+		std::string source = gltf.imagePath(i);
+		const std::string cache = source.empty() ?
+			gltf.source() + ".image" + std::to_string(i) + ".ktx2" :
+			source + ".ktx2";
+
+		if (source.empty()) source = gltf.source();
+
+		std::error_code err, srcErr;
+		const auto cacheTime = fs::last_write_time(cache, err);
+		const auto sourceTime = fs::last_write_time(source, srcErr);
+
+		if (!force && !err && (srcErr || cacheTime >= sourceTime)) {
+			paths[i] = cache;
+			continue;
+		}
+
+		std::vector<uint8_t> bytes, rgba;
+		uint32_t width, height;
+
+		if (!gltf.readImage(i, bytes) ||
+			!png_decode(bytes.data(), bytes.size(), width, height, rgba))
+		{
+			std::cerr << "Cannot transcode image " << i << " of "
+				<< gltf.source() << ", only PNG is supported.\n";
+			continue;
+		}
+
+		if (!bake_texture(cache.c_str(), rgba.data(), width, height, jobs)) {
+			std::cerr << "Could not write texture cache " << cache << '\n';
+			continue;
+		}
+
+		paths[i] = cache;
+	}
+
+	return paths;
+}
@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include "texture.h"
+
+// Inflate (RFC 1951), canonical Huffman codes decoded a bit at a time,
+// only used when baking so simplicity wins over speed.
+struct BitReader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	uint32_t bits;
+	int count;
+
+	bool get(int n, uint32_t &out) {
+		while (count < n) {
+			if (pos >= size) return false;
+			bits |= (uint32_t)data[pos++] << count;
+			count += 8;
+		}
+
+		out = bits & ((1u << n) - 1);
+		bits >>= n;
+		count -= n;
+		return true;
+	}
+};
+
+struct Huffman {
+	uint16_t counts[16];
+	uint16_t symbols[288];
+
+	// Returns false for over-subscribed codes.
+	bool build(const uint8_t *lengths, size_t n) {
+		memset(counts, 0, sizeof(counts));
+		for (size_t s = 0; s < n; ++s) ++counts[lengths[s]];
+		counts[0] = 0;
+
+		int left = 1;
+		for (int len = 1; len < 16; ++len) {
+			left = (left << 1) - counts[len];
+			if (left < 0) return false;
+		}
+
+		uint16_t offsets[16] = { 0 };
+		for (int len = 1; len < 15; ++len)
+			offsets[len + 1] = offsets[len] + counts[len];
+
+		for (size_t s = 0; s < n; ++s)
+			if (lengths[s] != 0) symbols[offsets[lengths[s]]++] = (uint16_t)s;
+
+		return true;
+	}
+
+	bool decode(BitReader &in, uint32_t &out) const {
+		int code = 0, first = 0, index = 0;
+
+		for (int len = 1; len < 16; ++len) {
+			uint32_t bit;
+			if (!in.get(1, bit)) return false;
+
+			code |= (int)bit;
+			const int count = counts[len];
+
+			if (code - first < count) {
+				out = symbols[index + code - first];
+				return true;
+			}
+
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+
+		return false;
+	}
+};
+
+static const uint16_t lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+static const uint8_t distExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static bool inflate_codes(
+		BitReader &in, const Huffman &lit, const Huffman &dist,
+		std::vector<uint8_t> &out) {
+	while (true) {
+		uint32_t sym;
+		if (!lit.decode(in, sym)) return false;
+
+		if (sym < 256) {
+			out.push_back((uint8_t)sym);
+			continue;
+		}
+
+		if (sym == 256) return true;
+
+		sym -= 257;
+		if (sym >= 29) return false;
+
+		uint32_t extra, d;
+		if (!in.get(lengthExtra[sym], extra)) return false;
+		const size_t len = lengthBase[sym] + extra;
+
+		if (!dist.decode(in, d) || d >= 30 || !in.get(distExtra[d], extra))
+			return false;
+
+		const size_t back = distBase[d] + extra;
+		if (back > out.size()) return false;
+
+		// Byte by byte, copies may overlap.
+		const size_t from = out.size() - back;
+		for (size_t i = 0; i < len; ++i)
+			out.push_back(out[from + i]);
+	}
+}
+
+// Inflates a zlib stream, ignores the checksum.
+static bool zlib_inflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+	if (size < 2 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 ||
+		(data[1] & 0x20))
+	{
+		return false;
+	}
+
+	BitReader in = { data, size, 2, 0, 0 };
+	uint32_t last = 0;
+
+	while (!last) {
+		uint32_t type;
+		if (!in.get(1, last) || !in.get(2, type)) return false;
+
+		if (type == 0) {
+			// Stored, byte aligned.
+			in.bits = 0;
+			in.count = 0;
+
+			if (in.pos + 4 > in.size) return false;
+			const size_t len = data[in.pos] | (data[in.pos + 1] << 8);
+			in.pos += 4;
+
+			if (in.pos + len > in.size) return false;
+			out.insert(out.end(), data + in.pos, data + in.pos + len);
+			in.pos += len;
+		}
+		else if (type == 1) {
+			uint8_t lengths[288 + 30];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 30);
+
+			Huffman lit, dist;
+			lit.build(lengths, 288);
+			dist.build(lengths + 288, 30);
+
+			if (!inflate_codes(in, lit, dist, out)) return false;
+		}
+		else if (type == 2) {
+			uint32_t hlit, hdist, hclen;
+			if (!in.get(5, hlit) || !in.get(5, hdist) || !in.get(4, hclen))
+				return false;
+
+			hlit += 257, hdist += 1, hclen += 4;
+			if (hlit > 286 || hdist > 30) return false;
+
+			static const uint8_t order[19] = {
+				16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			uint8_t lengths[288 + 30] = { 0 };
+			for (uint32_t i = 0; i < hclen; ++i) {
+				uint32_t len;
+				if (!in.get(3, len)) return false;
+				lengths[order[i]] = (uint8_t)len;
+			}
+
+			Huffman codes;
+			if (!codes.build(lengths, 19)) return false;
+			memset(lengths, 0, 19);
+
+			// Literal/length & distance code lengths, run-length encoded.
+			for (uint32_t i = 0; i < hlit + hdist; ) {
+				uint32_t sym, rep, val = 0;
+				if (!codes.decode(in, sym)) return false;
+
+				if (sym < 16) {
+					lengths[i++] = (uint8_t)sym;
+					continue;
+				}
+
+				if (sym == 16) {
+					if (i == 0 || !in.get(2, rep)) return false;
+					val = lengths[i - 1], rep += 3;
+				}
+				else if (sym == 17) {
+					if (!in.get(3, rep)) return false;
+					rep += 3;
+				}
+				else {
+					if (!in.get(7, rep)) return false;
+					rep += 11;
+				}
+
+				if (i + rep > hlit + hdist) return false;
+				while (rep--) lengths[i++] = (uint8_t)val;
+			}
+
+			Huffman lit, dist;
+			if (!lit.build(lengths, hlit) || !dist.build(lengths + hlit, hdist))
+				return false;
+
+			if (!inflate_codes(in, lit, dist, out)) return false;
+		}
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static uint32_t read_be32(const uint8_t *ptr) {
+	return
+		(uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 |
+		(uint32_t)ptr[2] << 8 | (uint32_t)ptr[3];
+}
+
+static uint8_t paeth(int a, int b, int c) {
+	const int p = a + b - c;
+	const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return (uint8_t)((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c);
+}
+
+bool png_decode(
+		const uint8_t *data, size_t size,
+		uint32_t &width, uint32_t &height, std::vector<uint8_t> &rgba) {
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (size < 8 || memcmp(data, signature, 8) != 0)
+		return false;
+
+	uint32_t depth = 0, colorType = 0;
+	uint8_t palette[256][4];
+	size_t paletteSize = 0;
+	int trns[3] = { -1, -1, -1 }; // Transparent gray or rgb.
+	std::vector<uint8_t> idat;
+
+	for (size_t pos = 8; pos + 12 <= size; ) {
+		const uint32_t len = read_be32(data + pos);
+		const uint8_t *type = data + pos + 4;
+		const uint8_t *chunk = data + pos + 8;
+
+		if (len > size - pos - 12)
+			return false;
+
+		if (memcmp(type, "IHDR", 4) == 0) {
+			if (len < 13) return false;
+			width = read_be32(chunk);
+			height = read_be32(chunk + 4);
+			depth = chunk[8];
+			colorType = chunk[9];
+
+			// No interlacing.
+			if (chunk[12] != 0 || width == 0 || height == 0 ||
+				width > (1u << 15) || height > (1u << 15))
+			{
+				return false;
+			}
+		}
+		else if (memcmp(type, "PLTE", 4) == 0) {
+			paletteSize = std::min((size_t)len / 3, (size_t)256);
+			for (size_t p = 0; p < paletteSize; ++p)
+				palette[p][0] = chunk[p * 3],
+				palette[p][1] = chunk[p * 3 + 1],
+				palette[p][2] = chunk[p * 3 + 2],
+				palette[p][3] = 255;
+		}
+		else if (memcmp(type, "tRNS", 4) == 0) {
+			if (colorType == 3)
+				for (size_t p = 0; p < std::min((size_t)len, paletteSize); ++p)
+					palette[p][3] = chunk[p];
+			else if (colorType == 0 && len >= 2)
+				trns[0] = (chunk[0] << 8) | chunk[1];
+			else if (colorType == 2 && len >= 6)
+				for (int c = 0; c < 3; ++c)
+					trns[c] = (chunk[c * 2] << 8) | chunk[c * 2 + 1];
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+			idat.insert(idat.end(), chunk, chunk + len);
+		else if (memcmp(type, "IEND", 4) == 0)
+			break;
+
+		pos += 12 + len;
+	}
+
+	// Gray, rgb, palette, gray-alpha, rgba.
+	size_t channels;
+	switch (colorType) {
+	case 0: channels = 1; break;
+	case 2: channels = 3; break;
+	case 3: channels = 1; break;
+	case 4: channels = 2; break;
+	case 6: channels = 4; break;
+	default: return false;
+	}
+
+	if ((depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) ||
+		(depth < 8 && colorType != 0 && colorType != 3) ||
+		(depth == 16 && colorType == 3) ||
+		(colorType == 3 && paletteSize == 0))
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> raw;
+	const size_t stride = ((size_t)width * channels * depth + 7) / 8;
+	const size_t bpp = std::max((size_t)1, channels * depth / 8);
+
+	if (!zlib_inflate(idat.data(), idat.size(), raw) || raw.size() < (stride + 1) * height)
+		return false;
+
+	// Unfilter in place, each row is preceded by its filter type.
+	for (uint32_t y = 0; y < height; ++y) {
+		uint8_t *row = raw.data() + y * (stride + 1) + 1;
+		const uint8_t *prev = y > 0 ? row - (stride + 1) : nullptr;
+		const uint8_t filter = row[-1];
+
+		for (size_t i = 0; i < stride; ++i) {
+			const int a = i >= bpp ? row[i - bpp] : 0;
+			const int b = prev ? prev[i] : 0;
+			const int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+
+			switch (filter) {
+			case 0: break;
+			case 1: row[i] = (uint8_t)(row[i] + a); break;
+			case 2: row[i] = (uint8_t)(row[i] + b); break;
+			case 3: row[i] = (uint8_t)(row[i] + ((a + b) >> 1)); break;
+			case 4: row[i] = (uint8_t)(row[i] + paeth(a, b, c)); break;
+			default: return false;
+			}
+		}
+	}
+
+	// Expand to RGBA8, 16 bits samples keep their high byte.
+	rgba.resize((size_t)width * height * 4);
+
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t *row = raw.data() + y * (stride + 1) + 1;
+
+		for (uint32_t x = 0; x < width; ++x) {
+			uint8_t *px = rgba.data() + ((size_t)y * width + x) * 4;
+			int s[4];
+
+			for (size_t c = 0; c < channels; ++c) {
+				const size_t i = (size_t)x * channels + c;
+
+				if (depth == 16)
+					s[c] = (row[i * 2] << 8) | row[i * 2 + 1];
+				else if (depth == 8)
+					s[c] = row[i];
+				else {
+					const size_t bit = i * depth;
+					s[c] = (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+				}
+			}
+
+			const int max = (1 << depth) - 1;
+			auto to8 = [&](int v) {
+				return (uint8_t)(depth == 16 ? v >> 8 : v * 255 / max);
+			};
+
+			switch (colorType) {
+			case 0:
+				px[0] = px[1] = px[2] = to8(s[0]);
+				px[3] = (s[0] == trns[0]) ? 0 : 255;
+				break;
+			case 2:
+				px[0] = to8(s[0]), px[1] = to8(s[1]), px[2] = to8(s[2]);
+				px[3] = (s[0] == trns[0] && s[1] == trns[1] && s[2] == trns[2]) ? 0 : 255;
+				break;
+			case 3:
+				if ((size_t)s[0] >= paletteSize) return false;
+				memcpy(px, palette[s[0]], 4);
+				break;
+			case 4:
+				px[0] = px[1] = px[2] = to8(s[0]);
+				px[3] = to8(s[1]);
+				break;
+			case 6:
+				px[0] = to8(s[0]), px[1] = to8(s[1]), px[2] = to8(s[2]);
+				px[3] = to8(s[3]);
+				break;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include "texture.h"
+
+// Levels no larger than this are always resident.
+#define TEXTURE_TAIL_SIZE 64
+
+// Read from disk per update() at most, unless a single level is larger.
+#define TEXTURE_STREAM_BYTES (8 << 20)
+
+Texture::~Texture() {
+	gfx_free_image(image);
+}
+
+uint32_t texture_level(const Texture *texture, float pixels) {
+	const float texels = (float)std::max(texture->width(), texture->height());
+	if (!(pixels > 0.0f))
+		return texture->numLevels() - 1;
+
+	const float level = floorf(log2f(texels / pixels));
+	return (uint32_t)GFX_CLAMP(level, 0.0f, (float)(texture->numLevels() - 1));
+}
+
+// Bytes of levels [base, numLevels) in the image & in the file.
+static uint64_t level_bytes(const Ktx2Info &info, uint32_t base) {
+	uint64_t bytes = 0;
+	for (size_t l = base; l < info.levels.size(); ++l)
+		bytes += info.levels[l].size;
+
+	return bytes;
+}
+
+static uint64_t level_range(const Ktx2Info &info, uint32_t base) {
+	return info.levels[base].offset + info.levels[base].size - info.levels.back().offset;
+}
+
+// Allocates an image of levels [base, numLevels) & starts uploading them,
+// `data` holds the file contents from the offset of the smallest level.
+static GFXImage *upload_levels(
+		GFXHeap *heap, GFXDependency *dep,
+		const Ktx2Info &info, uint32_t base, const uint8_t *data) {
+	const uint32_t numLevels = (uint32_t)info.levels.size() - base;
+	const GFXFormat format = (info.vkFormat == KTX2_BC3_SRGB) ?
+		GFX_FORMAT_BC3_SRGB : GFX_FORMAT_BC1_RGB_SRGB;
+
+	GFXImage *image = gfx_alloc_image(
+		heap, GFX_IMAGE_2D, GFX_MEMORY_WRITE, GFX_IMAGE_SAMPLED, format,
+		numLevels, 1,
+		std::max(info.width >> base, 1u), std::max(info.height >> base, 1u), 1);
+
+	if (!image) return nullptr;
+
+	GFXRegion srcRegions[KTX2_MAX_LEVELS], dstRegions[KTX2_MAX_LEVELS];
+	for (uint32_t l = 0; l < numLevels; ++l) {
+		const Ktx2Info::Level &level = info.levels[base + l];
+
+		GFXRegion &src = srcRegions[l];
+		src = {};
+		src.offset = level.offset - info.levels.back().offset;
+
+		GFXRegion &dst = dstRegions[l];
+		dst = {};
+		dst.aspect = GFX_IMAGE_COLOR;
+		dst.mipmap = l;
+		dst.numLayers = 1;
+		dst.width = std::max(info.width >> (base + l), 1u);
+		dst.height = std::max(info.height >> (base + l), 1u);
+		dst.depth = 1;
+	}
+
+	const GFXInject inject = gfx_dep_sig(dep);
+
+	if (!gfx_write(
+		data, gfx_ref_image(image),
+		GFX_TRANSFER_ASYNC, numLevels, 1,
+		srcRegions, dstRegions, &inject))
+	{
+		gfx_free_image(image);
+		return nullptr;
+	}
+
+	return image;
+}
+
+TextureStreamer::TextureStreamer(
+		GFXRenderer *renderer, GFXHeap *heap, GFXDependency *dep,
+		GFXTechnique *tech, size_t set, uint64_t budget) :
+	renderer(renderer),
+	heap(heap),
+	dep(dep),
+	tech(tech),
+	set(set),
+	budget(budget),
+	numFrames(gfx_renderer_get_num_frames(renderer)),
+	updates(0),
+	retiredBytes(0),
+	last()
+{
+	// A single opaque white BC1 block.
+	const uint8_t white[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 };
+
+	fallbackTex = std::shared_ptr<Texture>(new Texture());
+	fallbackTex->info = { KTX2_BC1_SRGB, 4, 4, { { 0, sizeof(white) } } };
+	fallbackTex->tail = 0;
+	fallbackTex->base = 0;
+	fallbackTex->image = upload_levels(heap, dep, fallbackTex->info, 0, white);
+	dassert(fallbackTex->image);
+	dassert(createSets(fallbackTex.get()));
+}
+
+TextureStreamer::~TextureStreamer() {
+	// Sets are owned by the renderer, images are freed by their textures.
+	for (const Retired &r : retired)
+		gfx_free_image(r.image);
+}
+
+bool TextureStreamer::createSets(Texture *texture) {
+	const GFXSetResource res = {
+		.binding = 0, .index = 0, .ref = gfx_ref_image(texture->image) };
+
+	const GFXSampler sampler = {
+		.binding = 0,
+		.index = 0,
+		.flags = GFX_SAMPLER_NONE,
+		.mode = 0,
+		.minFilter = GFX_FILTER_LINEAR,
+		.magFilter = GFX_FILTER_LINEAR,
+		.mipFilter = GFX_FILTER_LINEAR,
+		.wrapU = GFX_WRAP_REPEAT,
+		.wrapV = GFX_WRAP_REPEAT,
+		.wrapW = GFX_WRAP_REPEAT,
+		.mipLodBias = 0.0f,
+		.minLod = 0.0f,
+		.maxLod = 1000.0f,
+		.maxAnisotropy = 1.0f,
+		.cmp = {}
+	};
+
+	texture->setList.resize(numFrames, nullptr);
+	texture->bound.resize(numFrames, texture->image);
+
+	for (unsigned int f = 0; f < numFrames; ++f) {
+		texture->setList[f] = gfx_renderer_add_set(
+			renderer, tech, set,
+			1, 0, 0, 1,
+			&res, nullptr, nullptr, &sampler);
+
+		if (!texture->setList[f]) {
+			for (unsigned int g = 0; g < f; ++g)
+				gfx_erase_set(texture->setList[g]);
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::shared_ptr<Texture> TextureStreamer::open(const std::string &path) {
+	auto texture = std::shared_ptr<Texture>(new Texture());
+	texture->path = path;
+
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) return nullptr;
+
+	const bool ok = ktx2_read_info(file, texture->info);
+	fclose(file);
+
+	if (!ok) {
+		std::cerr << "Invalid texture cache " << path << '\n';
+		return nullptr;
+	}
+
+	// First level that fits in the tail.
+	const Ktx2Info &info = texture->info;
+	uint32_t tail = 0;
+	while (
+		tail + 1 < info.levels.size() &&
+		std::max(info.width >> tail, info.height >> tail) > TEXTURE_TAIL_SIZE)
+	{
+		++tail;
+	}
+
+	texture->tail = tail;
+	texture->wanted = tail;
+	texture->lastUsed = updates;
+
+	// Room to stream in all levels & to retire every texture's image
+	// during each update until retired images are freed.
+	if (level_range(info, 0) > readBuffer.capacity()) {
+		readBuffer.reserve(level_range(info, 0));
+		readCharge.set(readBuffer.capacity());
+	}
+
+	retired.reserve((textures.size() + 1) * (numFrames * 2 + 1));
+
+	if (!setBase(texture.get(), tail) || !createSets(texture.get()))
+		return nullptr;
+
+	textures.push_back(texture);
+	return texture;
+}
+
+bool TextureStreamer::setBase(Texture *texture, uint32_t base) {
+	const Ktx2Info &info = texture->info;
+	std::vector<uint8_t> &data = readBuffer;
+	data.resize(level_range(info, base));
+
+	FILE *file = fopen(texture->path.c_str(), "rb");
+	if (!file) return false;
+
+	const bool ok =
+		fseek(file, (long)info.levels.back().offset, SEEK_SET) == 0 &&
+		fread(data.data(), 1, data.size(), file) == data.size();
+
+	fclose(file);
+	if (!ok) return false;
+
+	GFXImage *image = upload_levels(heap, dep, info, base, data.data());
+	if (!image) return false;
+
+	if (texture->image)
+		retire(texture->image, texture->bytes);
+
+	texture->image = image;
+	texture->base = base;
+	texture->bytes = level_bytes(info, base);
+	texture->charge.set(texture->bytes);
+
+	last.readBytes += data.size();
+	last.uploadBytes += texture->bytes;
+	++last.streamed;
+
+	return true;
+}
+
+void TextureStreamer::retire(GFXImage *image, uint64_t bytes) {
+	retired.push_back(Retired{ image, bytes, updates });
+	retiredBytes += bytes;
+	retiredCharge.set(retiredBytes);
+}
+
+uint64_t TextureStreamer::residentBytes() const {
+	uint64_t bytes = 0;
+	for (const auto &texture : textures)
+		bytes += texture->bytes;
+
+	return bytes;
+}
+
+bool TextureStreamer::makeRoom(uint64_t bytes, const Texture *keep) {
+	uint64_t resident = residentBytes();
+	if (resident + bytes <= budget)
+		return true;
+
+	// Least recently used first, down to what they want,
+	// which is their tail if unused by this frame.
+	ArenaVector<Texture*> victims(&scratch);
+	victims.reserve(textures.size());
+
+	for (const auto &texture : textures)
+		if (texture.get() != keep && texture->base < texture->wanted)
+			victims.push_back(texture.get());
+
+	std::sort(victims.begin(), victims.end(), [](const Texture *l, const Texture *r) {
+		return l->lastUsed < r->lastUsed;
+	});
+
+	for (Texture *texture : victims) {
+		const uint64_t before = texture->bytes;
+		if (!setBase(texture, texture->wanted))
+			continue;
+
+		++last.evicted;
+		resident -= before - texture->bytes;
+
+		if (resident + bytes <= budget)
+			return true;
+	}
+
+	return false;
+}
+
+void TextureStreamer::update(
+		const std::vector<TextureRequest> &requests, unsigned int frame) {
+	++updates;
+	scratch.reset();
+
+	last.readBytes = 0;
+	last.uploadBytes = 0;
+	last.streamed = 0;
+	last.evicted = 0;
+
+	for (const auto &texture : textures)
+		texture->wanted = texture->tail;
+
+	for (const TextureRequest &request : requests) {
+		Texture *texture = request.texture;
+		texture->wanted = std::min(texture->wanted, request.level);
+		texture->lastUsed = updates;
+	}
+
+	// Largest deficit first, a level at a time per texture.
+	ArenaVector<Texture*> candidates(&scratch);
+	candidates.reserve(textures.size());
+
+	for (const auto &texture : textures)
+		if (texture->wanted < texture->base)
+			candidates.push_back(texture.get());
+
+	std::sort(candidates.begin(), candidates.end(), [](const Texture *l, const Texture *r) {
+		return l->base - l->wanted > r->base - r->wanted;
+	});
+
+	for (Texture *texture : candidates) {
+		const uint32_t base = texture->base - 1;
+		const uint64_t read = level_range(texture->info, base);
+
+		if (last.readBytes > 0 && last.readBytes + read > TEXTURE_STREAM_BYTES)
+			break;
+
+		const uint64_t grow = level_bytes(texture->info, base) - texture->bytes;
+		if (!makeRoom(grow, texture))
+			continue;
+
+		if (!setBase(texture, base))
+			std::cerr << "Could not stream texture " << texture->path << '\n';
+	}
+
+	// Point this frame's sets at the current images.
+	auto rebind = [&](Texture *texture) {
+		if (texture->bound[frame] == texture->image)
+			return;
+
+		const GFXSetResource res = {
+			.binding = 0, .index = 0, .ref = gfx_ref_image(texture->image) };
+
+		if (gfx_set_resources(texture->setList[frame], 1, &res))
+			texture->bound[frame] = texture->image;
+	};
+
+	for (const auto &texture : textures)
+		rebind(texture.get());
+
+	// Every frame has rebound & finished using retired images
+	// after going around the virtual frames twice.
+	auto it = std::remove_if(retired.begin(), retired.end(), [&](const Retired &r) {
+		if (updates - r.update <= numFrames * 2)
+			return false;
+
+		gfx_free_image(r.image);
+		retiredBytes -= r.bytes;
+		return true;
+	});
+
+	retired.erase(it, retired.end());
+	retiredCharge.set(retiredBytes);
+
+	last.textures = textures.size();
+	last.residentBytes = residentBytes();
+	last.budget = budget;
+}
+
+void TextureStreamer::purge() {
+	auto it = std::remove_if(textures.begin(), textures.end(), [&](const auto &texture) {
+		if (texture.use_count() > 1)
+			return false;
+
+		for (GFXSet *s : texture->setList)
+			gfx_erase_set(s);
+
+		retire(texture->image, texture->bytes);
+		texture->image = nullptr;
+		return true;
+	});
+
+	textures.erase(it, textures.end());
+}